@@ -17,9 +17,12 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "NDS.h"
 #include "ARM.h"
 #include "ARMInterpreter.h"
+#include "ARMCache.h"
+#include "ARMJIT.h"
 
 
 // instruction timing notes
@@ -83,6 +86,9 @@ void ARM::Reset()
     Cycles = 0;
     Halted = 0;
 
+    IdleBlock = NULL;
+    IdleTimestamp = 0;
+
     for (int i = 0; i < 16; i++)
         R[i] = 0;
 
@@ -462,6 +468,57 @@ void ARMv5::DataAbort()
     JumpTo(ExceptionBase + 0x10);
 }
 
+u64 ARM::CheckIdleLoop(ARMCache::Block* block)
+{
+    if (!block || !block->IdleLoop)
+    {
+        // if a slice ended in the middle of the loop, the rest of it runs
+        // as a separate block. that doesn't break the iteration
+        if (block && IdleBlock && (block->Addr & 1) == (IdleBlock->Addr & 1))
+        {
+            u32 size = (block->Addr & 1) ? 2 : 4;
+            u32 start = IdleBlock->Addr & ~1;
+            u32 addr = block->Addr & ~1;
+            if (addr > start && addr < start + IdleBlock->NumInstrs*size)
+                return 0;
+        }
+
+        IdleBlock = NULL;
+        return 0;
+    }
+
+    u64 timestamp = Num ? NDS::ARM7Timestamp : NDS::ARM9Timestamp;
+    u64 target = Num ? NDS::ARM7Target : NDS::ARM9Target;
+
+    // the loop only depends on the registers and on memory only the other
+    // CPU, DMA or events can change. if an iteration started from the state
+    // we're in now and led back to it, with nothing changed in between, the
+    // CPU will keep spinning until something does, so we can skip iterations.
+    // only whole ones are skipped: the loop has to be left at the same cycle
+    // as when running it (it may be polling VCOUNT or a timer), so what is
+    // left of the slice after that is run normally
+    if (block == IdleBlock && IdleLoopEpoch == NDS::IdleEpoch &&
+        CPSR == IdleCPSR && !memcmp(R, IdleR, sizeof(R)))
+    {
+        u64 itercycles = timestamp - IdleTimestamp;
+        u64 skip = itercycles ? (((target - timestamp) / itercycles) * itercycles) : 0;
+
+        if (skip && ARMCache::IdleLoopReadsSafe(this, block))
+        {
+            ARMCache::WatchIdleLoop(this, block);
+            IdleTimestamp = timestamp + skip;
+            return skip;
+        }
+    }
+
+    IdleBlock = block;
+    IdleLoopEpoch = NDS::IdleEpoch;
+    IdleCPSR = CPSR;
+    memcpy(IdleR, R, sizeof(R));
+    IdleTimestamp = timestamp;
+    return 0;
+}
+
 void ARMv5::Execute()
 {
     if (Halted)
@@ -496,7 +553,7 @@ void ARMv5::Execute()
 
             // actually execute
             u32 icode = (CurInstr >> 6) & 0x3FF;
-            ARMInterpreter::THUMBInstrTable[icode](this);
+            ARMInterpreter::ARM9Tables::THUMBInstrTable[icode](this);
         }
         else
         {
@@ -510,11 +567,11 @@ void ARMv5::Execute()
             if (CheckCondition(CurInstr >> 28))
             {
                 u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
+                ARMInterpreter::ARM9Tables::ARMInstrTable[icode](this);
             }
             else if ((CurInstr & 0xFE000000) == 0xFA000000)
             {
-                ARMInterpreter::A_BLX_IMM(this);
+                ARMInterpreter::A_BLX_IMM<ARMv5>(this);
             }
             else
                 AddCycles_C();
@@ -545,6 +602,159 @@ void ARMv5::Execute()
         Halted = 0;
 }
 
+void ARMv5::ExecuteCached()
+{
+    if (Halted)
+    {
+        if (Halted == 2)
+        {
+            Halted = 0;
+        }
+        else if (NDS::HaltInterrupted(0))
+        {
+            Halted = 0;
+            if (NDS::IME[0] & 0x1)
+                TriggerIRQ();
+        }
+        else
+        {
+            NDS::ARM9Timestamp = NDS::ARM9Target;
+            return;
+        }
+    }
+
+    while (NDS::ARM9Timestamp < NDS::ARM9Target)
+    {
+        u32 thumb = CPSR & 0x20;
+        u32 size = thumb ? 2 : 4;
+
+        // the block has to start with what's in the pipeline already
+        // if it doesn't (code was modified after being prefetched), step through it
+        ARMCache::Block* block = ARMCache::LookupBlock(0, (R[15] - size) | (thumb >> 5));
+        if (block && (block->Instrs[0].Instr != NextInstr[0] || block->Instrs[1].Instr != NextInstr[1]))
+            block = NULL;
+
+        if (NDS::IdleLoopSkip)
+        {
+            u64 skip = CheckIdleLoop(block);
+            if (skip)
+            {
+                NDS::IdleSkippedCycles[0] += skip;
+                NDS::ARM9Timestamp += skip;
+                continue;
+            }
+        }
+
+        if (block && ARMJIT::Enabled)
+        {
+            if (!block->JITCode)
+                ARMJIT::Compile(this, block);
+
+            if (block->JITCode)
+            {
+                if (((ARMJIT::CompiledBlock)block->JITCode)(this))
+                {
+                    if (Halted)
+                    {
+                        if (Halted == 1 && NDS::ARM9Timestamp < NDS::ARM9Target)
+                        {
+                            NDS::ARM9Timestamp = NDS::ARM9Target;
+                        }
+                        break;
+                    }
+                    continue;
+                }
+
+                // compiled for other code timings, redo it
+                block->JITCode = NULL;
+            }
+        }
+
+        ARMCache::BlockEntry* entry = block ? &block->Instrs[0] : NULL;
+        ARMCache::BlockEntry* end = block ? &block->Instrs[block->NumInstrs] : NULL;
+
+        for (;;)
+        {
+            u32 nextpc = R[15] + size;
+
+            if (entry)
+            {
+                R[15] = nextpc;
+                CurInstr = entry[0].Instr;
+                NextInstr[0] = entry[1].Instr;
+                NextInstr[1] = entry[2].Instr;
+                if (thumb && (R[15] & 0x2)) CodeCycles = 0;
+                else                        SetCodeCycles(R[15]);
+
+                if (CheckCondition(entry->Cond))
+                    entry->Handler(this);
+                else
+                    AddCycles_C();
+
+                entry++;
+            }
+            else if (thumb)
+            {
+                R[15] += 2;
+                CurInstr = NextInstr[0];
+                NextInstr[0] = NextInstr[1];
+                if (R[15] & 0x2) { NextInstr[1] >>= 16; CodeCycles = 0; }
+                else             NextInstr[1] = CodeRead32(R[15], false);
+
+                u32 icode = (CurInstr >> 6) & 0x3FF;
+                ARMInterpreter::ARM9Tables::THUMBInstrTable[icode](this);
+            }
+            else
+            {
+                R[15] += 4;
+                CurInstr = NextInstr[0];
+                NextInstr[0] = NextInstr[1];
+                NextInstr[1] = CodeRead32(R[15], false);
+
+                if (CheckCondition(CurInstr >> 28))
+                {
+                    u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
+                    ARMInterpreter::ARM9Tables::ARMInstrTable[icode](this);
+                }
+                else if ((CurInstr & 0xFE000000) == 0xFA000000)
+                {
+                    ARMInterpreter::A_BLX_IMM<ARMv5>(this);
+                }
+                else
+                    AddCycles_C();
+            }
+
+            if (Halted)
+            {
+                if (Halted == 1 && NDS::ARM9Timestamp < NDS::ARM9Target)
+                {
+                    NDS::ARM9Timestamp = NDS::ARM9Target;
+                }
+                break;
+            }
+            if (NDS::IF[0] & NDS::IE[0])
+            {
+                if (NDS::IME[0] & 0x1)
+                    TriggerIRQ();
+            }
+
+            NDS::ARM9Timestamp += Cycles;
+            Cycles = 0;
+
+            // leave the block on branches, exceptions, or if it got overwritten
+            if (!entry || entry == end) break;
+            if (R[15] != nextpc || (CPSR & 0x20) != thumb) break;
+            if (NDS::ARM9Timestamp >= NDS::ARM9Target) break;
+            if (!ARMCache::BlockValid(block)) break;
+        }
+
+        if (Halted) break;
+    }
+
+    if (Halted == 2)
+        Halted = 0;
+}
+
 void ARMv4::Execute()
 {
     if (Halted)
@@ -578,7 +788,7 @@ void ARMv4::Execute()
 
             // actually execute
             u32 icode = (CurInstr >> 6);
-            ARMInterpreter::THUMBInstrTable[icode](this);
+            ARMInterpreter::ARM7Tables::THUMBInstrTable[icode](this);
         }
         else
         {
@@ -592,7 +802,7 @@ void ARMv4::Execute()
             if (CheckCondition(CurInstr >> 28))
             {
                 u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
-                ARMInterpreter::ARMInstrTable[icode](this);
+                ARMInterpreter::ARM7Tables::ARMInstrTable[icode](this);
             }
             else
                 AddCycles_C();
@@ -620,3 +830,146 @@ void ARMv4::Execute()
     if (Halted == 2)
         Halted = 0;
 }
+
+void ARMv4::ExecuteCached()
+{
+    if (Halted)
+    {
+        if (Halted == 2)
+        {
+            Halted = 0;
+        }
+        else if (NDS::HaltInterrupted(1))
+        {
+            Halted = 0;
+            if (NDS::IME[1] & 0x1)
+                TriggerIRQ();
+        }
+        else
+        {
+            NDS::ARM7Timestamp = NDS::ARM7Target;
+            return;
+        }
+    }
+
+    while (NDS::ARM7Timestamp < NDS::ARM7Target)
+    {
+        u32 thumb = CPSR & 0x20;
+        u32 size = thumb ? 2 : 4;
+
+        ARMCache::Block* block = ARMCache::LookupBlock(1, (R[15] - size) | (thumb >> 5));
+        if (block && (block->Instrs[0].Instr != NextInstr[0] || block->Instrs[1].Instr != NextInstr[1]))
+            block = NULL;
+
+        if (NDS::IdleLoopSkip)
+        {
+            u64 skip = CheckIdleLoop(block);
+            if (skip)
+            {
+                NDS::IdleSkippedCycles[1] += skip;
+                NDS::ARM7Timestamp += skip;
+                continue;
+            }
+        }
+
+        if (block && ARMJIT::Enabled)
+        {
+            if (!block->JITCode)
+                ARMJIT::Compile(this, block);
+
+            if (block->JITCode)
+            {
+                if (((ARMJIT::CompiledBlock)block->JITCode)(this))
+                {
+                    if (Halted)
+                    {
+                        if (Halted == 1 && NDS::ARM7Timestamp < NDS::ARM7Target)
+                        {
+                            NDS::ARM7Timestamp = NDS::ARM7Target;
+                        }
+                        break;
+                    }
+                    continue;
+                }
+
+                // compiled for other code timings, redo it
+                block->JITCode = NULL;
+            }
+        }
+
+        ARMCache::BlockEntry* entry = block ? &block->Instrs[0] : NULL;
+        ARMCache::BlockEntry* end = block ? &block->Instrs[block->NumInstrs] : NULL;
+
+        for (;;)
+        {
+            u32 nextpc = R[15] + size;
+
+            if (entry)
+            {
+                R[15] = nextpc;
+                CurInstr = entry[0].Instr;
+                NextInstr[0] = entry[1].Instr;
+                NextInstr[1] = entry[2].Instr;
+
+                if (CheckCondition(entry->Cond))
+                    entry->Handler(this);
+                else
+                    AddCycles_C();
+
+                entry++;
+            }
+            else if (thumb)
+            {
+                R[15] += 2;
+                CurInstr = NextInstr[0];
+                NextInstr[0] = NextInstr[1];
+                NextInstr[1] = CodeRead16(R[15]);
+
+                u32 icode = (CurInstr >> 6);
+                ARMInterpreter::ARM7Tables::THUMBInstrTable[icode](this);
+            }
+            else
+            {
+                R[15] += 4;
+                CurInstr = NextInstr[0];
+                NextInstr[0] = NextInstr[1];
+                NextInstr[1] = CodeRead32(R[15]);
+
+                if (CheckCondition(CurInstr >> 28))
+                {
+                    u32 icode = ((CurInstr >> 4) & 0xF) | ((CurInstr >> 16) & 0xFF0);
+                    ARMInterpreter::ARM7Tables::ARMInstrTable[icode](this);
+                }
+                else
+                    AddCycles_C();
+            }
+
+            if (Halted)
+            {
+                if (Halted == 1 && NDS::ARM7Timestamp < NDS::ARM7Target)
+                {
+                    NDS::ARM7Timestamp = NDS::ARM7Target;
+                }
+                break;
+            }
+            if (NDS::IF[1] & NDS::IE[1])
+            {
+                if (NDS::IME[1] & 0x1)
+                    TriggerIRQ();
+            }
+
+            NDS::ARM7Timestamp += Cycles;
+            Cycles = 0;
+
+            if (!entry || entry == end) break;
+            if (R[15] != nextpc || (CPSR & 0x20) != thumb) break;
+            if (NDS::ARM7Timestamp >= NDS::ARM7Target) break;
+            if (!ARMCache::BlockValid(block)) break;
+        }
+
+        if (Halted) break;
+    }
+
+    if (Halted == 2)
+        Halted = 0;
+}
@@ -24,6 +24,8 @@
 #include "types.h"
 #include "NDS.h"
 
+namespace ARMCache { struct Block; }
+
 #define ROR(x, n) (((x) >> (n)) | ((x) << (32-(n))))
 
 enum
@@ -62,6 +64,9 @@ public:
     }
 
     virtual void Execute() = 0;
+    virtual void ExecuteCached() = 0;
+
+    u64 CheckIdleLoop(ARMCache::Block* block);
 
     bool CheckCondition(u32 code)
     {
@@ -135,6 +140,13 @@ public:
     u32 CurInstr;
     u32 NextInstr[2];
 
+    // state at the start of the last idle loop candidate run
+    ARMCache::Block* IdleBlock;
+    u32 IdleR[16];
+    u32 IdleCPSR;
+    u32 IdleLoopEpoch;
+    u64 IdleTimestamp;
+
     u32 ExceptionBase;
 
     NDS::MemRegion CodeMem;
@@ -142,9 +154,12 @@ public:
     static u32 ConditionTable[16];
 };
 
-class ARMv5 : public ARM
+class ARMv5 final : public ARM
 {
 public:
+    // hides ARM::Num, so code templated on the CPU class knows it statically
+    static const u32 Num = 0;
+
     ARMv5();
 
     void Reset();
@@ -159,9 +174,12 @@ public:
     void DataAbort();
 
     void Execute();
+    void ExecuteCached();
 
     // all code accesses are forced nonseq 32bit
     u32 CodeRead32(u32 addr, bool branch);
+    // timing side of CodeRead32(), for when the opcode is already known
+    void SetCodeCycles(u32 addr);
 
     void DataRead8(u32 addr, u32* val);
     void DataRead16(u32 addr, u32* val);
@@ -268,14 +286,17 @@ public:
     u8* CurICacheLine;
 };
 
-class ARMv4 : public ARM
+class ARMv4 final : public ARM
 {
 public:
+    static const u32 Num = 1;
+
     ARMv4();
 
     void JumpTo(u32 addr, bool restorecpsr = false);
 
     void Execute();
+    void ExecuteCached();
 
     u16 CodeRead16(u32 addr)
     {
@@ -417,11 +438,11 @@ public:
     }
 };
 
-namespace ARMInterpreter
+namespace NDS
 {
 
-void A_UNK(ARM* cpu);
-void T_UNK(ARM* cpu);
+extern ARMv5* ARM9;
+extern ARMv4* ARM7;
 
 }
 
@@ -0,0 +1,526 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ARMCache.h"
+#include "ARM.h"
+#include "ARMInterpreter.h"
+#include "ARMJIT.h"
+#include "SPU.h"
+
+
+namespace ARMCache
+{
+
+const u32 kBlocksPerCPU = 4096;
+
+u8 PageFlags[kNumPages];
+u32 PageVersion[kNumPages];
+
+u32 MapGen;
+
+Block* BlockPool[2];
+u32 NumBlocks[2];
+Block* HashTable[2][kHashSize];
+
+
+bool Init()
+{
+    BlockPool[0] = new Block[kBlocksPerCPU];
+    BlockPool[1] = new Block[kBlocksPerCPU];
+
+    return true;
+}
+
+void DeInit()
+{
+    delete[] BlockPool[0];
+    delete[] BlockPool[1];
+}
+
+void Flush(u32 num)
+{
+    memset(HashTable[num], 0, sizeof(HashTable[num]));
+    NumBlocks[num] = 0;
+}
+
+void Reset()
+{
+    Flush(0);
+    Flush(1);
+
+    memset(PageFlags, 0, sizeof(PageFlags));
+    memset(PageVersion, 0, sizeof(PageVersion));
+
+    ARMJIT::Reset();
+}
+
+
+void PageWritten(u32 page)
+{
+    if (PageFlags[page] & kPage_SPU)
+        SPU::Sync();
+
+    if (PageFlags[page] & kPage_Idle)
+    {
+        NDS::IdleEpoch++;
+        PageFlags[page] &= ~kPage_Idle;
+    }
+
+    if (PageFlags[page] & kPage_Code)
+    {
+        PageVersion[page]++;
+        PageFlags[page] &= ~kPage_Code;
+    }
+}
+
+
+u8* TranslateAddr(u32 num, u32 addr, u32* codeaddr)
+{
+    if (num == 0)
+    {
+        if (addr < NDS::ARM9->ITCMSize)
+        {
+            *codeaddr = kCode_ITCM + (addr & 0x7FFF);
+            return &NDS::ARM9->ITCM[addr & 0x7FFF];
+        }
+
+        switch (addr & 0xFF000000)
+        {
+        case 0x02000000:
+            *codeaddr = kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1));
+            return &NDS::MainRAM[addr & (MAIN_RAM_SIZE - 1)];
+
+        case 0x03000000:
+            if (NDS::SWRAM_ARM9)
+            {
+                u8* ptr = &NDS::SWRAM_ARM9[addr & NDS::SWRAM_ARM9Mask];
+                *codeaddr = kCode_SharedWRAM + (ptr - NDS::SharedWRAM);
+                return ptr;
+            }
+            return NULL;
+        }
+
+        if ((addr & 0xFFFFF000) == 0xFFFF0000)
+        {
+            *codeaddr = kCode_ARM9BIOS + (addr & 0xFFF);
+            return &NDS::ARM9BIOS[addr & 0xFFF];
+        }
+
+        return NULL;
+    }
+    else
+    {
+        // code fetches from the BIOS always come from within the BIOS,
+        // so the read protection never kicks in for those
+        if (addr < 0x00004000)
+        {
+            *codeaddr = kCode_ARM7BIOS + addr;
+            return &NDS::ARM7BIOS[addr];
+        }
+
+        switch (addr & 0xFF800000)
+        {
+        case 0x02000000:
+        case 0x02800000:
+            *codeaddr = kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1));
+            return &NDS::MainRAM[addr & (MAIN_RAM_SIZE - 1)];
+
+        case 0x03000000:
+            if (NDS::SWRAM_ARM7)
+            {
+                u8* ptr = &NDS::SWRAM_ARM7[addr & NDS::SWRAM_ARM7Mask];
+                *codeaddr = kCode_SharedWRAM + (ptr - NDS::SharedWRAM);
+                return ptr;
+            }
+            // fallthrough
+
+        case 0x03800000:
+            *codeaddr = kCode_ARM7WRAM + (addr & 0xFFFF);
+            return &NDS::ARM7WRAM[addr & 0xFFFF];
+        }
+
+        return NULL;
+    }
+}
+
+
+bool IsBranchARM(u32 instr)
+{
+    if ((instr & 0x0E000000) == 0x0A000000) return true; // B/BL/BLX
+    if ((instr & 0x0FFFFFD0) == 0x012FFF10) return true; // BX/BLX
+    if ((instr & 0x0F000000) == 0x0F000000) return true; // SWI
+    if ((instr & 0x0E108000) == 0x08108000) return true; // LDM with PC
+    if ((instr & 0x0C000000) != 0x08000000 && (instr & 0x0000F000) == 0x0000F000) return true; // Rd=PC
+
+    return false;
+}
+
+bool IsBranchTHUMB(u32 instr)
+{
+    if ((instr & 0xF000) == 0xD000) return true; // conditional branch/SWI
+    if ((instr & 0xF800) == 0xE000) return true; // B
+    if ((instr & 0xF800) == 0xE800) return true; // BLX suffix
+    if ((instr & 0xF800) == 0xF800) return true; // BL suffix
+    if ((instr & 0xFF00) == 0x4700) return true; // BX/BLX
+    if ((instr & 0xFF00) == 0xBD00) return true; // POP with PC
+    if ((instr & 0xFC87) == 0x4487) return true; // hi reg ops with Rd=PC
+
+    return false;
+}
+
+// checks whether a block is a loop that could spin without side effects:
+// it has to branch back to its start, and only do ALU ops and loads (no
+// writeback). the loads' addresses must be computable from the register
+// values at the start of an iteration, so their base can't be written to
+// earlier in the loop
+void AnalyzeIdleLoop(u32 num, Block* block)
+{
+    block->IdleLoop = false;
+    block->NumIdleReads = 0;
+
+    if (block->NumInstrs < 1 || block->NumInstrs > kMaxIdleLoopSize)
+        return;
+
+    u32 start = block->Addr & ~1;
+    bool thumb = block->Addr & 1;
+    u32 size = thumb ? 2 : 4;
+    u32 written = 0;
+
+    for (u32 n = 0; n < block->NumInstrs; n++)
+    {
+        u32 instr = block->Instrs[n].Instr;
+        u32 addr = start + n*size;
+        bool last = (n == block->NumInstrs-1);
+
+        s32 base = -1;
+        s32 offset = 0;
+        s32 rd = -1;
+
+        if (thumb)
+        {
+            instr &= 0xFFFF;
+
+            if (last)
+            {
+                u32 target;
+                if ((instr & 0xF000) == 0xD000 && ((instr >> 8) & 0xF) < 0xE)
+                    target = addr + 4 + ((s32)(s8)(instr & 0xFF) << 1);
+                else if ((instr & 0xF800) == 0xE000)
+                    target = addr + 4 + (((s32)(instr << 21)) >> 20);
+                else
+                    return;
+
+                if (target != start) return;
+                break;
+            }
+
+            if (instr < 0x2000) // shifts, add/sub
+                rd = instr & 0x7;
+            else if (instr < 0x4000) // MOV/CMP/ADD/SUB imm
+            {
+                if ((instr & 0x1800) != 0x0800) rd = (instr >> 8) & 0x7;
+            }
+            else if (instr < 0x4400) // ALU ops
+            {
+                u32 op = (instr >> 6) & 0xF;
+                if (op != 0x8 && op != 0xA && op != 0xB) rd = instr & 0x7;
+            }
+            else if (instr < 0x4700) // hi reg ops
+            {
+                u32 op = (instr >> 8) & 0x3;
+                u32 r = (instr & 0x7) | ((instr >> 4) & 0x8);
+                if (op != 1)
+                {
+                    if (r == 15) return;
+                    rd = r;
+                }
+            }
+            else if ((instr & 0xF800) == 0x4800) // LDR PC-relative
+            {
+                rd = (instr >> 8) & 0x7;
+                base = 16;
+                offset = ((addr + 4) & ~2) + ((instr & 0xFF) << 2);
+            }
+            else if ((instr & 0xF800) == 0x6800) // LDR imm
+            {
+                rd = instr & 0x7;
+                base = (instr >> 3) & 0x7;
+                offset = ((instr >> 6) & 0x1F) << 2;
+            }
+            else if ((instr & 0xF800) == 0x7800) // LDRB imm
+            {
+                rd = instr & 0x7;
+                base = (instr >> 3) & 0x7;
+                offset = (instr >> 6) & 0x1F;
+            }
+            else if ((instr & 0xF800) == 0x8800) // LDRH imm
+            {
+                rd = instr & 0x7;
+                base = (instr >> 3) & 0x7;
+                offset = ((instr >> 6) & 0x1F) << 1;
+            }
+            else if ((instr & 0xF800) == 0x9800) // LDR SP-relative
+            {
+                rd = (instr >> 8) & 0x7;
+                base = 13;
+                offset = (instr & 0xFF) << 2;
+            }
+            else if ((instr & 0xF000) == 0xA000) // ADD PC/SP
+                rd = (instr >> 8) & 0x7;
+            else
+                return;
+        }
+        else
+        {
+            if ((instr >> 28) == 0xF) return;
+
+            if (last)
+            {
+                if ((instr & 0x0F000000) != 0x0A000000) return;
+
+                u32 target = addr + 8 + (((s32)(instr << 8)) >> 6);
+                if (target != start) return;
+                break;
+            }
+
+            if ((instr & 0x0C000000) == 0x00000000)
+            {
+                if (!(instr & 0x02000000) && (instr & 0x90) == 0x90)
+                {
+                    // LDRH/LDRSB/LDRSH imm, pre-indexed, no writeback
+                    if ((instr & 0x01700000) != 0x01500000) return;
+                    if (!(instr & 0x60)) return;
+
+                    rd = (instr >> 12) & 0xF;
+                    base = (instr >> 16) & 0xF;
+                    offset = ((instr >> 4) & 0xF0) | (instr & 0xF);
+                    if (!(instr & (1<<23))) offset = -offset;
+                }
+                else
+                {
+                    u32 op = (instr >> 21) & 0xF;
+                    bool test = (op >= 0x8 && op <= 0xB);
+                    if (test && !(instr & (1<<20))) return; // PSR transfer, BX, etc
+
+                    u32 r = (instr >> 12) & 0xF;
+                    if (r == 15) return;
+                    if (!test) rd = r;
+                }
+            }
+            else if ((instr & 0x0E000000) == 0x04000000)
+            {
+                // LDR/LDRB imm, pre-indexed, no writeback
+                if ((instr & 0x01300000) != 0x01100000) return;
+
+                rd = (instr >> 12) & 0xF;
+                if (rd == 15) return;
+                base = (instr >> 16) & 0xF;
+                offset = instr & 0xFFF;
+                if (!(instr & (1<<23))) offset = -offset;
+            }
+            else
+                return;
+
+            if (base == 15)
+            {
+                base = 16;
+                offset += addr + 8;
+            }
+        }
+
+        if (base != -1)
+        {
+            if (base < 16 && (written & (1 << base))) return;
+
+            block->IdleReadBase[block->NumIdleReads] = base;
+            block->IdleReadOffset[block->NumIdleReads] = offset;
+            block->NumIdleReads++;
+        }
+
+        if (rd != -1)
+            written |= (1 << rd);
+    }
+
+    block->IdleLoop = true;
+}
+
+bool IdleLoopReadsSafe(ARM* cpu, Block* block)
+{
+    for (u32 i = 0; i < block->NumIdleReads; i++)
+    {
+        u32 base = block->IdleReadBase[i];
+        u32 addr = block->IdleReadOffset[i];
+        if (base < 16) addr += cpu->R[base];
+
+        if (cpu->Num == 0)
+        {
+            ARMv5* v5 = (ARMv5*)cpu;
+            if (addr < v5->ITCMSize) continue;
+            if (addr >= v5->DTCMBase && addr < (v5->DTCMBase + v5->DTCMSize)) continue;
+        }
+
+        if (!NDS::IdleLoopSafeRead(cpu->Num, addr))
+            return false;
+    }
+
+    return true;
+}
+
+void WatchIdleLoop(ARM* cpu, Block* block)
+{
+    PageFlags[block->StartPage] |= kPage_Idle;
+    PageFlags[block->EndPage] |= kPage_Idle;
+
+    for (u32 i = 0; i < block->NumIdleReads; i++)
+    {
+        u32 base = block->IdleReadBase[i];
+        u32 addr = block->IdleReadOffset[i];
+        if (base < 16) addr += cpu->R[base];
+
+        // TCM and IO don't need it: only the CPU itself writes to TCM,
+        // and IO writes always bump the epoch
+        u32 codeaddr;
+        if ((addr & 0xFE000000) == 0x02000000 && TranslateAddr(cpu->Num, addr, &codeaddr))
+            PageFlags[codeaddr >> kPageShift] |= kPage_Idle;
+    }
+}
+
+
+void BuildBlock(u32 num, Block* block)
+{
+    u32 addr = block->Addr & ~1;
+    bool thumb = block->Addr & 1;
+    u32 size = thumb ? 2 : 4;
+
+    block->StartPage = block->CodeAddr >> kPageShift;
+    block->EndPage = block->StartPage;
+    block->JITCode = NULL;
+
+    // the instruction values are the ones the prefetch in Execute() would yield,
+    // so that the CPU state stays the same whichever path is taken.
+    // on the ARM9, THUMB code is fetched 32 bits at a time, and the MSBs are
+    // left as garbage when the opcode is word-aligned
+    u32 n = 0;
+    u32 numinstrs = kMaxBlockSize;
+    while (n < numinstrs+2)
+    {
+        u32 curaddr;
+        u8* ptr = TranslateAddr(num, addr + n*size, &curaddr);
+        if (!ptr || curaddr != block->CodeAddr + n*size)
+            break;
+
+        BlockEntry* entry = &block->Instrs[n];
+        u32 instr;
+        if (!thumb || (num == 0 && !(curaddr & 0x2)))
+            instr = *(u32*)ptr;
+        else
+            instr = *(u16*)ptr;
+
+        entry->Instr = instr;
+        if (thumb)
+        {
+            entry->Cond = 0xE;
+            entry->Handler = (num == 0) ? ARMInterpreter::ARM9Tables::THUMBInstrTable[(instr >> 6) & 0x3FF]
+                                        : ARMInterpreter::ARM7Tables::THUMBInstrTable[(instr >> 6) & 0x3FF];
+        }
+        else if (num == 0 && (instr & 0xFE000000) == 0xFA000000)
+        {
+            entry->Cond = 0xE;
+            entry->Handler = ARMInterpreter::A_BLX_IMM<ARMv5>;
+        }
+        else
+        {
+            entry->Cond = instr >> 28;
+            u32 icode = ((instr >> 4) & 0xF) | ((instr >> 16) & 0xFF0);
+            entry->Handler = (num == 0) ? ARMInterpreter::ARM9Tables::ARMInstrTable[icode]
+                                        : ARMInterpreter::ARM7Tables::ARMInstrTable[icode];
+        }
+
+        block->EndPage = curaddr >> kPageShift;
+        n++;
+
+        // end the block after a branch, but still decode the two
+        // instructions that get prefetched after it
+        if (n <= numinstrs && (thumb ? IsBranchTHUMB(instr) : IsBranchARM(instr)))
+            numinstrs = n;
+    }
+
+    if (n < 2)                   block->NumInstrs = 0;
+    else if (n < numinstrs+2)    block->NumInstrs = n - 2;
+    else                         block->NumInstrs = numinstrs;
+
+    block->StartVersion = PageVersion[block->StartPage];
+    block->EndVersion = PageVersion[block->EndPage];
+    PageFlags[block->StartPage] |= kPage_Code;
+    PageFlags[block->EndPage] |= kPage_Code;
+
+    AnalyzeIdleLoop(num, block);
+}
+
+Block* LookupBlockSlow(u32 num, u32 addr)
+{
+    u32 codeaddr;
+    if (!TranslateAddr(num, addr & ~1, &codeaddr))
+        return NULL;
+
+    u32 hash = (addr >> 1) & (kHashSize-1);
+    Block** prev = &HashTable[num][hash];
+    Block* block = *prev;
+    while (block)
+    {
+        if (block->Addr == addr && block->CodeAddr == codeaddr)
+        {
+            if (!BlockValid(block))
+                BuildBlock(num, block);
+
+            block->MapGen = MapGen;
+
+            // move it to the front
+            *prev = block->Next;
+            block->Next = HashTable[num][hash];
+            HashTable[num][hash] = block;
+
+            return block->NumInstrs ? block : NULL;
+        }
+
+        prev = &block->Next;
+        block = block->Next;
+    }
+
+    if (NumBlocks[num] >= kBlocksPerCPU)
+    {
+        // out of blocks. start over
+        Flush(num);
+    }
+
+    block = &BlockPool[num][NumBlocks[num]++];
+    block->Addr = addr;
+    block->CodeAddr = codeaddr;
+    block->MapGen = MapGen;
+    block->Next = HashTable[num][hash];
+    HashTable[num][hash] = block;
+
+    BuildBlock(num, block);
+
+    // blocks we can't run are kept around anyway, so we don't retry them all the time
+    return block->NumInstrs ? block : NULL;
+}
+
+}
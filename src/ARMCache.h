@@ -0,0 +1,156 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ARMCACHE_H
+#define ARMCACHE_H
+
+#include "types.h"
+
+class ARM;
+
+// basic block cache for the CPU cores
+//
+// code is pre-decoded into runs of instructions (handler + condition) so the
+// execute loop doesn't have to go through the prefetch/decode steps for every
+// instruction. blocks are keyed by CPU address, and validated against a
+// 'code address' which identifies the backing memory (main RAM, WRAM, ITCM,
+// BIOS). writes to a page that holds code bump that page's version, which
+// invalidates any block built from it.
+//
+// the same page flags are used by the SPU to get notified of writes to the
+// sample data it has yet to mix, and by idle loop skipping.
+//
+// blocks are also checked for idle loops: short loops branching back to
+// their own start, made only of ALU ops and loads. see ARM::CheckIdleLoop().
+
+namespace ARMCache
+{
+
+// code address space layout
+const u32 kCode_MainRAM = 0x000000;
+const u32 kCode_SharedWRAM = 0x400000;
+const u32 kCode_ARM7WRAM = 0x408000;
+const u32 kCode_ITCM = 0x418000;
+const u32 kCode_ARM9BIOS = 0x420000;
+const u32 kCode_ARM7BIOS = 0x421000;
+const u32 kCode_End = 0x425000;
+
+const u32 kPageShift = 9;
+const u32 kNumPages = kCode_End >> kPageShift;
+
+const u32 kMaxBlockSize = 32;
+
+const u32 kHashSize = 0x4000;
+
+const u32 kMaxIdleLoopSize = 8;
+
+// page flags
+const u8 kPage_Code = 0x01;
+const u8 kPage_SPU = 0x02;
+const u8 kPage_Idle = 0x04;
+
+struct BlockEntry
+{
+    u32 Instr;
+    u32 Cond;
+    void (*Handler)(ARM* cpu);
+};
+
+struct Block
+{
+    u32 Addr; // CPU address, bit0 set for THUMB
+    u32 CodeAddr;
+    u32 MapGen;
+    u32 NumInstrs;
+
+    // the page of the first instruction, and the page of the last prefetched one
+    u32 StartPage, EndPage;
+    u32 StartVersion, EndVersion;
+
+    Block* Next;
+
+    // native code, if the JIT is used
+    void* JITCode;
+
+    // idle loop candidate, and the loads it does
+    // (base register 16: absolute address)
+    bool IdleLoop;
+    u32 NumIdleReads;
+    u8 IdleReadBase[kMaxIdleLoopSize];
+    s32 IdleReadOffset[kMaxIdleLoopSize];
+
+    // two extra entries for the prefetched instructions after the last one
+    BlockEntry Instrs[kMaxBlockSize+2];
+};
+
+extern u8 PageFlags[kNumPages];
+extern u32 PageVersion[kNumPages];
+
+extern u32 MapGen;
+extern Block* HashTable[2][kHashSize];
+
+bool Init();
+void DeInit();
+void Reset();
+void Flush(u32 num);
+
+// to be called when the CPU address -> code address mapping changes
+// (shared WRAM mapping, ITCM size)
+inline void UpdateMapping()
+{
+    MapGen++;
+}
+
+inline bool BlockValid(Block* block)
+{
+    return PageVersion[block->StartPage] == block->StartVersion &&
+           PageVersion[block->EndPage] == block->EndVersion;
+}
+
+Block* LookupBlockSlow(u32 num, u32 addr);
+
+inline Block* LookupBlock(u32 num, u32 addr)
+{
+    // the last block used in a given slot is kept first in its chain
+    // if the mapping didn't change since, it doesn't need to be translated again
+    Block* block = HashTable[num][(addr >> 1) & (kHashSize-1)];
+    if (block && block->Addr == addr && block->MapGen == MapGen && block->NumInstrs && BlockValid(block))
+        return block;
+
+    return LookupBlockSlow(num, addr);
+}
+
+void PageWritten(u32 page);
+
+// whether the loads of an idle loop candidate, with the current register
+// values, only hit memory that can't change while the CPU is spinning
+bool IdleLoopReadsSafe(ARM* cpu, Block* block);
+// flag the pages an idle loop depends on (code and RAM it reads), so writes
+// to them bump NDS::IdleEpoch
+void WatchIdleLoop(ARM* cpu, Block* block);
+
+// to be called before the write is done, the SPU may need the old data
+inline void CheckWrite(u32 codeaddr)
+{
+    u32 page = codeaddr >> kPageShift;
+    if (PageFlags[page]) PageWritten(page);
+}
+
+}
+
+#endif // ARMCACHE_H
@@ -28,8 +28,10 @@ namespace ARMInterpreter
 {
 
 
-void A_UNK(ARM* cpu)
+template <typename CPU>
+void A_UNK(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     printf("undefined ARM%d instruction %08X @ %08X\n", cpu->Num?7:9, cpu->CurInstr, cpu->R[15]-8);
     //for (int i = 0; i < 16; i++) printf("R%d: %08X\n", i, cpu->R[i]);
     //NDS::Halt();
@@ -43,8 +45,10 @@ void A_UNK(ARM* cpu)
     cpu->JumpTo(cpu->ExceptionBase + 0x04);
 }
 
-void T_UNK(ARM* cpu)
+template <typename CPU>
+void T_UNK(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     printf("undefined THUMB%d instruction %04X @ %08X\n", cpu->Num?7:9, cpu->CurInstr, cpu->R[15]-4);
     //NDS::Halt();
     u32 oldcpsr = cpu->CPSR;
@@ -59,8 +63,10 @@ void T_UNK(ARM* cpu)
 
 
 
-void A_MSR_IMM(ARM* cpu)
+template <typename CPU>
+void A_MSR_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32* psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -101,8 +107,10 @@ void A_MSR_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_MSR_REG(ARM* cpu)
+template <typename CPU>
+void A_MSR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32* psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -143,8 +151,10 @@ void A_MSR_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_MRS(ARM* cpu)
+template <typename CPU>
+void A_MRS(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 psr;
     if (cpu->CurInstr & (1<<22))
     {
@@ -166,8 +176,10 @@ void A_MRS(ARM* cpu)
 }
 
 
-void A_MCR(ARM* cpu)
+template <typename CPU>
+void A_MCR(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 cp = (cpu->CurInstr >> 8) & 0xF;
     //u32 op = (cpu->CurInstr >> 21) & 0x7;
     u32 cn = (cpu->CurInstr >> 16) & 0xF;
@@ -185,14 +197,16 @@ void A_MCR(ARM* cpu)
     else
     {
         printf("bad MCR opcode p%d,%d,%d,%d on ARM%d\n", cp, cn, cm, cpinfo, cpu->Num?7:9);
-        return A_UNK(cpu); // TODO: check what kind of exception it really is
+        return A_UNK<CPU>(cpu); // TODO: check what kind of exception it really is
     }
 
     cpu->AddCycles_CI(1 + 1); // TODO: checkme
 }
 
-void A_MRC(ARM* cpu)
+template <typename CPU>
+void A_MRC(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 cp = (cpu->CurInstr >> 8) & 0xF;
     //u32 op = (cpu->CurInstr >> 21) & 0x7;
     u32 cn = (cpu->CurInstr >> 16) & 0xF;
@@ -210,7 +224,7 @@ void A_MRC(ARM* cpu)
     else
     {
         printf("bad MRC opcode p%d,%d,%d,%d on ARM%d\n", cp, cn, cm, cpinfo, cpu->Num?7:9);
-        return A_UNK(cpu); // TODO: check what kind of exception it really is
+        return A_UNK<CPU>(cpu); // TODO: check what kind of exception it really is
     }
 
     cpu->AddCycles_CI(2 + 1); // TODO: checkme
@@ -218,8 +232,10 @@ void A_MRC(ARM* cpu)
 
 
 
-void A_SVC(ARM* cpu)
+template <typename CPU>
+void A_SVC(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x93;
@@ -230,8 +246,10 @@ void A_SVC(ARM* cpu)
     cpu->JumpTo(cpu->ExceptionBase + 0x08);
 }
 
-void T_SVC(ARM* cpu)
+template <typename CPU>
+void T_SVC(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 oldcpsr = cpu->CPSR;
     cpu->CPSR &= ~0xBF;
     cpu->CPSR |= 0x93;
@@ -244,8 +262,39 @@ void T_SVC(ARM* cpu)
 
 
 
+INSTRFUNCS_MISC(INSTRFUNC_INSTANTIATE)
+
+
+// the tables are filled in namespaces where each handler name refers to the
+// instance for the CPU
+#define INSTRFUNC_ALIAS(x) constexpr void (*x)(ARM* cpu) = ARMInterpreter::x<CPU>;
 #define INSTRFUNC_PROTO(x)  void (*x)(ARM* cpu)
+
+namespace ARM9Tables
+{
+typedef ARMv5 CPU;
+
+INSTRFUNCS_MISC(INSTRFUNC_ALIAS)
+INSTRFUNCS_ALU(INSTRFUNC_ALIAS)
+INSTRFUNCS_LOADSTORE(INSTRFUNC_ALIAS)
+INSTRFUNCS_BRANCH(INSTRFUNC_ALIAS)
+
+#include "ARM_InstrTable.h"
+}
+
+namespace ARM7Tables
+{
+typedef ARMv4 CPU;
+
+INSTRFUNCS_MISC(INSTRFUNC_ALIAS)
+INSTRFUNCS_ALU(INSTRFUNC_ALIAS)
+INSTRFUNCS_LOADSTORE(INSTRFUNC_ALIAS)
+INSTRFUNCS_BRANCH(INSTRFUNC_ALIAS)
+
 #include "ARM_InstrTable.h"
+}
+
 #undef INSTRFUNC_PROTO
+#undef INSTRFUNC_ALIAS
 
 }
@@ -25,10 +25,41 @@
 namespace ARMInterpreter
 {
 
+// instruction handlers are templates over the CPU class (ARMv5 or ARMv4), so
+// memory accesses and cycle counting resolve at compile time. each file lists
+// its handlers in a macro, used to declare and to instantiate them.
+#define INSTRFUNC_DECLARE(x) template <typename CPU> void x(ARM* cpu);
+#define INSTRFUNC_INSTANTIATE(x) template void x<ARMv5>(ARM* cpu); template void x<ARMv4>(ARM* cpu);
+
+#define INSTRFUNCS_MISC(f) \
+    f(A_UNK) \
+    f(T_UNK) \
+\
+    f(A_MSR_IMM) \
+    f(A_MSR_REG) \
+    f(A_MRS) \
+    f(A_MCR) \
+    f(A_MRC) \
+\
+    f(A_SVC) \
+    f(T_SVC)
+
+INSTRFUNCS_MISC(INSTRFUNC_DECLARE)
+
+template <typename CPU> void A_BLX_IMM(ARM* cpu); // I'm a special one look at me
+
+// one set of tables per CPU
+namespace ARM9Tables
+{
 extern void (*ARMInstrTable[4096])(ARM* cpu);
 extern void (*THUMBInstrTable[1024])(ARM* cpu);
+}
 
-void A_BLX_IMM(ARM* cpu); // I'm a special one look at me
+namespace ARM7Tables
+{
+extern void (*ARMInstrTable[4096])(ARM* cpu);
+extern void (*THUMBInstrTable[1024])(ARM* cpu);
+}
 
 }
 
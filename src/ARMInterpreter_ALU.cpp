@@ -18,6 +18,8 @@
 
 #include <stdio.h>
 #include "ARM.h"
+#include "ARMInterpreter.h"
+#include "ARMInterpreter_ALU.h"
 
 
 #define CARRY_ADD(a, b)  ((0xFFFFFFFF-a) < b)
@@ -139,141 +141,195 @@ namespace ARMInterpreter
 
 #define A_IMPLEMENT_ALU_OP(x,s) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_IMM \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_ASR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_ROR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_LSR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_ASR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG) \
     A_##x(1) \
 } \
-void A_##x##_REG_ROR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG) \
     A_##x(1) \
 } \
-void A_##x##_IMM_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_IMM_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_IMM \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSL_IMM_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_IMM_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSR_IMM_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_IMM_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_ASR_IMM_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_IMM_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_ROR_IMM_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_IMM_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM##s) \
     A_##x##_S(0) \
 } \
-void A_##x##_REG_LSL_REG_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_REG_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_LSR_REG_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_REG_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_ASR_REG_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_REG_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG##s) \
     A_##x##_S(1) \
 } \
-void A_##x##_REG_ROR_REG_S(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_REG_S(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG##s) \
     A_##x##_S(1) \
 }
 
 #define A_IMPLEMENT_ALU_TEST(x,s) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_IMM \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSL_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(LSR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_ASR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ASR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_ROR_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_IMM(ROR_IMM##s) \
     A_##x(0) \
 } \
-void A_##x##_REG_LSL_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSL_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_LSR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(LSR_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_ASR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ASR_REG##s) \
     A_##x(1) \
 } \
-void A_##x##_REG_ROR_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_CALC_OP2_REG_SHIFT_REG(ROR_REG##s) \
     A_##x(1) \
 }
@@ -647,9 +703,11 @@ A_IMPLEMENT_ALU_OP(ORR,_S)
 A_IMPLEMENT_ALU_OP(MOV,_S)
 
 // debug hook
-void A_MOV_REG_LSL_IMM_DBG(ARM* cpu)
+template <typename CPU>
+void A_MOV_REG_LSL_IMM_DBG(ARM* arm)
 {
-    A_MOV_REG_LSL_IMM(cpu);
+    CPU* cpu = (CPU*)arm;
+    A_MOV_REG_LSL_IMM<CPU>(cpu);
 
     // nocash-style debugging hook
     if ( cpu->CurInstr == 0xE1A0C00C &&                   // mov r12, r12
@@ -723,8 +781,10 @@ A_IMPLEMENT_ALU_OP(MVN,_S)
 
 
 
-void A_MUL(ARM* cpu)
+template <typename CPU>
+void A_MUL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
 
@@ -752,8 +812,10 @@ void A_MUL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_MLA(ARM* cpu)
+template <typename CPU>
+void A_MLA(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
     u32 rn = cpu->R[(cpu->CurInstr >> 12) & 0xF];
@@ -782,8 +844,10 @@ void A_MLA(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_UMULL(ARM* cpu)
+template <typename CPU>
+void A_UMULL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
 
@@ -812,8 +876,10 @@ void A_UMULL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_UMLAL(ARM* cpu)
+template <typename CPU>
+void A_UMLAL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
 
@@ -845,8 +911,10 @@ void A_UMLAL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMULL(ARM* cpu)
+template <typename CPU>
+void A_SMULL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
 
@@ -875,8 +943,10 @@ void A_SMULL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMLAL(ARM* cpu)
+template <typename CPU>
+void A_SMLAL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rs = cpu->R[(cpu->CurInstr >> 8) & 0xF];
 
@@ -908,8 +978,10 @@ void A_SMLAL(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void A_SMLAxy(ARM* cpu)
+template <typename CPU>
+void A_SMLAxy(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num != 0) return;
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -931,8 +1003,10 @@ void A_SMLAxy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMLAWy(ARM* cpu)
+template <typename CPU>
+void A_SMLAWy(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num != 0) return;
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -952,8 +1026,10 @@ void A_SMLAWy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMULxy(ARM* cpu)
+template <typename CPU>
+void A_SMULxy(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num != 0) return;
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -970,8 +1046,10 @@ void A_SMULxy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMULWy(ARM* cpu)
+template <typename CPU>
+void A_SMULWy(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num != 0) return;
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -986,8 +1064,10 @@ void A_SMULWy(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_SMLALxy(ARM* cpu)
+template <typename CPU>
+void A_SMLALxy(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num != 0) return;
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
@@ -1011,9 +1091,11 @@ void A_SMLALxy(ARM* cpu)
 
 
 
-void A_CLZ(ARM* cpu)
+template <typename CPU>
+void A_CLZ(ARM* arm)
 {
-    if (cpu->Num != 0) return A_UNK(cpu);
+    CPU* cpu = (CPU*)arm;
+    if (cpu->Num != 0) return A_UNK<CPU>(cpu);
 
     u32 val = cpu->R[cpu->CurInstr & 0xF];
 
@@ -1035,9 +1117,11 @@ void A_CLZ(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void A_QADD(ARM* cpu)
+template <typename CPU>
+void A_QADD(ARM* arm)
 {
-    if (cpu->Num != 0) return A_UNK(cpu);
+    CPU* cpu = (CPU*)arm;
+    if (cpu->Num != 0) return A_UNK<CPU>(cpu);
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rn = cpu->R[(cpu->CurInstr >> 16) & 0xF];
@@ -1053,9 +1137,11 @@ void A_QADD(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QSUB(ARM* cpu)
+template <typename CPU>
+void A_QSUB(ARM* arm)
 {
-    if (cpu->Num != 0) return A_UNK(cpu);
+    CPU* cpu = (CPU*)arm;
+    if (cpu->Num != 0) return A_UNK<CPU>(cpu);
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rn = cpu->R[(cpu->CurInstr >> 16) & 0xF];
@@ -1071,9 +1157,11 @@ void A_QSUB(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QDADD(ARM* cpu)
+template <typename CPU>
+void A_QDADD(ARM* arm)
 {
-    if (cpu->Num != 0) return A_UNK(cpu);
+    CPU* cpu = (CPU*)arm;
+    if (cpu->Num != 0) return A_UNK<CPU>(cpu);
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rn = cpu->R[(cpu->CurInstr >> 16) & 0xF];
@@ -1097,9 +1185,11 @@ void A_QDADD(ARM* cpu)
     cpu->AddCycles_C(); // TODO: interlock??
 }
 
-void A_QDSUB(ARM* cpu)
+template <typename CPU>
+void A_QDSUB(ARM* arm)
 {
-    if (cpu->Num != 0) return A_UNK(cpu);
+    CPU* cpu = (CPU*)arm;
+    if (cpu->Num != 0) return A_UNK<CPU>(cpu);
 
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
     u32 rn = cpu->R[(cpu->CurInstr >> 16) & 0xF];
@@ -1129,8 +1219,10 @@ void A_QDSUB(ARM* cpu)
 
 
 
-void T_LSL_IMM(ARM* cpu)
+template <typename CPU>
+void T_LSL_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     LSL_IMM_S(op, s);
@@ -1140,8 +1232,10 @@ void T_LSL_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_LSR_IMM(ARM* cpu)
+template <typename CPU>
+void T_LSR_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     LSR_IMM_S(op, s);
@@ -1151,8 +1245,10 @@ void T_LSR_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ASR_IMM(ARM* cpu)
+template <typename CPU>
+void T_ASR_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 op = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 s = (cpu->CurInstr >> 6) & 0x1F;
     ASR_IMM_S(op, s);
@@ -1162,8 +1258,10 @@ void T_ASR_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ADD_REG_(ARM* cpu)
+template <typename CPU>
+void T_ADD_REG_(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 6) & 0x7];
     u32 res = a + b;
@@ -1175,8 +1273,10 @@ void T_ADD_REG_(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_SUB_REG_(ARM* cpu)
+template <typename CPU>
+void T_SUB_REG_(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 6) & 0x7];
     u32 res = a - b;
@@ -1188,8 +1288,10 @@ void T_SUB_REG_(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ADD_IMM_(ARM* cpu)
+template <typename CPU>
+void T_ADD_IMM_(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = (cpu->CurInstr >> 6) & 0x7;
     u32 res = a + b;
@@ -1201,8 +1303,10 @@ void T_ADD_IMM_(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_SUB_IMM_(ARM* cpu)
+template <typename CPU>
+void T_SUB_IMM_(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 b = (cpu->CurInstr >> 6) & 0x7;
     u32 res = a - b;
@@ -1214,8 +1318,10 @@ void T_SUB_IMM_(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_MOV_IMM(ARM* cpu)
+template <typename CPU>
+void T_MOV_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 b = cpu->CurInstr & 0xFF;
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = b;
     cpu->SetNZ(0,
@@ -1223,8 +1329,10 @@ void T_MOV_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_CMP_IMM(ARM* cpu)
+template <typename CPU>
+void T_CMP_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a - b;
@@ -1235,8 +1343,10 @@ void T_CMP_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ADD_IMM(ARM* cpu)
+template <typename CPU>
+void T_ADD_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a + b;
@@ -1248,8 +1358,10 @@ void T_ADD_IMM(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_SUB_IMM(ARM* cpu)
+template <typename CPU>
+void T_SUB_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     u32 b = cpu->CurInstr & 0xFF;
     u32 res = a - b;
@@ -1262,8 +1374,10 @@ void T_SUB_IMM(ARM* cpu)
 }
 
 
-void T_AND_REG(ARM* cpu)
+template <typename CPU>
+void T_AND_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & b;
@@ -1273,8 +1387,10 @@ void T_AND_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_EOR_REG(ARM* cpu)
+template <typename CPU>
+void T_EOR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a ^ b;
@@ -1284,8 +1400,10 @@ void T_EOR_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_LSL_REG(ARM* cpu)
+template <typename CPU>
+void T_LSL_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     LSL_REG_S(a, b);
@@ -1295,8 +1413,10 @@ void T_LSL_REG(ARM* cpu)
     cpu->AddCycles_CI(1);
 }
 
-void T_LSR_REG(ARM* cpu)
+template <typename CPU>
+void T_LSR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     LSR_REG_S(a, b);
@@ -1306,8 +1426,10 @@ void T_LSR_REG(ARM* cpu)
     cpu->AddCycles_CI(1);
 }
 
-void T_ASR_REG(ARM* cpu)
+template <typename CPU>
+void T_ASR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     ASR_REG_S(a, b);
@@ -1317,8 +1439,10 @@ void T_ASR_REG(ARM* cpu)
     cpu->AddCycles_CI(1);
 }
 
-void T_ADC_REG(ARM* cpu)
+template <typename CPU>
+void T_ADC_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res_tmp = a + b;
@@ -1332,8 +1456,10 @@ void T_ADC_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_SBC_REG(ARM* cpu)
+template <typename CPU>
+void T_SBC_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res_tmp = a - b;
@@ -1347,8 +1473,10 @@ void T_SBC_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ROR_REG(ARM* cpu)
+template <typename CPU>
+void T_ROR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7] & 0xFF;
     ROR_REG_S(a, b);
@@ -1358,8 +1486,10 @@ void T_ROR_REG(ARM* cpu)
     cpu->AddCycles_CI(1);
 }
 
-void T_TST_REG(ARM* cpu)
+template <typename CPU>
+void T_TST_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & b;
@@ -1368,8 +1498,10 @@ void T_TST_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_NEG_REG(ARM* cpu)
+template <typename CPU>
+void T_NEG_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = -b;
     cpu->R[cpu->CurInstr & 0x7] = res;
@@ -1380,8 +1512,10 @@ void T_NEG_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_CMP_REG(ARM* cpu)
+template <typename CPU>
+void T_CMP_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a - b;
@@ -1392,8 +1526,10 @@ void T_CMP_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_CMN_REG(ARM* cpu)
+template <typename CPU>
+void T_CMN_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a + b;
@@ -1404,8 +1540,10 @@ void T_CMN_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_ORR_REG(ARM* cpu)
+template <typename CPU>
+void T_ORR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a | b;
@@ -1415,8 +1553,10 @@ void T_ORR_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_MUL_REG(ARM* cpu)
+template <typename CPU>
+void T_MUL_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a * b;
@@ -1440,8 +1580,10 @@ void T_MUL_REG(ARM* cpu)
     cpu->AddCycles_CI(cycles);
 }
 
-void T_BIC_REG(ARM* cpu)
+template <typename CPU>
+void T_BIC_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 a = cpu->R[cpu->CurInstr & 0x7];
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = a & ~b;
@@ -1451,8 +1593,10 @@ void T_BIC_REG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_MVN_REG(ARM* cpu)
+template <typename CPU>
+void T_MVN_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 b = cpu->R[(cpu->CurInstr >> 3) & 0x7];
     u32 res = ~b;
     cpu->R[cpu->CurInstr & 0x7] = res;
@@ -1465,8 +1609,10 @@ void T_MVN_REG(ARM* cpu)
 // TODO: check those when MSBs and MSBd are cleared
 // GBAtek says it's not allowed, but it works atleast on the ARM9
 
-void T_ADD_HIREG(ARM* cpu)
+template <typename CPU>
+void T_ADD_HIREG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
 
@@ -1485,8 +1631,10 @@ void T_ADD_HIREG(ARM* cpu)
     }
 }
 
-void T_CMP_HIREG(ARM* cpu)
+template <typename CPU>
+void T_CMP_HIREG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
 
@@ -1501,8 +1649,10 @@ void T_CMP_HIREG(ARM* cpu)
     cpu->AddCycles_C();
 }
 
-void T_MOV_HIREG(ARM* cpu)
+template <typename CPU>
+void T_MOV_HIREG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 rd = (cpu->CurInstr & 0x7) | ((cpu->CurInstr >> 4) & 0x8);
     u32 rs = (cpu->CurInstr >> 3) & 0xF;
 
@@ -1528,24 +1678,30 @@ void T_MOV_HIREG(ARM* cpu)
 }
 
 
-void T_ADD_PCREL(ARM* cpu)
+template <typename CPU>
+void T_ADD_PCREL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 val = cpu->R[15] & ~2;
     val += ((cpu->CurInstr & 0xFF) << 2);
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = val;
     cpu->AddCycles_C();
 }
 
-void T_ADD_SPREL(ARM* cpu)
+template <typename CPU>
+void T_ADD_SPREL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 val = cpu->R[13];
     val += ((cpu->CurInstr & 0xFF) << 2);
     cpu->R[(cpu->CurInstr >> 8) & 0x7] = val;
     cpu->AddCycles_C();
 }
 
-void T_ADD_SP(ARM* cpu)
+template <typename CPU>
+void T_ADD_SP(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 val = cpu->R[13];
     if (cpu->CurInstr & (1<<7))
         val -= ((cpu->CurInstr & 0x7F) << 2);
@@ -1556,4 +1712,6 @@ void T_ADD_SP(ARM* cpu)
 }
 
 
+INSTRFUNCS_ALU(INSTRFUNC_INSTANTIATE)
+
 }
@@ -22,115 +22,115 @@
 namespace ARMInterpreter
 {
 
-#define A_PROTO_ALU_OP(x) \
+#define A_PROTO_ALU_OP(x, f) \
+    f(A_##x##_IMM) \
+    f(A_##x##_REG_LSL_IMM) \
+    f(A_##x##_REG_LSR_IMM) \
+    f(A_##x##_REG_ASR_IMM) \
+    f(A_##x##_REG_ROR_IMM) \
+    f(A_##x##_REG_LSL_REG) \
+    f(A_##x##_REG_LSR_REG) \
+    f(A_##x##_REG_ASR_REG) \
+    f(A_##x##_REG_ROR_REG) \
+    f(A_##x##_IMM_S) \
+    f(A_##x##_REG_LSL_IMM_S) \
+    f(A_##x##_REG_LSR_IMM_S) \
+    f(A_##x##_REG_ASR_IMM_S) \
+    f(A_##x##_REG_ROR_IMM_S) \
+    f(A_##x##_REG_LSL_REG_S) \
+    f(A_##x##_REG_LSR_REG_S) \
+    f(A_##x##_REG_ASR_REG_S) \
+    f(A_##x##_REG_ROR_REG_S)
+
+#define A_PROTO_ALU_TEST(x, f) \
+    f(A_##x##_IMM) \
+    f(A_##x##_REG_LSL_IMM) \
+    f(A_##x##_REG_LSR_IMM) \
+    f(A_##x##_REG_ASR_IMM) \
+    f(A_##x##_REG_ROR_IMM) \
+    f(A_##x##_REG_LSL_REG) \
+    f(A_##x##_REG_LSR_REG) \
+    f(A_##x##_REG_ASR_REG) \
+    f(A_##x##_REG_ROR_REG)
+
+#define INSTRFUNCS_ALU(f) \
+    A_PROTO_ALU_OP(AND, f) \
+    A_PROTO_ALU_OP(EOR, f) \
+    A_PROTO_ALU_OP(SUB, f) \
+    A_PROTO_ALU_OP(RSB, f) \
+    A_PROTO_ALU_OP(ADD, f) \
+    A_PROTO_ALU_OP(ADC, f) \
+    A_PROTO_ALU_OP(SBC, f) \
+    A_PROTO_ALU_OP(RSC, f) \
+    A_PROTO_ALU_TEST(TST, f) \
+    A_PROTO_ALU_TEST(TEQ, f) \
+    A_PROTO_ALU_TEST(CMP, f) \
+    A_PROTO_ALU_TEST(CMN, f) \
+    A_PROTO_ALU_OP(ORR, f) \
+    A_PROTO_ALU_OP(MOV, f) \
+    A_PROTO_ALU_OP(BIC, f) \
+    A_PROTO_ALU_OP(MVN, f) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_IMM(ARM* cpu); \
-void A_##x##_REG_LSR_IMM(ARM* cpu); \
-void A_##x##_REG_ASR_IMM(ARM* cpu); \
-void A_##x##_REG_ROR_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_REG(ARM* cpu); \
-void A_##x##_REG_LSR_REG(ARM* cpu); \
-void A_##x##_REG_ASR_REG(ARM* cpu); \
-void A_##x##_REG_ROR_REG(ARM* cpu); \
-void A_##x##_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSL_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSR_IMM_S(ARM* cpu); \
-void A_##x##_REG_ASR_IMM_S(ARM* cpu); \
-void A_##x##_REG_ROR_IMM_S(ARM* cpu); \
-void A_##x##_REG_LSL_REG_S(ARM* cpu); \
-void A_##x##_REG_LSR_REG_S(ARM* cpu); \
-void A_##x##_REG_ASR_REG_S(ARM* cpu); \
-void A_##x##_REG_ROR_REG_S(ARM* cpu);
-
-#define A_PROTO_ALU_TEST(x) \
+    f(A_MOV_REG_LSL_IMM_DBG) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_IMM(ARM* cpu); \
-void A_##x##_REG_LSR_IMM(ARM* cpu); \
-void A_##x##_REG_ASR_IMM(ARM* cpu); \
-void A_##x##_REG_ROR_IMM(ARM* cpu); \
-void A_##x##_REG_LSL_REG(ARM* cpu); \
-void A_##x##_REG_LSR_REG(ARM* cpu); \
-void A_##x##_REG_ASR_REG(ARM* cpu); \
-void A_##x##_REG_ROR_REG(ARM* cpu);
-
-A_PROTO_ALU_OP(AND)
-A_PROTO_ALU_OP(EOR)
-A_PROTO_ALU_OP(SUB)
-A_PROTO_ALU_OP(RSB)
-A_PROTO_ALU_OP(ADD)
-A_PROTO_ALU_OP(ADC)
-A_PROTO_ALU_OP(SBC)
-A_PROTO_ALU_OP(RSC)
-A_PROTO_ALU_TEST(TST)
-A_PROTO_ALU_TEST(TEQ)
-A_PROTO_ALU_TEST(CMP)
-A_PROTO_ALU_TEST(CMN)
-A_PROTO_ALU_OP(ORR)
-A_PROTO_ALU_OP(MOV)
-A_PROTO_ALU_OP(BIC)
-A_PROTO_ALU_OP(MVN)
-
-void A_MOV_REG_LSL_IMM_DBG(ARM* cpu);
-
-void A_MUL(ARM* cpu);
-void A_MLA(ARM* cpu);
-void A_UMULL(ARM* cpu);
-void A_UMLAL(ARM* cpu);
-void A_SMULL(ARM* cpu);
-void A_SMLAL(ARM* cpu);
-void A_SMLAxy(ARM* cpu);
-void A_SMLAWy(ARM* cpu);
-void A_SMULxy(ARM* cpu);
-void A_SMULWy(ARM* cpu);
-void A_SMLALxy(ARM* cpu);
-
-void A_CLZ(ARM* cpu);
-void A_QADD(ARM* cpu);
-void A_QSUB(ARM* cpu);
-void A_QDADD(ARM* cpu);
-void A_QDSUB(ARM* cpu);
-
-
-void T_LSL_IMM(ARM* cpu);
-void T_LSR_IMM(ARM* cpu);
-void T_ASR_IMM(ARM* cpu);
-
-void T_ADD_REG_(ARM* cpu);
-void T_SUB_REG_(ARM* cpu);
-void T_ADD_IMM_(ARM* cpu);
-void T_SUB_IMM_(ARM* cpu);
-
-void T_MOV_IMM(ARM* cpu);
-void T_CMP_IMM(ARM* cpu);
-void T_ADD_IMM(ARM* cpu);
-void T_SUB_IMM(ARM* cpu);
-
-void T_AND_REG(ARM* cpu);
-void T_EOR_REG(ARM* cpu);
-void T_LSL_REG(ARM* cpu);
-void T_LSR_REG(ARM* cpu);
-void T_ASR_REG(ARM* cpu);
-void T_ADC_REG(ARM* cpu);
-void T_SBC_REG(ARM* cpu);
-void T_ROR_REG(ARM* cpu);
-void T_TST_REG(ARM* cpu);
-void T_NEG_REG(ARM* cpu);
-void T_CMP_REG(ARM* cpu);
-void T_CMN_REG(ARM* cpu);
-void T_ORR_REG(ARM* cpu);
-void T_MUL_REG(ARM* cpu);
-void T_BIC_REG(ARM* cpu);
-void T_MVN_REG(ARM* cpu);
-
-void T_ADD_HIREG(ARM* cpu);
-void T_CMP_HIREG(ARM* cpu);
-void T_MOV_HIREG(ARM* cpu);
+    f(A_MUL) \
+    f(A_MLA) \
+    f(A_UMULL) \
+    f(A_UMLAL) \
+    f(A_SMULL) \
+    f(A_SMLAL) \
+    f(A_SMLAxy) \
+    f(A_SMLAWy) \
+    f(A_SMULxy) \
+    f(A_SMULWy) \
+    f(A_SMLALxy) \
+\
+    f(A_CLZ) \
+    f(A_QADD) \
+    f(A_QSUB) \
+    f(A_QDADD) \
+    f(A_QDSUB) \
+\
+    f(T_LSL_IMM) \
+    f(T_LSR_IMM) \
+    f(T_ASR_IMM) \
+\
+    f(T_ADD_REG_) \
+    f(T_SUB_REG_) \
+    f(T_ADD_IMM_) \
+    f(T_SUB_IMM_) \
+\
+    f(T_MOV_IMM) \
+    f(T_CMP_IMM) \
+    f(T_ADD_IMM) \
+    f(T_SUB_IMM) \
+\
+    f(T_AND_REG) \
+    f(T_EOR_REG) \
+    f(T_LSL_REG) \
+    f(T_LSR_REG) \
+    f(T_ASR_REG) \
+    f(T_ADC_REG) \
+    f(T_SBC_REG) \
+    f(T_ROR_REG) \
+    f(T_TST_REG) \
+    f(T_NEG_REG) \
+    f(T_CMP_REG) \
+    f(T_CMN_REG) \
+    f(T_ORR_REG) \
+    f(T_MUL_REG) \
+    f(T_BIC_REG) \
+    f(T_MVN_REG) \
+\
+    f(T_ADD_HIREG) \
+    f(T_CMP_HIREG) \
+    f(T_MOV_HIREG) \
+\
+    f(T_ADD_PCREL) \
+    f(T_ADD_SPREL) \
+    f(T_ADD_SP)
 
-void T_ADD_PCREL(ARM* cpu);
-void T_ADD_SPREL(ARM* cpu);
-void T_ADD_SP(ARM* cpu);
+INSTRFUNCS_ALU(INSTRFUNC_DECLARE)
 
 }
 
@@ -18,40 +18,52 @@
 
 #include <stdio.h>
 #include "ARM.h"
+#include "ARMInterpreter.h"
+#include "ARMInterpreter_Branch.h"
 
 
 namespace ARMInterpreter
 {
 
 
-void A_B(ARM* cpu)
+template <typename CPU>
+void A_B(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     cpu->JumpTo(cpu->R[15] + offset);
 }
 
-void A_BL(ARM* cpu)
+template <typename CPU>
+void A_BL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     cpu->R[14] = cpu->R[15] - 4;
     cpu->JumpTo(cpu->R[15] + offset);
 }
 
-void A_BLX_IMM(ARM* cpu)
+template <typename CPU>
+void A_BLX_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (s32)(cpu->CurInstr << 8) >> 6;
     if (cpu->CurInstr & 0x01000000) offset += 2;
     cpu->R[14] = cpu->R[15] - 4;
     cpu->JumpTo(cpu->R[15] + offset + 1);
 }
 
-void A_BX(ARM* cpu)
+template <typename CPU>
+void A_BX(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     cpu->JumpTo(cpu->R[cpu->CurInstr & 0xF]);
 }
 
-void A_BLX_REG(ARM* cpu)
+template <typename CPU>
+void A_BLX_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 lr = cpu->R[15] - 4;
     cpu->JumpTo(cpu->R[cpu->CurInstr & 0xF]);
     cpu->R[14] = lr;
@@ -59,8 +71,10 @@ void A_BLX_REG(ARM* cpu)
 
 
 
-void T_BCOND(ARM* cpu)
+template <typename CPU>
+void T_BCOND(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->CheckCondition((cpu->CurInstr >> 8) & 0xF))
     {
         s32 offset = (s32)(cpu->CurInstr << 24) >> 23;
@@ -70,13 +84,17 @@ void T_BCOND(ARM* cpu)
         cpu->AddCycles_C();
 }
 
-void T_BX(ARM* cpu)
+template <typename CPU>
+void T_BX(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     cpu->JumpTo(cpu->R[(cpu->CurInstr >> 3) & 0xF]);
 }
 
-void T_BLX_REG(ARM* cpu)
+template <typename CPU>
+void T_BLX_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     if (cpu->Num==1)
     {
         printf("!! THUMB BLX_REG ON ARM7\n");
@@ -88,21 +106,27 @@ void T_BLX_REG(ARM* cpu)
     cpu->R[14] = lr;
 }
 
-void T_B(ARM* cpu)
+template <typename CPU>
+void T_B(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (s32)((cpu->CurInstr & 0x7FF) << 21) >> 20;
     cpu->JumpTo(cpu->R[15] + offset + 1);
 }
 
-void T_BL_LONG_1(ARM* cpu)
+template <typename CPU>
+void T_BL_LONG_1(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (s32)((cpu->CurInstr & 0x7FF) << 21) >> 9;
     cpu->R[14] = cpu->R[15] + offset;
     cpu->AddCycles_C();
 }
 
-void T_BL_LONG_2(ARM* cpu)
+template <typename CPU>
+void T_BL_LONG_2(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     s32 offset = (cpu->CurInstr & 0x7FF) << 1;
     u32 pc = cpu->R[14] + offset;
     cpu->R[14] = (cpu->R[15] - 2) | 1;
@@ -115,5 +139,8 @@ void T_BL_LONG_2(ARM* cpu)
 
 
 
+INSTRFUNCS_BRANCH(INSTRFUNC_INSTANTIATE)
+INSTRFUNC_INSTANTIATE(A_BLX_IMM)
+
 }
 
@@ -22,17 +22,20 @@
 namespace ARMInterpreter
 {
 
-void A_B(ARM* cpu);
-void A_BL(ARM* cpu);
-void A_BX(ARM* cpu);
-void A_BLX_REG(ARM* cpu);
-
-void T_BCOND(ARM* cpu);
-void T_BX(ARM* cpu);
-void T_BLX_REG(ARM* cpu);
-void T_B(ARM* cpu);
-void T_BL_LONG_1(ARM* cpu);
-void T_BL_LONG_2(ARM* cpu);
+#define INSTRFUNCS_BRANCH(f) \
+    f(A_B) \
+    f(A_BL) \
+    f(A_BX) \
+    f(A_BLX_REG) \
+\
+    f(T_BCOND) \
+    f(T_BX) \
+    f(T_BLX_REG) \
+    f(T_B) \
+    f(T_BL_LONG_1) \
+    f(T_BL_LONG_2)
+
+INSTRFUNCS_BRANCH(INSTRFUNC_DECLARE)
 
 }
 
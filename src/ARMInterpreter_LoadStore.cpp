@@ -18,6 +18,8 @@
 
 #include <stdio.h>
 #include "ARM.h"
+#include "ARMInterpreter.h"
+#include "ARMInterpreter_LoadStore.h"
 
 
 namespace ARMInterpreter
@@ -140,62 +142,82 @@ namespace ARMInterpreter
 
 #define A_IMPLEMENT_WB_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_IMM \
     A_##x \
 } \
 \
-void A_##x##_REG_LSL(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSL(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(LSL_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_LSR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_LSR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(LSR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_ASR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ASR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(ASR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_REG_ROR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG_ROR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(ROR_IMM) \
     A_##x \
 } \
 \
-void A_##x##_POST_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_IMM \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_LSL(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_REG_LSL(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(LSL_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_LSR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_REG_LSR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(LSR_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_ASR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_REG_ASR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(ASR_IMM) \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG_ROR(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_REG_ROR(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_WB_CALC_OFFSET_REG(ROR_IMM) \
     A_##x##_POST \
 }
@@ -320,25 +342,33 @@ A_IMPLEMENT_WB_LDRSTR(LDRB)
 
 #define A_IMPLEMENT_HD_LDRSTR(x) \
 \
-void A_##x##_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_HD_CALC_OFFSET_IMM \
     A_##x \
 } \
 \
-void A_##x##_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_HD_CALC_OFFSET_REG \
     A_##x \
 } \
-void A_##x##_POST_IMM(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_IMM(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_HD_CALC_OFFSET_IMM \
     A_##x##_POST \
 } \
 \
-void A_##x##_POST_REG(ARM* cpu) \
+template <typename CPU> \
+void A_##x##_POST_REG(ARM* arm) \
 { \
+    CPU* cpu = (CPU*)arm; \
     A_HD_CALC_OFFSET_REG \
     A_##x##_POST \
 }
@@ -352,8 +382,10 @@ A_IMPLEMENT_HD_LDRSTR(LDRSH)
 
 
 
-void A_SWP(ARM* cpu)
+template <typename CPU>
+void A_SWP(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 base = cpu->R[(cpu->CurInstr >> 16) & 0xF];
     u32 rm = cpu->R[cpu->CurInstr & 0xF];
 
@@ -368,8 +400,10 @@ void A_SWP(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void A_SWPB(ARM* cpu)
+template <typename CPU>
+void A_SWPB(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 base = cpu->R[(cpu->CurInstr >> 16) & 0xF];
     u32 rm = cpu->R[cpu->CurInstr & 0xF] & 0xFF;
 
@@ -384,8 +418,10 @@ void A_SWPB(ARM* cpu)
 
 
 
-void A_LDM(ARM* cpu)
+template <typename CPU>
+void A_LDM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 baseid = (cpu->CurInstr >> 16) & 0xF;
     u32 base = cpu->R[baseid];
     u32 wbbase;
@@ -463,8 +499,10 @@ void A_LDM(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void A_STM(ARM* cpu)
+template <typename CPU>
+void A_STM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 baseid = (cpu->CurInstr >> 16) & 0xF;
     u32 base = cpu->R[baseid];
     u32 oldbase = base;
@@ -535,8 +573,10 @@ void A_STM(ARM* cpu)
 
 
 
-void T_LDR_PCREL(ARM* cpu)
+template <typename CPU>
+void T_LDR_PCREL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = (cpu->R[15] & ~0x2) + ((cpu->CurInstr & 0xFF) << 2);
     cpu->DataRead32(addr, &cpu->R[(cpu->CurInstr >> 8) & 0x7]);
 
@@ -544,24 +584,30 @@ void T_LDR_PCREL(ARM* cpu)
 }
 
 
-void T_STR_REG(ARM* cpu)
+template <typename CPU>
+void T_STR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite32(addr, cpu->R[cpu->CurInstr & 0x7]);
 
     cpu->AddCycles_CD();
 }
 
-void T_STRB_REG(ARM* cpu)
+template <typename CPU>
+void T_STRB_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite8(addr, cpu->R[cpu->CurInstr & 0x7]);
 
     cpu->AddCycles_CD();
 }
 
-void T_LDR_REG(ARM* cpu)
+template <typename CPU>
+void T_LDR_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
 
     u32 val;
@@ -571,8 +617,10 @@ void T_LDR_REG(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_LDRB_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRB_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead8(addr, &cpu->R[cpu->CurInstr & 0x7]);
 
@@ -580,16 +628,20 @@ void T_LDRB_REG(ARM* cpu)
 }
 
 
-void T_STRH_REG(ARM* cpu)
+template <typename CPU>
+void T_STRH_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataWrite16(addr, cpu->R[cpu->CurInstr & 0x7]);
 
     cpu->AddCycles_CD();
 }
 
-void T_LDRSB_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRSB_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead8(addr, &cpu->R[cpu->CurInstr & 0x7]);
     cpu->R[cpu->CurInstr & 0x7] = (s32)(s8)cpu->R[cpu->CurInstr & 0x7];
@@ -597,16 +649,20 @@ void T_LDRSB_REG(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_LDRH_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRH_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead16(addr, &cpu->R[cpu->CurInstr & 0x7]);
 
     cpu->AddCycles_CDI();
 }
 
-void T_LDRSH_REG(ARM* cpu)
+template <typename CPU>
+void T_LDRSH_REG(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 addr = cpu->R[(cpu->CurInstr >> 3) & 0x7] + cpu->R[(cpu->CurInstr >> 6) & 0x7];
     cpu->DataRead16(addr, &cpu->R[cpu->CurInstr & 0x7]);
     cpu->R[cpu->CurInstr & 0x7] = (s32)(s16)cpu->R[cpu->CurInstr & 0x7];
@@ -615,8 +671,10 @@ void T_LDRSH_REG(ARM* cpu)
 }
 
 
-void T_STR_IMM(ARM* cpu)
+template <typename CPU>
+void T_STR_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 4) & 0x7C;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -624,8 +682,10 @@ void T_STR_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDR_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDR_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 4) & 0x7C;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -635,8 +695,10 @@ void T_LDR_IMM(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_STRB_IMM(ARM* cpu)
+template <typename CPU>
+void T_STRB_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 6) & 0x1F;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -644,8 +706,10 @@ void T_STRB_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDRB_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDRB_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 6) & 0x1F;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -654,8 +718,10 @@ void T_LDRB_IMM(ARM* cpu)
 }
 
 
-void T_STRH_IMM(ARM* cpu)
+template <typename CPU>
+void T_STRH_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 5) & 0x3E;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -663,8 +729,10 @@ void T_STRH_IMM(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDRH_IMM(ARM* cpu)
+template <typename CPU>
+void T_LDRH_IMM(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr >> 5) & 0x3E;
     offset += cpu->R[(cpu->CurInstr >> 3) & 0x7];
 
@@ -673,8 +741,10 @@ void T_LDRH_IMM(ARM* cpu)
 }
 
 
-void T_STR_SPREL(ARM* cpu)
+template <typename CPU>
+void T_STR_SPREL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr << 2) & 0x3FC;
     offset += cpu->R[13];
 
@@ -682,8 +752,10 @@ void T_STR_SPREL(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDR_SPREL(ARM* cpu)
+template <typename CPU>
+void T_LDR_SPREL(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 offset = (cpu->CurInstr << 2) & 0x3FC;
     offset += cpu->R[13];
 
@@ -692,8 +764,10 @@ void T_LDR_SPREL(ARM* cpu)
 }
 
 
-void T_PUSH(ARM* cpu)
+template <typename CPU>
+void T_PUSH(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     int nregs = 0;
     bool first = true;
 
@@ -730,8 +804,10 @@ void T_PUSH(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_POP(ARM* cpu)
+template <typename CPU>
+void T_POP(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 base = cpu->R[13];
     bool first = true;
 
@@ -760,8 +836,10 @@ void T_POP(ARM* cpu)
     cpu->AddCycles_CDI();
 }
 
-void T_STMIA(ARM* cpu)
+template <typename CPU>
+void T_STMIA(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 base = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     bool first = true;
 
@@ -781,8 +859,10 @@ void T_STMIA(ARM* cpu)
     cpu->AddCycles_CD();
 }
 
-void T_LDMIA(ARM* cpu)
+template <typename CPU>
+void T_LDMIA(ARM* arm)
 {
+    CPU* cpu = (CPU*)arm;
     u32 base = cpu->R[(cpu->CurInstr >> 8) & 0x7];
     bool first = true;
 
@@ -804,5 +884,7 @@ void T_LDMIA(ARM* cpu)
 }
 
 
+INSTRFUNCS_LOADSTORE(INSTRFUNC_INSTANTIATE)
+
 }
 
@@ -22,72 +22,72 @@
 namespace ARMInterpreter
 {
 
-#define A_PROTO_WB_LDRSTR(x) \
+#define A_PROTO_WB_LDRSTR(x, f) \
+    f(A_##x##_IMM) \
+    f(A_##x##_REG_LSL) \
+    f(A_##x##_REG_LSR) \
+    f(A_##x##_REG_ASR) \
+    f(A_##x##_REG_ROR) \
+    f(A_##x##_POST_IMM) \
+    f(A_##x##_POST_REG_LSL) \
+    f(A_##x##_POST_REG_LSR) \
+    f(A_##x##_POST_REG_ASR) \
+    f(A_##x##_POST_REG_ROR)
+
+#define A_PROTO_HD_LDRSTR(x, f) \
+    f(A_##x##_IMM) \
+    f(A_##x##_REG) \
+    f(A_##x##_POST_IMM) \
+    f(A_##x##_POST_REG)
+
+#define INSTRFUNCS_LOADSTORE(f) \
+    A_PROTO_WB_LDRSTR(STR, f) \
+    A_PROTO_WB_LDRSTR(STRB, f) \
+    A_PROTO_WB_LDRSTR(LDR, f) \
+    A_PROTO_WB_LDRSTR(LDRB, f) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG_LSL(ARM* cpu); \
-void A_##x##_REG_LSR(ARM* cpu); \
-void A_##x##_REG_ASR(ARM* cpu); \
-void A_##x##_REG_ROR(ARM* cpu); \
-void A_##x##_POST_IMM(ARM* cpu); \
-void A_##x##_POST_REG_LSL(ARM* cpu); \
-void A_##x##_POST_REG_LSR(ARM* cpu); \
-void A_##x##_POST_REG_ASR(ARM* cpu); \
-void A_##x##_POST_REG_ROR(ARM* cpu);
-
-A_PROTO_WB_LDRSTR(STR)
-A_PROTO_WB_LDRSTR(STRB)
-A_PROTO_WB_LDRSTR(LDR)
-A_PROTO_WB_LDRSTR(LDRB)
-
-#define A_PROTO_HD_LDRSTR(x) \
+    A_PROTO_HD_LDRSTR(STRH, f) \
+    A_PROTO_HD_LDRSTR(LDRD, f) \
+    A_PROTO_HD_LDRSTR(STRD, f) \
+    A_PROTO_HD_LDRSTR(LDRH, f) \
+    A_PROTO_HD_LDRSTR(LDRSB, f) \
+    A_PROTO_HD_LDRSTR(LDRSH, f) \
 \
-void A_##x##_IMM(ARM* cpu); \
-void A_##x##_REG(ARM* cpu); \
-void A_##x##_POST_IMM(ARM* cpu); \
-void A_##x##_POST_REG(ARM* cpu);
-
-A_PROTO_HD_LDRSTR(STRH)
-A_PROTO_HD_LDRSTR(LDRD)
-A_PROTO_HD_LDRSTR(STRD)
-A_PROTO_HD_LDRSTR(LDRH)
-A_PROTO_HD_LDRSTR(LDRSB)
-A_PROTO_HD_LDRSTR(LDRSH)
-
-void A_LDM(ARM* cpu);
-void A_STM(ARM* cpu);
-
-void A_SWP(ARM* cpu);
-void A_SWPB(ARM* cpu);
-
-
-void T_LDR_PCREL(ARM* cpu);
-
-void T_STR_REG(ARM* cpu);
-void T_STRB_REG(ARM* cpu);
-void T_LDR_REG(ARM* cpu);
-void T_LDRB_REG(ARM* cpu);
-
-void T_STRH_REG(ARM* cpu);
-void T_LDRSB_REG(ARM* cpu);
-void T_LDRH_REG(ARM* cpu);
-void T_LDRSH_REG(ARM* cpu);
-
-void T_STR_IMM(ARM* cpu);
-void T_LDR_IMM(ARM* cpu);
-void T_STRB_IMM(ARM* cpu);
-void T_LDRB_IMM(ARM* cpu);
-
-void T_STRH_IMM(ARM* cpu);
-void T_LDRH_IMM(ARM* cpu);
-
-void T_STR_SPREL(ARM* cpu);
-void T_LDR_SPREL(ARM* cpu);
+    f(A_LDM) \
+    f(A_STM) \
+\
+    f(A_SWP) \
+    f(A_SWPB) \
+\
+    f(T_LDR_PCREL) \
+\
+    f(T_STR_REG) \
+    f(T_STRB_REG) \
+    f(T_LDR_REG) \
+    f(T_LDRB_REG) \
+\
+    f(T_STRH_REG) \
+    f(T_LDRSB_REG) \
+    f(T_LDRH_REG) \
+    f(T_LDRSH_REG) \
+\
+    f(T_STR_IMM) \
+    f(T_LDR_IMM) \
+    f(T_STRB_IMM) \
+    f(T_LDRB_IMM) \
+\
+    f(T_STRH_IMM) \
+    f(T_LDRH_IMM) \
+\
+    f(T_STR_SPREL) \
+    f(T_LDR_SPREL) \
+\
+    f(T_PUSH) \
+    f(T_POP) \
+    f(T_STMIA) \
+    f(T_LDMIA)
 
-void T_PUSH(ARM* cpu);
-void T_POP(ARM* cpu);
-void T_STMIA(ARM* cpu);
-void T_LDMIA(ARM* cpu);
+INSTRFUNCS_LOADSTORE(INSTRFUNC_DECLARE)
 
 }
 
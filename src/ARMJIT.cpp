@@ -0,0 +1,1457 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "ARMJIT.h"
+#include "ARM.h"
+#include "ARMInterpreter.h"
+#include "ARMInterpreter_ALU.h"
+#include "ARMInterpreter_LoadStore.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X64
+#endif
+
+#ifdef JIT_X64
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+
+namespace ARMJIT
+{
+
+bool Enabled;
+
+#ifdef JIT_X64
+
+const u32 kCodeSize = 0x1000000;
+
+// worst case for one block, with room to spare
+const u32 kMaxBlockCode = 0x10000;
+
+u8* CodeStart;
+u8* CodePtr;
+
+
+bool Init()
+{
+#ifdef _WIN32
+    CodeStart = (u8*)VirtualAlloc(NULL, kCodeSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    CodeStart = (u8*)mmap(NULL, kCodeSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (CodeStart == (u8*)MAP_FAILED) CodeStart = NULL;
+#endif
+
+    // not fatal, we can still run the block cache without it
+    if (!CodeStart)
+        printf("JIT: failed to allocate code buffer\n");
+
+    CodePtr = CodeStart;
+    return true;
+}
+
+void DeInit()
+{
+    if (!CodeStart) return;
+
+#ifdef _WIN32
+    VirtualFree(CodeStart, 0, MEM_RELEASE);
+#else
+    munmap(CodeStart, kCodeSize);
+#endif
+    CodeStart = NULL;
+}
+
+void Reset()
+{
+    CodePtr = CodeStart;
+}
+
+
+// ---- x86-64 emitter ----------------------------------
+
+enum
+{
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+#ifdef _WIN32
+const int ARG0 = RCX;
+const int ARG1 = RDX;
+const int ARG2 = R8;
+#else
+const int ARG0 = RDI;
+const int ARG1 = RSI;
+const int ARG2 = RDX;
+#endif
+
+enum
+{
+    CC_O = 0x0, CC_NO = 0x1, CC_B = 0x2, CC_AE = 0x3,
+    CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_S = 0x8, CC_NS = 0x9,
+    CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+enum
+{
+    ALU_ADD = 0, ALU_OR, ALU_ADC, ALU_SBB, ALU_AND, ALU_SUB, ALU_XOR, ALU_CMP
+};
+
+enum
+{
+    SH_ROL = 0, SH_ROR = 1, SH_SHL = 4, SH_SHR = 5, SH_SAR = 7
+};
+
+void Emit8(u8 val)
+{
+    *CodePtr++ = val;
+}
+
+void Emit32(u32 val)
+{
+    memcpy(CodePtr, &val, 4);
+    CodePtr += 4;
+}
+
+void Emit64(u64 val)
+{
+    memcpy(CodePtr, &val, 8);
+    CodePtr += 8;
+}
+
+// byteregs: force a REX prefix so that 4-7 encode SPL/BPL/SIL/DIL
+void EmitREX(bool w, int reg, int index, int base, bool byteregs = false)
+{
+    u8 rex = 0x40;
+    if (w)         rex |= 0x8;
+    if (reg & 8)   rex |= 0x4;
+    if (index & 8) rex |= 0x2;
+    if (base & 8)  rex |= 0x1;
+    if (rex != 0x40 || byteregs) Emit8(rex);
+}
+
+void EmitModRR(int reg, int rm)
+{
+    Emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [base + disp32]
+void EmitModMem(int reg, int base, s32 disp)
+{
+    if ((base & 7) == RSP)
+    {
+        Emit8(0x84 | ((reg & 7) << 3));
+        Emit8(0x24);
+    }
+    else
+        Emit8(0x80 | ((reg & 7) << 3) | (base & 7));
+
+    Emit32(disp);
+}
+
+// [base + index<<scale + disp32]
+void EmitModMemIdx(int reg, int base, int index, int scale, s32 disp)
+{
+    Emit8(0x84 | ((reg & 7) << 3));
+    Emit8((scale << 6) | ((index & 7) << 3) | (base & 7));
+    Emit32(disp);
+}
+
+void MOV_RegReg(int dst, int src)
+{
+    EmitREX(false, src, 0, dst);
+    Emit8(0x89);
+    EmitModRR(src, dst);
+}
+
+void MOV64_RegReg(int dst, int src)
+{
+    EmitREX(true, src, 0, dst);
+    Emit8(0x89);
+    EmitModRR(src, dst);
+}
+
+void MOV_RegImm(int reg, u32 imm)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0xB8 + (reg & 7));
+    Emit32(imm);
+}
+
+void MOV64_RegImm(int reg, const void* ptr)
+{
+    EmitREX(true, 0, 0, reg);
+    Emit8(0xB8 + (reg & 7));
+    Emit64((u64)ptr);
+}
+
+void MOV_RegMem(int reg, int base, s32 disp)
+{
+    EmitREX(false, reg, 0, base);
+    Emit8(0x8B);
+    EmitModMem(reg, base, disp);
+}
+
+void MOV64_RegMem(int reg, int base, s32 disp)
+{
+    EmitREX(true, reg, 0, base);
+    Emit8(0x8B);
+    EmitModMem(reg, base, disp);
+}
+
+void MOV_MemReg(int base, s32 disp, int reg)
+{
+    EmitREX(false, reg, 0, base);
+    Emit8(0x89);
+    EmitModMem(reg, base, disp);
+}
+
+void MOV_MemImm(int base, s32 disp, u32 imm)
+{
+    EmitREX(false, 0, 0, base);
+    Emit8(0xC7);
+    EmitModMem(0, base, disp);
+    Emit32(imm);
+}
+
+void MOVSXD_RegMem(int reg, int base, s32 disp)
+{
+    EmitREX(true, reg, 0, base);
+    Emit8(0x63);
+    EmitModMem(reg, base, disp);
+}
+
+void LOAD_RegMemIdx(u32 size, int reg, int base, int index, int scale, s32 disp)
+{
+    EmitREX(false, reg, index, base);
+    if (size == 32)
+        Emit8(0x8B);
+    else
+    {
+        Emit8(0x0F);
+        Emit8(size == 16 ? 0xB7 : 0xB6);
+    }
+    EmitModMemIdx(reg, base, index, scale, disp);
+}
+
+void STORE_MemIdxReg(u32 size, int base, int index, s32 disp, int reg)
+{
+    if (size == 16) Emit8(0x66);
+    EmitREX(false, reg, index, base, size == 8 && reg >= 4);
+    Emit8(size == 8 ? 0x88 : 0x89);
+    EmitModMemIdx(reg, base, index, 0, disp);
+}
+
+void MOVZX8_RegReg(int dst, int src)
+{
+    EmitREX(false, dst, 0, src, src >= 4);
+    Emit8(0x0F);
+    Emit8(0xB6);
+    EmitModRR(dst, src);
+}
+
+void MOVSX_RegReg(u32 size, int dst, int src)
+{
+    EmitREX(false, dst, 0, src, size == 8 && src >= 4);
+    Emit8(0x0F);
+    Emit8(size == 16 ? 0xBF : 0xBE);
+    EmitModRR(dst, src);
+}
+
+void ALU_RegReg(int op, int dst, int src)
+{
+    EmitREX(false, src, 0, dst);
+    Emit8((op << 3) | 0x01);
+    EmitModRR(src, dst);
+}
+
+void ALU_RegImm(int op, int reg, u32 imm)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0x81);
+    EmitModRR(op, reg);
+    Emit32(imm);
+}
+
+void ALU64_RegImm(int op, int reg, u32 imm)
+{
+    EmitREX(true, 0, 0, reg);
+    Emit8(0x81);
+    EmitModRR(op, reg);
+    Emit32(imm);
+}
+
+void ALU_RegMem(int op, int reg, int base, s32 disp)
+{
+    EmitREX(false, reg, 0, base);
+    Emit8((op << 3) | 0x03);
+    EmitModMem(reg, base, disp);
+}
+
+void ALU64_RegMem(int op, int reg, int base, s32 disp)
+{
+    EmitREX(true, reg, 0, base);
+    Emit8((op << 3) | 0x03);
+    EmitModMem(reg, base, disp);
+}
+
+void ALU_MemReg(int op, int base, s32 disp, int reg)
+{
+    EmitREX(false, reg, 0, base);
+    Emit8((op << 3) | 0x01);
+    EmitModMem(reg, base, disp);
+}
+
+void ALU64_MemReg(int op, int base, s32 disp, int reg)
+{
+    EmitREX(true, reg, 0, base);
+    Emit8((op << 3) | 0x01);
+    EmitModMem(reg, base, disp);
+}
+
+void ALU_MemImm(int op, int base, s32 disp, u32 imm)
+{
+    EmitREX(false, 0, 0, base);
+    Emit8(0x81);
+    EmitModMem(op, base, disp);
+    Emit32(imm);
+}
+
+void ALU64_MemImm(int op, int base, s32 disp, u32 imm)
+{
+    EmitREX(true, 0, 0, base);
+    Emit8(0x81);
+    EmitModMem(op, base, disp);
+    Emit32(imm);
+}
+
+void TEST_RegReg(int a, int b)
+{
+    EmitREX(false, b, 0, a);
+    Emit8(0x85);
+    EmitModRR(b, a);
+}
+
+void NOT_Reg(int reg)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0xF7);
+    EmitModRR(2, reg);
+}
+
+void SHIFT_RegImm(int type, int reg, u8 imm)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0xC1);
+    EmitModRR(type, reg);
+    Emit8(imm);
+}
+
+void SHIFT_RegCL(int type, int reg)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0xD3);
+    EmitModRR(type, reg);
+}
+
+void BT_RegImm(int reg, u8 bit)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0x0F);
+    Emit8(0xBA);
+    EmitModRR(4, reg);
+    Emit8(bit);
+}
+
+void BT_RegReg(int reg, int bitreg)
+{
+    EmitREX(false, bitreg, 0, reg);
+    Emit8(0x0F);
+    Emit8(0xA3);
+    EmitModRR(bitreg, reg);
+}
+
+void BT_MemImm(int base, s32 disp, u8 bit)
+{
+    EmitREX(false, 0, 0, base);
+    Emit8(0x0F);
+    Emit8(0xBA);
+    EmitModMem(4, base, disp);
+    Emit8(bit);
+}
+
+void SETcc(int cc, int reg)
+{
+    EmitREX(false, 0, 0, reg, reg >= 4);
+    Emit8(0x0F);
+    Emit8(0x90 | cc);
+    EmitModRR(0, reg);
+}
+
+void CMOVcc(int cc, int dst, int src)
+{
+    EmitREX(false, dst, 0, src);
+    Emit8(0x0F);
+    Emit8(0x40 | cc);
+    EmitModRR(dst, src);
+}
+
+void CMC()
+{
+    Emit8(0xF5);
+}
+
+void PUSH(int reg)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0x50 + (reg & 7));
+}
+
+void POP(int reg)
+{
+    EmitREX(false, 0, 0, reg);
+    Emit8(0x58 + (reg & 7));
+}
+
+void RET()
+{
+    Emit8(0xC3);
+}
+
+void CALL(const void* func)
+{
+    MOV64_RegImm(RAX, func);
+    Emit8(0xFF);
+    EmitModRR(2, RAX);
+}
+
+// forward jumps return a fixup to be resolved with SetJumpTarget()
+u8* Jcc(int cc)
+{
+    Emit8(0x0F);
+    Emit8(0x80 | cc);
+    Emit32(0);
+    return CodePtr;
+}
+
+u8* JMP()
+{
+    Emit8(0xE9);
+    Emit32(0);
+    return CodePtr;
+}
+
+void SetJumpTarget(u8* fixup)
+{
+    s32 rel = (s32)(CodePtr - fixup);
+    memcpy(fixup - 4, &rel, 4);
+}
+
+void JccTo(int cc, u8* target)
+{
+    Emit8(0x0F);
+    Emit8(0x80 | cc);
+    Emit32((u32)(target - (CodePtr + 4)));
+}
+
+void JMPTo(u8* target)
+{
+    Emit8(0xE9);
+    Emit32((u32)(target - (CodePtr + 4)));
+}
+
+
+// ---- helpers called from compiled code ----------------------------------
+
+void CheckIRQ(ARM* cpu)
+{
+    if (NDS::IME[cpu->Num] & 0x1)
+        cpu->TriggerIRQ();
+}
+
+u32 SlowRead8(ARMv5* cpu, u32 addr)
+{
+    u32 val;
+    cpu->DataRead8(addr, &val);
+    return val;
+}
+
+u32 SlowRead16(ARMv5* cpu, u32 addr)
+{
+    u32 val;
+    cpu->DataRead16(addr, &val);
+    return val;
+}
+
+u32 SlowRead32(ARMv5* cpu, u32 addr)
+{
+    u32 val;
+    cpu->DataRead32(addr, &val);
+    return val;
+}
+
+void SlowWrite8(ARMv5* cpu, u32 addr, u32 val)
+{
+    cpu->DataWrite8(addr, val);
+}
+
+void SlowWrite16(ARMv5* cpu, u32 addr, u32 val)
+{
+    cpu->DataWrite16(addr, val);
+}
+
+void SlowWrite32(ARMv5* cpu, u32 addr, u32 val)
+{
+    cpu->DataWrite32(addr, val);
+}
+
+
+// ---- compiler ----------------------------------
+
+// register use in compiled blocks:
+// RBX: CPU
+// R12: pointer to timestamp
+// R13: pointer to target timestamp
+// R14: ARM7: cycles for a sequential code fetch. ARM9: value to be stored
+// R15: address of the current memory access
+// RBP: base register writeback value
+// [RSP+32]: cache mapping generation at block entry
+
+struct ALUOp
+{
+    u32 Op; // data processing opcode, as in ARM mode
+    bool S;
+    int Rd, Rn;
+
+    bool Imm;
+    u32 ImmVal;
+    int Rm;
+    u32 ShiftType, ShiftAmount;
+};
+
+struct MemOp
+{
+    u32 Size;
+    bool Load, SignExtend, Rotate;
+    int Rd, Rn; // no Rn: the address is ImmVal
+
+    bool Imm;
+    u32 ImmVal;
+    int Rm;
+    u32 ShiftType, ShiftAmount;
+
+    bool Add, Pre, Writeback;
+};
+
+enum
+{
+    OP_AND = 0, OP_EOR, OP_SUB, OP_RSB, OP_ADD, OP_ADC, OP_SBC, OP_RSC,
+    OP_TST, OP_TEQ, OP_CMP, OP_CMN, OP_ORR, OP_MOV, OP_BIC, OP_MVN
+};
+
+bool IsARM9;
+u32 Thumb;
+
+s32 OffR, OffCPSR, OffCycles, OffHalted, OffCodeCycles, OffDataCycles;
+s32 OffCurInstr, OffNextInstr;
+s32 OffITCM, OffITCMSize, OffDTCM, OffDTCMBase, OffDTCMSize, OffMemTimings, OffRegionCodeCycles;
+
+u8* ExitOK;
+u8* ExitFail;
+
+
+void (*NoDebugHook(void (*handler)(ARM*)))(ARM*)
+{
+    using namespace ARMInterpreter;
+
+    if (handler == A_MOV_REG_LSL_IMM_DBG<ARMv5>)
+        return A_MOV_REG_LSL_IMM<ARMv5>;
+    if (handler == A_MOV_REG_LSL_IMM_DBG<ARMv4>)
+        return A_MOV_REG_LSL_IMM<ARMv4>;
+    return handler;
+}
+
+bool DecodeALU_ARM(u32 instr, ALUOp* op)
+{
+    if (instr & 0x0C000000) return false;
+
+    op->Imm = instr & (1<<25);
+    if (!op->Imm && (instr & (1<<4))) return false; // shift by register, multiply, etc
+
+    op->Op = (instr >> 21) & 0xF;
+    op->S = instr & (1<<20);
+    if (op->Op >= OP_TST && op->Op <= OP_CMN && !op->S) return false; // PSR transfer, etc
+
+    // those are implemented differently in the interpreter
+    if (op->S && (op->Op == OP_ADC || op->Op == OP_SBC || op->Op == OP_RSC)) return false;
+
+    op->Rd = (instr >> 12) & 0xF;
+    if (op->Rd == 15 && !(op->Op >= OP_TST && op->Op <= OP_CMN)) return false;
+
+    // nocash debug hook
+    if ((instr & 0x0FFFFFFF) == 0x01A0C00C) return false;
+
+    op->Rn = (instr >> 16) & 0xF;
+    if (op->Imm)
+    {
+        u32 rot = (instr >> 7) & 0x1E;
+        op->ImmVal = instr & 0xFF;
+        if (rot) op->ImmVal = ROR(op->ImmVal, rot);
+    }
+    else
+    {
+        // the handler has to agree with the shift type
+        // (EOR with LSR and odd shift amounts goes to the ROR handler)
+        void (**table)(ARM*) = IsARM9 ? ARMInterpreter::ARM9Tables::ARMInstrTable
+                                      : ARMInterpreter::ARM7Tables::ARMInstrTable;
+        u32 icode = ((instr >> 4) & 0xF) | ((instr >> 16) & 0xFF0);
+        if (NoDebugHook(table[icode]) != NoDebugHook(table[icode & ~0x8]))
+            return false;
+
+        op->Rm = instr & 0xF;
+        op->ShiftType = (instr >> 5) & 0x3;
+        op->ShiftAmount = (instr >> 7) & 0x1F;
+    }
+
+    return true;
+}
+
+template <typename CPU>
+bool DecodeALU_THUMB(void (*handler)(ARM*), u32 instr, u32 r15, ALUOp* op)
+{
+    using namespace ARMInterpreter;
+
+    int rd3 = instr & 0x7;
+    int rs3 = (instr >> 3) & 0x7;
+    int rn3 = (instr >> 6) & 0x7;
+    int rd8 = (instr >> 8) & 0x7;
+    u32 imm8 = instr & 0xFF;
+    int rdh = (instr & 0x7) | ((instr >> 4) & 0x8);
+    int rsh = (instr >> 3) & 0xF;
+
+    op->S = true;
+    op->Imm = false;
+    op->ShiftType = 0;
+    op->ShiftAmount = 0;
+
+#define REG(op_, rd_, rn_, rm_) { op->Op = op_; op->Rd = rd_; op->Rn = rn_; op->Rm = rm_; }
+#define IMM(op_, rd_, rn_, imm_) { op->Op = op_; op->Rd = rd_; op->Rn = rn_; op->Imm = true; op->ImmVal = imm_; }
+
+    if      (handler == T_LSL_IMM<CPU>) { REG(OP_MOV, rd3, 0, rs3); op->ShiftType = 0; op->ShiftAmount = (instr >> 6) & 0x1F; }
+    else if (handler == T_LSR_IMM<CPU>) { REG(OP_MOV, rd3, 0, rs3); op->ShiftType = 1; op->ShiftAmount = (instr >> 6) & 0x1F; }
+    else if (handler == T_ASR_IMM<CPU>) { REG(OP_MOV, rd3, 0, rs3); op->ShiftType = 2; op->ShiftAmount = (instr >> 6) & 0x1F; }
+    else if (handler == T_ADD_REG_<CPU>) REG(OP_ADD, rd3, rs3, rn3)
+    else if (handler == T_SUB_REG_<CPU>) REG(OP_SUB, rd3, rs3, rn3)
+    else if (handler == T_ADD_IMM_<CPU>) IMM(OP_ADD, rd3, rs3, (u32)rn3)
+    else if (handler == T_SUB_IMM_<CPU>) IMM(OP_SUB, rd3, rs3, (u32)rn3)
+    else if (handler == T_MOV_IMM<CPU>)  IMM(OP_MOV, rd8, 0, imm8)
+    else if (handler == T_CMP_IMM<CPU>)  IMM(OP_CMP, 0, rd8, imm8)
+    else if (handler == T_ADD_IMM<CPU>)  IMM(OP_ADD, rd8, rd8, imm8)
+    else if (handler == T_SUB_IMM<CPU>)  IMM(OP_SUB, rd8, rd8, imm8)
+    else if (handler == T_AND_REG<CPU>)  REG(OP_AND, rd3, rd3, rs3)
+    else if (handler == T_EOR_REG<CPU>)  REG(OP_EOR, rd3, rd3, rs3)
+    else if (handler == T_TST_REG<CPU>)  REG(OP_TST, 0, rd3, rs3)
+    else if (handler == T_NEG_REG<CPU>)  IMM(OP_RSB, rd3, rs3, 0)
+    else if (handler == T_CMP_REG<CPU>)  REG(OP_CMP, 0, rd3, rs3)
+    else if (handler == T_CMN_REG<CPU>)  REG(OP_CMN, 0, rd3, rs3)
+    else if (handler == T_ORR_REG<CPU>)  REG(OP_ORR, rd3, rd3, rs3)
+    else if (handler == T_BIC_REG<CPU>)  REG(OP_BIC, rd3, rd3, rs3)
+    else if (handler == T_MVN_REG<CPU>)  REG(OP_MVN, rd3, 0, rs3)
+    else if (handler == T_ADD_HIREG<CPU>)
+    {
+        if (rdh == 15) return false;
+        REG(OP_ADD, rdh, rdh, rsh)
+        op->S = false;
+    }
+    else if (handler == T_CMP_HIREG<CPU>) REG(OP_CMP, 0, rdh, rsh)
+    else if (handler == T_MOV_HIREG<CPU>)
+    {
+        // nocash debug hook
+        if (rdh == 15 || (instr & 0xFFFF) == 0x46E4) return false;
+        REG(OP_MOV, rdh, 0, rsh)
+        op->S = false;
+    }
+    else if (handler == T_ADD_PCREL<CPU>)
+    {
+        IMM(OP_MOV, rd8, 0, (r15 & ~0x2) + (imm8 << 2))
+        op->S = false;
+    }
+    else if (handler == T_ADD_SPREL<CPU>)
+    {
+        IMM(OP_ADD, rd8, 13, imm8 << 2)
+        op->S = false;
+    }
+    else if (handler == T_ADD_SP<CPU>)
+    {
+        IMM((instr & (1<<7)) ? OP_SUB : OP_ADD, 13, 13, (instr & 0x7F) << 2)
+        op->S = false;
+    }
+    else
+        return false;
+
+#undef REG
+#undef IMM
+
+    return true;
+}
+
+bool DecodeMem_ARM(u32 instr, MemOp* op)
+{
+    if ((instr & 0x0C000000) != 0x04000000) return false;
+
+    op->Imm = !(instr & (1<<25));
+    if (!op->Imm && (instr & (1<<4))) return false; // undefined
+
+    op->Load = instr & (1<<20);
+    op->Size = (instr & (1<<22)) ? 8 : 32;
+    op->SignExtend = false;
+    op->Rotate = op->Load && op->Size == 32;
+
+    op->Rd = (instr >> 12) & 0xF;
+    op->Rn = (instr >> 16) & 0xF;
+    if (op->Load && op->Rd == 15) return false;
+
+    op->Pre = instr & (1<<24);
+    op->Add = instr & (1<<23);
+    op->Writeback = !op->Pre || (instr & (1<<21));
+    if (op->Writeback && op->Rn == 15) return false;
+
+    if (op->Imm)
+        op->ImmVal = instr & 0xFFF;
+    else
+    {
+        op->Rm = instr & 0xF;
+        op->ShiftType = (instr >> 5) & 0x3;
+        op->ShiftAmount = (instr >> 7) & 0x1F;
+    }
+
+    return true;
+}
+
+template <typename CPU>
+bool DecodeMem_THUMB(void (*handler)(ARM*), u32 instr, u32 r15, MemOp* op)
+{
+    using namespace ARMInterpreter;
+
+    op->SignExtend = false;
+    op->Rotate = false;
+    op->Add = true;
+    op->Pre = true;
+    op->Writeback = false;
+    op->ShiftType = 0;
+    op->ShiftAmount = 0;
+
+    op->Rd = instr & 0x7;
+    op->Rn = (instr >> 3) & 0x7;
+
+    // register offset
+    op->Imm = false;
+    op->Rm = (instr >> 6) & 0x7;
+    if      (handler == T_STR_REG<CPU>)   { op->Load = false; op->Size = 32; }
+    else if (handler == T_STRB_REG<CPU>)  { op->Load = false; op->Size = 8; }
+    else if (handler == T_STRH_REG<CPU>)  { op->Load = false; op->Size = 16; }
+    else if (handler == T_LDR_REG<CPU>)   { op->Load = true;  op->Size = 32; op->Rotate = true; }
+    else if (handler == T_LDRB_REG<CPU>)  { op->Load = true;  op->Size = 8; }
+    else if (handler == T_LDRH_REG<CPU>)  { op->Load = true;  op->Size = 16; }
+    else if (handler == T_LDRSB_REG<CPU>) { op->Load = true;  op->Size = 8;  op->SignExtend = true; }
+    else if (handler == T_LDRSH_REG<CPU>) { op->Load = true;  op->Size = 16; op->SignExtend = true; }
+    else
+    {
+        // immediate offset
+        op->Imm = true;
+        if      (handler == T_STR_IMM<CPU>)  { op->Load = false; op->Size = 32; op->ImmVal = (instr >> 4) & 0x7C; }
+        else if (handler == T_LDR_IMM<CPU>)  { op->Load = true;  op->Size = 32; op->ImmVal = (instr >> 4) & 0x7C; op->Rotate = true; }
+        else if (handler == T_STRB_IMM<CPU>) { op->Load = false; op->Size = 8;  op->ImmVal = (instr >> 6) & 0x1F; }
+        else if (handler == T_LDRB_IMM<CPU>) { op->Load = true;  op->Size = 8;  op->ImmVal = (instr >> 6) & 0x1F; }
+        else if (handler == T_STRH_IMM<CPU>) { op->Load = false; op->Size = 16; op->ImmVal = (instr >> 5) & 0x3E; }
+        else if (handler == T_LDRH_IMM<CPU>) { op->Load = true;  op->Size = 16; op->ImmVal = (instr >> 5) & 0x3E; }
+        else
+        {
+            op->Rd = (instr >> 8) & 0x7;
+            op->Rn = 13;
+            op->ImmVal = (instr << 2) & 0x3FC;
+            if      (handler == T_STR_SPREL<CPU>) { op->Load = false; op->Size = 32; }
+            else if (handler == T_LDR_SPREL<CPU>) { op->Load = true;  op->Size = 32; }
+            else if (handler == T_LDR_PCREL<CPU>)
+            {
+                op->Load = true;
+                op->Size = 32;
+                op->Rn = -1;
+                op->ImmVal += (r15 & ~0x2);
+            }
+            else
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+void LoadReg(int reg, int armreg, u32 r15)
+{
+    if (armreg == 15) MOV_RegImm(reg, r15);
+    else              MOV_RegMem(reg, RBX, OffR + armreg*4);
+}
+
+// shift by immediate, as done for the second operand of ALU and load/store ops
+// if setc is set, the shifter carry output is put in R9B and true is returned
+bool EmitShift(int reg, u32 type, u32 s, bool setc)
+{
+    bool hasc = false;
+
+    switch (type)
+    {
+    case 0: // LSL
+        if (s > 0)
+        {
+            if (setc) { BT_RegImm(reg, 32-s); SETcc(CC_B, R9); hasc = true; }
+            SHIFT_RegImm(SH_SHL, reg, s);
+        }
+        break;
+
+    case 1: // LSR
+        if (setc) { BT_RegImm(reg, s ? (s-1) : 31); SETcc(CC_B, R9); hasc = true; }
+        if (s == 0) ALU_RegReg(ALU_XOR, reg, reg);
+        else        SHIFT_RegImm(SH_SHR, reg, s);
+        break;
+
+    case 2: // ASR
+        if (setc) { BT_RegImm(reg, s ? (s-1) : 31); SETcc(CC_B, R9); hasc = true; }
+        SHIFT_RegImm(SH_SAR, reg, s ? s : 31);
+        break;
+
+    case 3: // ROR
+        if (s == 0)
+        {
+            // RRX
+            if (setc) { BT_RegImm(reg, 0); SETcc(CC_B, R9); hasc = true; }
+            MOV_RegMem(RAX, RBX, OffCPSR);
+            ALU_RegImm(ALU_AND, RAX, 0x20000000);
+            SHIFT_RegImm(SH_SHL, RAX, 2);
+            SHIFT_RegImm(SH_SHR, reg, 1);
+            ALU_RegReg(ALU_OR, reg, RAX);
+        }
+        else
+        {
+            if (setc) { BT_RegImm(reg, s-1); SETcc(CC_B, R9); hasc = true; }
+            SHIFT_RegImm(SH_ROR, reg, s);
+        }
+        break;
+    }
+
+    return hasc;
+}
+
+// build the new CPSR flags out of SETcc results (0/1 in the low byte)
+// c/v can be -1 to leave the flag unchanged
+void EmitComposeFlags(int n, int z, int c, int v)
+{
+    u32 mask = 0xC0000000;
+
+    MOVZX8_RegReg(RAX, n);
+    SHIFT_RegImm(SH_SHL, RAX, 31);
+    MOVZX8_RegReg(RCX, z);
+    SHIFT_RegImm(SH_SHL, RCX, 30);
+    ALU_RegReg(ALU_OR, RAX, RCX);
+    if (c >= 0)
+    {
+        MOVZX8_RegReg(RCX, c);
+        SHIFT_RegImm(SH_SHL, RCX, 29);
+        ALU_RegReg(ALU_OR, RAX, RCX);
+        mask |= 0x20000000;
+    }
+    if (v >= 0)
+    {
+        MOVZX8_RegReg(RCX, v);
+        SHIFT_RegImm(SH_SHL, RCX, 28);
+        ALU_RegReg(ALU_OR, RAX, RCX);
+        mask |= 0x10000000;
+    }
+
+    MOV_RegMem(RCX, RBX, OffCPSR);
+    ALU_RegImm(ALU_AND, RCX, ~mask);
+    ALU_RegReg(ALU_OR, RCX, RAX);
+    MOV_MemReg(RBX, OffCPSR, RCX);
+}
+
+void EmitALU(ALUOp* op, u32 r15)
+{
+    bool logical = false;
+    switch (op->Op)
+    {
+    case OP_AND: case OP_EOR: case OP_TST: case OP_TEQ:
+    case OP_ORR: case OP_MOV: case OP_BIC: case OP_MVN:
+        logical = true;
+        break;
+    }
+
+    bool test = op->Op >= OP_TST && op->Op <= OP_CMN;
+
+    // second operand -> EDX, shifter carry -> R9B
+    bool hasc = false;
+    if (op->Imm)
+        MOV_RegImm(RDX, op->ImmVal);
+    else
+    {
+        LoadReg(RDX, op->Rm, r15);
+        hasc = EmitShift(RDX, op->ShiftType, op->ShiftAmount, op->S && logical);
+    }
+
+    if (op->Op != OP_MOV && op->Op != OP_MVN)
+        LoadReg(R8, op->Rn, r15);
+
+    switch (op->Op)
+    {
+    case OP_AND:
+    case OP_TST: ALU_RegReg(ALU_AND, R8, RDX); break;
+    case OP_EOR:
+    case OP_TEQ: ALU_RegReg(ALU_XOR, R8, RDX); break;
+    case OP_ORR: ALU_RegReg(ALU_OR, R8, RDX); break;
+    case OP_BIC: NOT_Reg(RDX); ALU_RegReg(ALU_AND, R8, RDX); break;
+    case OP_MOV: MOV_RegReg(R8, RDX); break;
+    case OP_MVN: MOV_RegReg(R8, RDX); NOT_Reg(R8); break;
+
+    case OP_SUB:
+    case OP_CMP: ALU_RegReg(ALU_SUB, R8, RDX); break;
+    case OP_ADD:
+    case OP_CMN: ALU_RegReg(ALU_ADD, R8, RDX); break;
+    case OP_RSB:
+        MOV_RegReg(RAX, RDX);
+        ALU_RegReg(ALU_SUB, RAX, R8);
+        MOV_RegReg(R8, RAX);
+        break;
+
+    // x86 borrow is the inverse of the ARM carry
+    case OP_ADC:
+        BT_MemImm(RBX, OffCPSR, 29);
+        ALU_RegReg(ALU_ADC, R8, RDX);
+        break;
+    case OP_SBC:
+        BT_MemImm(RBX, OffCPSR, 29);
+        CMC();
+        ALU_RegReg(ALU_SBB, R8, RDX);
+        break;
+    case OP_RSC:
+        MOV_RegReg(RAX, RDX);
+        BT_MemImm(RBX, OffCPSR, 29);
+        CMC();
+        ALU_RegReg(ALU_SBB, RAX, R8);
+        MOV_RegReg(R8, RAX);
+        break;
+    }
+
+    if (op->S)
+    {
+        if (logical)
+        {
+            TEST_RegReg(R8, R8);
+            SETcc(CC_S, RAX);
+            SETcc(CC_E, RCX);
+            EmitComposeFlags(RAX, RCX, hasc ? R9 : -1, -1);
+        }
+        else
+        {
+            bool sub = op->Op == OP_SUB || op->Op == OP_RSB || op->Op == OP_CMP;
+
+            SETcc(CC_S, RAX);
+            SETcc(CC_E, RCX);
+            SETcc(sub ? CC_AE : CC_B, RDX);
+            SETcc(CC_O, R9);
+            EmitComposeFlags(RAX, RCX, RDX, R9);
+        }
+    }
+
+    if (!test)
+        MOV_MemReg(RBX, OffR + op->Rd*4, R8);
+}
+
+void EmitCheckWrite(u32 codebase, u32 mask)
+{
+    MOV_RegReg(R9, R15);
+    ALU_RegImm(ALU_AND, R9, mask);
+    ALU_RegImm(ALU_ADD, R9, codebase);
+    SHIFT_RegImm(SH_SHR, R9, ARMCache::kPageShift);
+    MOV64_RegImm(R10, ARMCache::PageFlags);
+    LOAD_RegMemIdx(8, RAX, R10, R9, 0, 0);
+    TEST_RegReg(RAX, RAX);
+    u8* skip = Jcc(CC_E);
+    MOV_RegReg(ARG0, R9);
+    CALL((void*)ARMCache::PageWritten);
+    SetJumpTarget(skip);
+}
+
+// same as ARMv5::DataRead*/DataWrite*, with the TCM and main RAM cases inline
+// address is in R15D, value to store in R14D
+// loaded value ends up in EAX, data cycles in EDX
+void EmitMemAccess(MemOp* op)
+{
+    u32 size = op->Size;
+    bool store = !op->Load;
+    u8* done[3];
+
+    MOV_RegReg(RCX, R15);
+    if (size == 32)      ALU_RegImm(ALU_AND, RCX, ~3);
+    else if (size == 16) ALU_RegImm(ALU_AND, RCX, ~1);
+
+    // ITCM
+    ALU_RegMem(ALU_CMP, RCX, RBX, OffITCMSize);
+    u8* notitcm = Jcc(CC_AE);
+    if (store) EmitCheckWrite(ARMCache::kCode_ITCM, 0x7FFF);
+    MOV_RegReg(R9, R15);
+    ALU_RegImm(ALU_AND, R9, 0x7FFF & ~((size >> 3) - 1));
+    if (store) STORE_MemIdxReg(size, RBX, R9, OffITCM, R14);
+    else       LOAD_RegMemIdx(size, RAX, RBX, R9, 0, OffITCM);
+    MOV_RegImm(RDX, 1);
+    done[0] = JMP();
+    SetJumpTarget(notitcm);
+
+    // DTCM
+    ALU_RegMem(ALU_CMP, RCX, RBX, OffDTCMBase);
+    u8* notdtcm1 = Jcc(CC_B);
+    MOV_RegMem(R9, RBX, OffDTCMBase);
+    ALU_RegMem(ALU_ADD, R9, RBX, OffDTCMSize);
+    ALU_RegReg(ALU_CMP, RCX, R9);
+    u8* notdtcm2 = Jcc(CC_AE);
+    MOV_RegReg(R9, RCX);
+    ALU_RegMem(ALU_SUB, R9, RBX, OffDTCMBase);
+    ALU_RegImm(ALU_AND, R9, 0x3FFF);
+    if (store) STORE_MemIdxReg(size, RBX, R9, OffDTCM, R14);
+    else       LOAD_RegMemIdx(size, RAX, RBX, R9, 0, OffDTCM);
+    MOV_RegImm(RDX, 1);
+    done[1] = JMP();
+    SetJumpTarget(notdtcm1);
+    SetJumpTarget(notdtcm2);
+
+    // main RAM
+    MOV_RegReg(R9, RCX);
+    SHIFT_RegImm(SH_SHR, R9, 24);
+    ALU_RegImm(ALU_CMP, R9, 0x02);
+    u8* slow = Jcc(CC_NE);
+    if (store) EmitCheckWrite(ARMCache::kCode_MainRAM, MAIN_RAM_SIZE - 1);
+    MOV_RegReg(R9, R15);
+    ALU_RegImm(ALU_AND, R9, (MAIN_RAM_SIZE - 1) & ~((size >> 3) - 1));
+    MOV64_RegImm(R10, NDS::MainRAM);
+    if (store) STORE_MemIdxReg(size, R10, R9, 0, R14);
+    else       LOAD_RegMemIdx(size, RAX, R10, R9, 0, 0);
+    MOV_RegReg(RDX, R15);
+    SHIFT_RegImm(SH_SHR, RDX, 12);
+    LOAD_RegMemIdx(8, RDX, RBX, RDX, 2, OffMemTimings + (size == 32 ? 2 : 1));
+    done[2] = JMP();
+    SetJumpTarget(slow);
+
+    // everything else
+    MOV64_RegReg(ARG0, RBX);
+    MOV_RegReg(ARG1, R15);
+    if (store)
+    {
+        MOV_RegReg(ARG2, R14);
+        if      (size == 8)  CALL((void*)SlowWrite8);
+        else if (size == 16) CALL((void*)SlowWrite16);
+        else                 CALL((void*)SlowWrite32);
+    }
+    else
+    {
+        if      (size == 8)  CALL((void*)SlowRead8);
+        else if (size == 16) CALL((void*)SlowRead16);
+        else                 CALL((void*)SlowRead32);
+    }
+    MOV_RegMem(RDX, RBX, OffDataCycles);
+
+    for (int i = 0; i < 3; i++)
+        SetJumpTarget(done[i]);
+}
+
+void EmitMem(MemOp* op, u32 r15, s32 codecycles)
+{
+    if (op->Rn == -1)
+        MOV_RegImm(R15, op->ImmVal);
+    else
+    {
+        LoadReg(R8, op->Rn, r15);
+        if (op->Imm)
+            MOV_RegImm(RDX, op->ImmVal);
+        else
+        {
+            LoadReg(RDX, op->Rm, r15);
+            EmitShift(RDX, op->ShiftType, op->ShiftAmount, false);
+        }
+
+        MOV_RegReg(RBP, R8);
+        ALU_RegReg(op->Add ? ALU_ADD : ALU_SUB, RBP, RDX);
+        MOV_RegReg(R15, op->Pre ? RBP : R8);
+    }
+
+    if (!op->Load)
+        LoadReg(R14, op->Rd, r15);
+
+    EmitMemAccess(op);
+
+    MOV_MemReg(RBX, OffDataCycles, RDX);
+
+    if (op->Load)
+    {
+        if (op->Rotate)
+        {
+            MOV_RegReg(RCX, R15);
+            ALU_RegImm(ALU_AND, RCX, 0x3);
+            SHIFT_RegImm(SH_SHL, RCX, 3);
+            SHIFT_RegCL(SH_ROR, RAX);
+        }
+        if (op->SignExtend)
+            MOVSX_RegReg(op->Size, RAX, RAX);
+    }
+
+    // AddCycles_CDI/AddCycles_CD
+    MOV_RegReg(RCX, RDX);
+    ALU_RegImm(ALU_ADD, RCX, codecycles - 6);
+    MOV_RegImm(R9, codecycles);
+    ALU_RegReg(ALU_CMP, RDX, R9);
+    CMOVcc(CC_L, RDX, R9);
+    ALU_RegReg(ALU_CMP, RCX, RDX);
+    CMOVcc(CC_G, RDX, RCX);
+    ALU_MemReg(ALU_ADD, RBX, OffCycles, RDX);
+
+    if (op->Rn != -1 && op->Writeback)
+        MOV_MemReg(RBX, OffR + op->Rn*4, RBP);
+    if (op->Load)
+        MOV_MemReg(RBX, OffR + op->Rd*4, RAX);
+}
+
+// what ExecuteCached() does before running a block entry
+void EmitStoreState(ARMCache::Block* block, u32 i, u32 r15, s32 codecycles)
+{
+    MOV_MemImm(RBX, OffR + 15*4, r15);
+    MOV_MemImm(RBX, OffCurInstr, block->Instrs[i].Instr);
+    MOV_MemImm(RBX, OffNextInstr, block->Instrs[i+1].Instr);
+    MOV_MemImm(RBX, OffNextInstr + 4, block->Instrs[i+2].Instr);
+    if (IsARM9)
+        MOV_MemImm(RBX, OffCodeCycles, codecycles);
+}
+
+// what ExecuteCached() does after running a block entry
+void EmitPostChecks(ARMCache::Block* block, u32 r15, bool last, bool memchange)
+{
+    u32 num = IsARM9 ? 0 : 1;
+
+    ALU_MemImm(ALU_CMP, RBX, OffHalted, 0);
+    JccTo(CC_NE, ExitOK);
+
+    MOV64_RegImm(RAX, &NDS::IF[num]);
+    MOV_RegMem(RCX, RAX, 0);
+    MOV64_RegImm(RAX, &NDS::IE[num]);
+    ALU_RegMem(ALU_AND, RCX, RAX, 0);
+    u8* noirq = Jcc(CC_E);
+    MOV64_RegReg(ARG0, RBX);
+    CALL((void*)CheckIRQ);
+    SetJumpTarget(noirq);
+
+    MOVSXD_RegMem(RAX, RBX, OffCycles);
+    ALU64_MemReg(ALU_ADD, R12, 0, RAX);
+    MOV_MemImm(RBX, OffCycles, 0);
+
+    if (last)
+    {
+        JMPTo(ExitOK);
+        return;
+    }
+
+    ALU_MemImm(ALU_CMP, RBX, OffR + 15*4, r15);
+    JccTo(CC_NE, ExitOK);
+    MOV_RegMem(RAX, RBX, OffCPSR);
+    ALU_RegImm(ALU_AND, RAX, 0x20);
+    ALU_RegImm(ALU_CMP, RAX, Thumb);
+    JccTo(CC_NE, ExitOK);
+
+    MOV64_RegMem(RAX, R12, 0);
+    ALU64_RegMem(ALU_CMP, RAX, R13, 0);
+    JccTo(CC_AE, ExitOK);
+
+    if (memchange)
+    {
+        MOV64_RegImm(RAX, &ARMCache::PageVersion[block->StartPage]);
+        ALU_MemImm(ALU_CMP, RAX, 0, block->StartVersion);
+        JccTo(CC_NE, ExitOK);
+        if (block->EndPage != block->StartPage)
+        {
+            MOV64_RegImm(RAX, &ARMCache::PageVersion[block->EndPage]);
+            ALU_MemImm(ALU_CMP, RAX, 0, block->EndVersion);
+            JccTo(CC_NE, ExitOK);
+        }
+
+        // the code mapping changed, the rest of the block might not be there anymore
+        MOV64_RegImm(RAX, &ARMCache::MapGen);
+        MOV_RegMem(RAX, RAX, 0);
+        ALU_RegMem(ALU_CMP, RAX, RSP, 32);
+        JccTo(CC_NE, ExitOK);
+    }
+}
+
+CompiledBlock Compile(ARM* cpu, ARMCache::Block* block)
+{
+    if (!CodeStart) return NULL;
+
+    if (CodePtr + kMaxBlockCode > CodeStart + kCodeSize)
+    {
+        // out of space. start over
+        // the current block remains usable by the caller until the next lookup
+        ARMCache::Flush(0);
+        ARMCache::Flush(1);
+        CodePtr = CodeStart;
+        return NULL;
+    }
+
+    ARMv5* v5 = (ARMv5*)cpu;
+    u8* base = (u8*)cpu;
+
+    IsARM9 = cpu->Num == 0;
+    Thumb = (block->Addr & 1) ? 0x20 : 0;
+
+    OffR = (u8*)&cpu->R[0] - base;
+    OffCPSR = (u8*)&cpu->CPSR - base;
+    OffCycles = (u8*)&cpu->Cycles - base;
+    OffHalted = (u8*)&cpu->Halted - base;
+    OffCodeCycles = (u8*)&cpu->CodeCycles - base;
+    OffDataCycles = (u8*)&cpu->DataCycles - base;
+    OffCurInstr = (u8*)&cpu->CurInstr - base;
+    OffNextInstr = (u8*)&cpu->NextInstr[0] - base;
+    if (IsARM9)
+    {
+        OffITCM = (u8*)&v5->ITCM[0] - base;
+        OffITCMSize = (u8*)&v5->ITCMSize - base;
+        OffDTCM = (u8*)&v5->DTCM[0] - base;
+        OffDTCMBase = (u8*)&v5->DTCMBase - base;
+        OffDTCMSize = (u8*)&v5->DTCMSize - base;
+        OffMemTimings = (u8*)&v5->MemTimings[0][0] - base;
+        OffRegionCodeCycles = (u8*)&v5->RegionCodeCycles - base;
+    }
+
+    u32 addr = block->Addr & ~1;
+    u32 size = Thumb ? 2 : 4;
+    bool itcm = block->CodeAddr >= ARMCache::kCode_ITCM && block->CodeAddr < ARMCache::kCode_ARM9BIOS;
+
+    // exits, shared by the whole block
+
+    ExitFail = CodePtr;
+    ALU_RegReg(ALU_XOR, RAX, RAX);
+    u8* restore = JMP();
+
+    ExitOK = CodePtr;
+    MOV_RegImm(RAX, 1);
+
+    SetJumpTarget(restore);
+    ALU64_RegImm(ALU_ADD, RSP, 40);
+    POP(R15);
+    POP(R14);
+    POP(R13);
+    POP(R12);
+    POP(RBP);
+    POP(RBX);
+    RET();
+
+    // entry point
+
+    u8* entrypoint = CodePtr;
+
+    PUSH(RBX);
+    PUSH(RBP);
+    PUSH(R12);
+    PUSH(R13);
+    PUSH(R14);
+    PUSH(R15);
+    ALU64_RegImm(ALU_SUB, RSP, 40);
+
+    MOV64_RegReg(RBX, ARG0);
+    if (IsARM9)
+    {
+        MOV64_RegImm(R12, &NDS::ARM9Timestamp);
+        MOV64_RegImm(R13, &NDS::ARM9Target);
+
+        // code timings are resolved at compile time
+        if (!itcm)
+        {
+            ALU_MemImm(ALU_CMP, RBX, OffRegionCodeCycles, v5->RegionCodeCycles);
+            JccTo(CC_NE, ExitFail);
+        }
+    }
+    else
+    {
+        MOV64_RegImm(R12, &NDS::ARM7Timestamp);
+        MOV64_RegImm(R13, &NDS::ARM7Target);
+
+        MOV_RegMem(RAX, RBX, OffCodeCycles);
+        MOV64_RegImm(RCX, &NDS::ARM7MemTimings[0][Thumb ? 1 : 3]);
+        LOAD_RegMemIdx(8, R14, RCX, RAX, 2, 0);
+    }
+
+    MOV64_RegImm(RAX, &ARMCache::MapGen);
+    MOV_RegMem(RAX, RAX, 0);
+    MOV_MemReg(RSP, 32, RAX);
+
+    s32 oldcodecycles = cpu->CodeCycles;
+
+    for (u32 i = 0; i < block->NumInstrs; i++)
+    {
+        ARMCache::BlockEntry* entry = &block->Instrs[i];
+        u32 r15 = addr + (i+2)*size;
+        bool last = (i == block->NumInstrs-1);
+
+        // cycles for AddCycles_C() (ARM9)
+        s32 codecycles = 0;
+        if (IsARM9 && !(Thumb && (r15 & 0x2)))
+        {
+            v5->SetCodeCycles(r15);
+            codecycles = cpu->CodeCycles;
+        }
+
+        ALUOp alu;
+        MemOp mem;
+        bool isalu, ismem;
+        if (Thumb)
+        {
+            if (IsARM9)
+                isalu = DecodeALU_THUMB<ARMv5>(entry->Handler, entry->Instr, r15, &alu);
+            else
+                isalu = DecodeALU_THUMB<ARMv4>(entry->Handler, entry->Instr, r15, &alu);
+            ismem = !isalu && IsARM9 && DecodeMem_THUMB<ARMv5>(entry->Handler, entry->Instr, r15, &mem);
+        }
+        else
+        {
+            isalu = DecodeALU_ARM(entry->Instr, &alu);
+            ismem = !isalu && IsARM9 && DecodeMem_ARM(entry->Instr, &mem);
+        }
+
+        // native ALU ops past the first one don't need the pipeline state or
+        // the full checks: they can't raise IRQs, halt, branch or write memory
+        bool light = isalu && i > 0;
+
+        if (!light)
+            EmitStoreState(block, i, r15, codecycles);
+
+        u8* condfail = NULL;
+        if (entry->Cond != 0xE)
+        {
+            MOV_RegMem(RAX, RBX, OffCPSR);
+            SHIFT_RegImm(SH_SHR, RAX, 28);
+            MOV_RegImm(RCX, ARM::ConditionTable[entry->Cond]);
+            BT_RegReg(RCX, RAX);
+            condfail = Jcc(CC_AE);
+        }
+
+        if (isalu)
+        {
+            EmitALU(&alu, r15);
+        }
+        else if (ismem)
+        {
+            EmitMem(&mem, r15, codecycles);
+        }
+        else
+        {
+            MOV64_RegReg(ARG0, RBX);
+            CALL((void*)entry->Handler);
+        }
+
+        // AddCycles_C() for ALU ops, and for failed conditions
+        // (ALU ops share it with the failed condition path)
+        u8* skip = NULL;
+        if (condfail)
+        {
+            if (!isalu) skip = JMP();
+            SetJumpTarget(condfail);
+        }
+        if (isalu || condfail)
+        {
+            if (light)
+            {
+                if (IsARM9)
+                {
+                    if (codecycles) ALU64_MemImm(ALU_ADD, R12, 0, codecycles);
+                }
+                else
+                    ALU64_MemReg(ALU_ADD, R12, 0, R14);
+            }
+            else
+            {
+                if (IsARM9) ALU_MemImm(ALU_ADD, RBX, OffCycles, codecycles);
+                else        ALU_MemReg(ALU_ADD, RBX, OffCycles, R14);
+            }
+        }
+        if (skip)
+            SetJumpTarget(skip);
+
+        if (light)
+        {
+            if (!last)
+            {
+                MOV64_RegMem(RAX, R12, 0);
+                ALU64_RegMem(ALU_CMP, RAX, R13, 0);
+                u8* cont = Jcc(CC_B);
+                EmitStoreState(block, i, r15, codecycles);
+                JMPTo(ExitOK);
+                SetJumpTarget(cont);
+            }
+            else
+            {
+                EmitStoreState(block, i, r15, codecycles);
+                JMPTo(ExitOK);
+            }
+        }
+        else
+        {
+            bool memchange = !isalu && !(ismem && mem.Load);
+            EmitPostChecks(block, r15, last, memchange);
+        }
+    }
+
+    cpu->CodeCycles = oldcodecycles;
+
+    block->JITCode = entrypoint;
+    return (CompiledBlock)entrypoint;
+}
+
+#else
+
+bool Init()
+{
+    return true;
+}
+
+void DeInit()
+{
+}
+
+void Reset()
+{
+}
+
+CompiledBlock Compile(ARM* cpu, ARMCache::Block* block)
+{
+    return NULL;
+}
+
+#endif
+
+}
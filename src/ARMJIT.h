@@ -0,0 +1,54 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ARMJIT_H
+#define ARMJIT_H
+
+#include "types.h"
+#include "ARMCache.h"
+
+class ARM;
+
+// dynamic recompiler for the CPU cores
+//
+// works on top of the block cache: blocks get translated to native code the
+// first time they're run. simple ALU ops (and ARM9 loads/stores to TCM and
+// main RAM) are emitted inline, everything else calls the interpreter
+// handlers, so the CPU state is always the same as with the interpreter.
+//
+// only implemented for x86-64. on other platforms Compile() never succeeds,
+// and the block cache falls back to the cached interpreter.
+
+namespace ARMJIT
+{
+
+// returns 0 if the block couldn't be run (timings changed since it was
+// compiled), in which case nothing was executed
+typedef u32 (*CompiledBlock)(ARM* cpu);
+
+extern bool Enabled;
+
+bool Init();
+void DeInit();
+void Reset();
+
+CompiledBlock Compile(ARM* cpu, ARMCache::Block* block);
+
+}
+
+#endif // ARMJIT_H
@@ -20,6 +20,7 @@
 #include <string.h>
 #include "NDS.h"
 #include "ARM.h"
+#include "ARMCache.h"
 
 
 // access timing for cached regions
@@ -122,6 +123,8 @@ void ARMv5::UpdateITCMSetting()
         ITCMSize = 0;
         //printf("ITCM disabled\n");
     }
+
+    ARMCache::UpdateMapping();
 }
 
 
@@ -675,6 +678,24 @@ u32 ARMv5::CodeRead32(u32 addr, bool branch)
     return NDS::ARM9Read32(addr);
 }
 
+void ARMv5::SetCodeCycles(u32 addr)
+{
+    if (addr < ITCMSize)
+    {
+        CodeCycles = 1;
+        return;
+    }
+
+    CodeCycles = RegionCodeCycles;
+    if (CodeCycles == 0xFF)
+    {
+        if (!(addr & 0x1F))
+            CodeCycles = kCodeCacheTiming;
+        else
+            CodeCycles = 1;
+    }
+}
+
 
 void ARMv5::DataRead8(u32 addr, u32* val)
 {
@@ -763,6 +784,7 @@ void ARMv5::DataWrite8(u32 addr, u8 val)
     if (addr < ITCMSize)
     {
         DataCycles = 1;
+        ARMCache::CheckWrite(ARMCache::kCode_ITCM + (addr & 0x7FFF));
         *(u8*)&ITCM[addr & 0x7FFF] = val;
         return;
     }
@@ -784,6 +806,7 @@ void ARMv5::DataWrite16(u32 addr, u16 val)
     if (addr < ITCMSize)
     {
         DataCycles = 1;
+        ARMCache::CheckWrite(ARMCache::kCode_ITCM + (addr & 0x7FFF));
         *(u16*)&ITCM[addr & 0x7FFF] = val;
         return;
     }
@@ -805,6 +828,7 @@ void ARMv5::DataWrite32(u32 addr, u32 val)
     if (addr < ITCMSize)
     {
         DataCycles = 1;
+        ARMCache::CheckWrite(ARMCache::kCode_ITCM + (addr & 0x7FFF));
         *(u32*)&ITCM[addr & 0x7FFF] = val;
         return;
     }
@@ -826,6 +850,7 @@ void ARMv5::DataWrite32S(u32 addr, u32 val)
     if (addr < ITCMSize)
     {
         DataCycles += 1;
+        ARMCache::CheckWrite(ARMCache::kCode_ITCM + (addr & 0x7FFF));
         *(u32*)&ITCM[addr & 0x7FFF] = val;
         return;
     }
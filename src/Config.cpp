@@ -30,18 +30,42 @@ const char* kConfigFile = "melonDS.ini";
 
 int _3DRenderer;
 int Threaded3D;
+int Threaded2D;
+int Render3DThreads;
 
 int GL_ScaleFactor;
 int GL_Antialias;
 
+int CPUBackend;
+
+int AudioBatchMix;
+
+int IdleLoopSkip;
+char IdleLoopExclude[256];
+
+int RewindInterval;
+int RewindBufferSize;
+
 ConfigEntry ConfigFile[] =
 {
     {"3DRenderer", 0, &_3DRenderer, 1, NULL, 0},
     {"Threaded3D", 0, &Threaded3D, 1, NULL, 0},
+    {"Threaded2D", 0, &Threaded2D, 0, NULL, 0},
+    {"Render3DThreads", 0, &Render3DThreads, 1, NULL, 0},
 
     {"GL_ScaleFactor", 0, &GL_ScaleFactor, 1, NULL, 0},
     {"GL_Antialias", 0, &GL_Antialias, 0, NULL, 0},
 
+    {"CPUBackend", 0, &CPUBackend, 1, NULL, 0},
+
+    {"AudioBatchMix", 0, &AudioBatchMix, 1, NULL, 0},
+
+    {"IdleLoopSkip", 0, &IdleLoopSkip, 1, NULL, 0},
+    {"IdleLoopExclude", 1, IdleLoopExclude, 0, "", 255},
+
+    {"RewindInterval", 0, &RewindInterval, 0, NULL, 0},
+    {"RewindBufferSize", 0, &RewindBufferSize, 64, NULL, 0},
+
     {"", -1, NULL, 0, NULL, 0}
 };
 
@@ -77,12 +101,12 @@ void Load()
     if (!f) return;
 
     char linebuf[1024];
-    char entryname[16];
+    char entryname[32];
     char entryval[1024];
     while (!feof(f))
     {
         fgets(linebuf, 1024, f);
-        int ret = sscanf(linebuf, "%15[A-Za-z_0-9]=%[^\t\n]", entryname, entryval);
+        int ret = sscanf(linebuf, "%31[A-Za-z_0-9]=%[^\t\n]", entryname, entryval);
         if (ret < 2) continue;
 
         ConfigEntry* entry = &ConfigFile[0];
@@ -97,7 +121,7 @@ void Load()
                 c++;
             }
 
-            if (!strncmp(entry->Name, entryname, 15))
+            if (!strncmp(entry->Name, entryname, 31))
             {
                 if (entry->Type == 0)
                     *(int*)entry->Value = strtol(entryval, NULL, 10);
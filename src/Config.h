@@ -42,10 +42,29 @@ void Save();
 
 extern int _3DRenderer;
 extern int Threaded3D;
+extern int Threaded2D;
+// threads for the software 3D renderer when threaded, 0 = auto
+extern int Render3DThreads;
 
 extern int GL_ScaleFactor;
 extern int GL_Antialias;
 
+// 0 = interpreter, 1 = cached interpreter, 2 = JIT
+extern int CPUBackend;
+
+// mix audio in batches instead of one sample at a time (same output)
+extern int AudioBatchMix;
+
+// skip idle loops (CPU spinning on memory/IO that can't change), except
+// for the game codes listed in IdleLoopExclude (comma-separated)
+extern int IdleLoopSkip;
+extern char IdleLoopExclude[256];
+
+// frames between rewind snapshots, 0 = rewind disabled
+extern int RewindInterval;
+// size of the rewind buffer, in MB
+extern int RewindBufferSize;
+
 }
 
 #endif // CONFIG_H
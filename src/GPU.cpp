@@ -20,6 +20,9 @@
 #include <string.h>
 #include "NDS.h"
 #include "GPU.h"
+#include "Config.h"
+#include "Platform.h"
+#include "Profiler.h"
 u64 vbltime;
 
 namespace GPU
@@ -50,6 +53,7 @@ u8 VRAM_G[ 16*1024];
 u8 VRAM_H[ 32*1024];
 u8 VRAM_I[ 16*1024];
 u8* VRAM[9] = {VRAM_A, VRAM_B, VRAM_C, VRAM_D, VRAM_E, VRAM_F, VRAM_G, VRAM_H, VRAM_I};
+const u32 VRAMMask[9] = {0x1FFFF, 0x1FFFF, 0x1FFFF, 0x1FFFF, 0xFFFF, 0x3FFF, 0x3FFF, 0x7FFF, 0x3FFF};
 
 u8 VRAMCNT[9];
 u8 VRAMSTAT;
@@ -66,11 +70,35 @@ u32 VRAMMap_AOBJExtPal;
 u32 VRAMMap_BBGExtPal[4];
 u32 VRAMMap_BOBJExtPal;
 
+u8* VRAMView_ABG[0x20];
+u8* VRAMView_AOBJ[0x10];
+u8* VRAMView_BBG[0x8];
+u8* VRAMView_BOBJ[0x8];
+
+// pages where several banks overlap, allocated the first time it happens
+u8* VRAMMerged_ABG[0x20];
+u8* VRAMMerged_AOBJ[0x10];
+u8* VRAMMerged_BBG[0x8];
+u8* VRAMMerged_BOBJ[0x8];
+
+u32 VRAMMergedBanks_ABG;
+u32 VRAMMergedBanks_AOBJ;
+u32 VRAMMergedBanks_BBG;
+u32 VRAMMergedBanks_BOBJ;
+
+// seen where nothing is mapped
+u8 VRAMZeroPage[0x4000];
+
 u32 VRAMMap_Texture[4];
 u32 VRAMMap_TexPal[8];
 
 u32 VRAMMap_ARM7[2];
 
+u32 VRAMGen_Texture[4];
+u32 VRAMGen_TexPal[8];
+
+u32 VRAMDirtyPages[9];
+
 int FrontBuffer;
 u32* Framebuffer[2][2];
 bool Accelerated;
@@ -78,6 +106,56 @@ bool Accelerated;
 GPU2D* GPU2D_A;
 GPU2D* GPU2D_B;
 
+// threaded 2D rendering
+// each scanline is drawn by the render thread while the emulation thread
+// carries on, until something the scanline depends on is modified (see
+// Sync2D()) or the next scanline is due
+
+void* Render2DThread;
+bool Render2DThreadRunning;
+bool Render2DBusy;
+u32 Render2DLine;
+void* Sema_Render2DStart;
+void* Sema_Render2DDone;
+
+void Render2DThreadFunc();
+
+
+void StopRender2DThread()
+{
+    if (Render2DThreadRunning)
+    {
+        Sync2D();
+
+        Render2DThreadRunning = false;
+        Platform::Semaphore_Post(Sema_Render2DStart);
+        Platform::Thread_Wait(Render2DThread);
+        Platform::Thread_Free(Render2DThread);
+    }
+}
+
+void SetupRender2DThread()
+{
+    if (Config::Threaded2D)
+    {
+        if (!Render2DThreadRunning)
+        {
+            Render2DThreadRunning = true;
+            Render2DThread = Platform::Thread_Create(Render2DThreadFunc);
+        }
+    }
+    else
+    {
+        StopRender2DThread();
+    }
+}
+
+void WaitRender2D()
+{
+    Platform::Semaphore_Wait(Sema_Render2DDone);
+    Render2DBusy = false;
+}
+
 
 bool Init()
 {
@@ -85,17 +163,32 @@ bool Init()
     GPU2D_B = new GPU2D(1);
     if (!GPU3D::Init()) return false;
 
+    Sema_Render2DStart = Platform::Semaphore_Create();
+    Sema_Render2DDone = Platform::Semaphore_Create();
+    Render2DThreadRunning = false;
+    Render2DBusy = false;
+
     FrontBuffer = 0;
     Framebuffer[0][0] = NULL; Framebuffer[0][1] = NULL;
     Framebuffer[1][0] = NULL; Framebuffer[1][1] = NULL;
     Accelerated = false;
     SetDisplaySettings(false);
 
+    memset(VRAMMerged_ABG, 0, sizeof(VRAMMerged_ABG));
+    memset(VRAMMerged_AOBJ, 0, sizeof(VRAMMerged_AOBJ));
+    memset(VRAMMerged_BBG, 0, sizeof(VRAMMerged_BBG));
+    memset(VRAMMerged_BOBJ, 0, sizeof(VRAMMerged_BOBJ));
+    UpdateVRAMViews();
+
     return true;
 }
 
 void DeInit()
 {
+    StopRender2DThread();
+    Platform::Semaphore_Free(Sema_Render2DStart);
+    Platform::Semaphore_Free(Sema_Render2DDone);
+
     delete GPU2D_A;
     delete GPU2D_B;
     GPU3D::DeInit();
@@ -104,10 +197,17 @@ void DeInit()
     if (Framebuffer[0][1]) delete[] Framebuffer[0][1];
     if (Framebuffer[1][0]) delete[] Framebuffer[1][0];
     if (Framebuffer[1][1]) delete[] Framebuffer[1][1];
+
+    for (int i = 0; i < 0x20; i++) if (VRAMMerged_ABG[i]) delete[] VRAMMerged_ABG[i];
+    for (int i = 0; i < 0x10; i++) if (VRAMMerged_AOBJ[i]) delete[] VRAMMerged_AOBJ[i];
+    for (int i = 0; i < 0x8; i++) if (VRAMMerged_BBG[i]) delete[] VRAMMerged_BBG[i];
+    for (int i = 0; i < 0x8; i++) if (VRAMMerged_BOBJ[i]) delete[] VRAMMerged_BOBJ[i];
 }
 
 void Reset()
 {
+    Sync2D();
+
     VCount = 0;
     NextVCount = -1;
     TotalScanlines = 0;
@@ -150,6 +250,13 @@ void Reset()
 
     VRAMMap_ARM7[0] = 0;
     VRAMMap_ARM7[1] = 0;
+
+    TextureDirty(0xF);
+    TexPalDirty(0xFF);
+    memset(VRAMDirtyPages, 0xFF, sizeof(VRAMDirtyPages));
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 printf("RESET: ACCEL=%d FRAMEBUFFER=%p\n", Accelerated, Framebuffer[0][0]);
     int fbsize;
     if (Accelerated) fbsize = (256*3 + 1) * 192;
@@ -176,6 +283,8 @@ printf("RESET: ACCEL=%d FRAMEBUFFER=%p\n", Accelerated, Framebuffer[0][0]);
 
 void Stop()
 {
+    Sync2D();
+
     int fbsize;
     if (Accelerated) fbsize = (256*3 + 1) * 192;
     else             fbsize = 256 * 192;
@@ -187,6 +296,8 @@ void Stop()
 
 void DoSavestate(Savestate* file)
 {
+    Sync2D();
+
     file->Section("GPUG");
 
     file->Var16(&VCount);
@@ -232,6 +343,16 @@ void DoSavestate(Savestate* file)
     file->Var32(&VRAMMap_ARM7[0]);
     file->Var32(&VRAMMap_ARM7[1]);
 
+    if (!file->Saving)
+    {
+        UpdateVRAMViews();
+        NDS::UpdateFastMemVRAM();
+
+        TextureDirty(0xF);
+        TexPalDirty(0xFF);
+        memset(VRAMDirtyPages, 0xFF, sizeof(VRAMDirtyPages));
+    }
+
     GPU2D_A->DoSavestate(file);
     GPU2D_B->DoSavestate(file);
     GPU3D::DoSavestate(file);
@@ -254,6 +375,8 @@ void AssignFramebuffers()
 
 void SetDisplaySettings(bool accel)
 {
+    Sync2D();
+
     int fbsize;
     if (accel) fbsize = (256*3 + 1) * 192;
     else       fbsize = 256 * 192;
@@ -313,6 +436,168 @@ void SetDisplaySettings(bool accel)
 #define MAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) map[(base)+i] |= bankmask;
 #define UNMAP_RANGE(map, base, n)  for (int i = 0; i < n; i++) map[(base)+i] &= ~bankmask;
 
+// banks can't be written to while they're mapped as texture or texture palette
+// memory, so what the 3D renderers see there only changes when the mapping does
+void TextureDirty(u32 slots)
+{
+    for (int i = 0; i < 4; i++)
+        if (slots & (1<<i)) VRAMGen_Texture[i]++;
+}
+
+void TexPalDirty(u32 slots)
+{
+    for (int i = 0; i < 8; i++)
+        if (slots & (1<<i)) VRAMGen_TexPal[i]++;
+}
+
+u8* GetVRAMPage(u32 mask, u32 addr, int* bank)
+{
+    // nothing mapped, or several banks overlapping
+    if (!mask || (mask & (mask-1))) return NULL;
+
+    int b = 0;
+    while (!(mask & (1<<b))) b++;
+
+    *bank = b;
+    return &VRAM[b][addr & VRAMMask[b]];
+}
+
+u8* GetVRAMPage_ARM9(u32 addr, int* bank)
+{
+    switch (addr & 0x00E00000)
+    {
+    case 0x00000000: return GetVRAMPage(VRAMMap_ABG[(addr >> 14) & 0x1F], addr, bank);
+    case 0x00200000: return GetVRAMPage(VRAMMap_BBG[(addr >> 14) & 0x7], addr, bank);
+    case 0x00400000: return GetVRAMPage(VRAMMap_AOBJ[(addr >> 14) & 0xF], addr, bank);
+    case 0x00600000: return GetVRAMPage(VRAMMap_BOBJ[(addr >> 14) & 0x7], addr, bank);
+    }
+
+    // LCDC, same layout as ReadVRAM_LCDC()
+    u32 ofs = addr & 0xFC000;
+    int b;
+    if      (ofs < 0x80000)  b = ofs >> 17;
+    else if (ofs < 0x90000)  b = 4;
+    else if (ofs == 0x90000) b = 5;
+    else if (ofs == 0x94000) b = 6;
+    else if (ofs < 0xA0000)  b = 7;
+    else if (ofs == 0xA0000) b = 8;
+    else return NULL;
+
+    return GetVRAMPage(VRAMMap_LCDC & (1<<b), addr, bank);
+}
+
+u8* GetVRAMPage_ARM7(u32 addr, int* bank)
+{
+    return GetVRAMPage(VRAMMap_ARM7[(addr >> 17) & 0x1], addr, bank);
+}
+
+void UpdateVRAMView(u8** view, u8** merged, u32* map, u32 num, u32* mergedbanks)
+{
+    *mergedbanks = 0;
+
+    for (u32 i = 0; i < num; i++)
+    {
+        u32 mask = map[i];
+        u32 addr = i << 14;
+        int bank;
+
+        u8* page = GetVRAMPage(mask, addr, &bank);
+        if (page)
+        {
+            view[i] = page;
+            continue;
+        }
+
+        if (!mask)
+        {
+            view[i] = VRAMZeroPage;
+            continue;
+        }
+
+        // overlapping banks read as the OR of all of them. writes to these
+        // banks redo the written bytes, see UpdateMergedVRAM().
+        if (!merged[i]) merged[i] = new u8[0x4000];
+        *mergedbanks |= mask;
+
+        u32* dst = (u32*)merged[i];
+        memset(dst, 0, 0x4000);
+        for (int b = 0; b < 9; b++)
+        {
+            if (!(mask & (1<<b))) continue;
+
+            u32* src = (u32*)&VRAM[b][addr & VRAMMask[b]];
+            for (int j = 0; j < 0x1000; j++)
+                dst[j] |= src[j];
+        }
+
+        view[i] = merged[i];
+    }
+}
+
+void UpdateVRAMViews()
+{
+    UpdateVRAMView(VRAMView_ABG, VRAMMerged_ABG, VRAMMap_ABG, 0x20, &VRAMMergedBanks_ABG);
+    UpdateVRAMView(VRAMView_AOBJ, VRAMMerged_AOBJ, VRAMMap_AOBJ, 0x10, &VRAMMergedBanks_AOBJ);
+    UpdateVRAMView(VRAMView_BBG, VRAMMerged_BBG, VRAMMap_BBG, 0x8, &VRAMMergedBanks_BBG);
+    UpdateVRAMView(VRAMView_BOBJ, VRAMMerged_BOBJ, VRAMMap_BOBJ, 0x8, &VRAMMergedBanks_BOBJ);
+}
+
+void UpdateMergedVRAM(u8** merged, u32* map, u32 num, u32 mask, u32 addr, u32 len)
+{
+    // a mirrored bank shows the same bytes at the same offset within each
+    // of its pages, so only that offset needs to be redone, in every page
+    // that has one of the written banks merged with others
+    u32 offset = addr & 0x3FFF;
+
+    for (u32 i = 0; i < num; i++)
+    {
+        u32 pagemask = map[i];
+        if (!(pagemask & mask) || !(pagemask & (pagemask-1))) continue;
+
+        u32 pageaddr = (i << 14) | offset;
+        for (u32 j = 0; j < len; j++)
+        {
+            u8 val = 0;
+            for (int b = 0; b < 9; b++)
+            {
+                if (pagemask & (1<<b))
+                    val |= VRAM[b][(pageaddr + j) & VRAMMask[b]];
+            }
+
+            merged[i][offset + j] = val;
+        }
+    }
+}
+
+void UpdateMergedVRAM_ABG(u32 mask, u32 addr, u32 len)
+{
+    UpdateMergedVRAM(VRAMMerged_ABG, VRAMMap_ABG, 0x20, mask, addr, len);
+}
+
+void UpdateMergedVRAM_AOBJ(u32 mask, u32 addr, u32 len)
+{
+    UpdateMergedVRAM(VRAMMerged_AOBJ, VRAMMap_AOBJ, 0x10, mask, addr, len);
+}
+
+void UpdateMergedVRAM_BBG(u32 mask, u32 addr, u32 len)
+{
+    UpdateMergedVRAM(VRAMMerged_BBG, VRAMMap_BBG, 0x8, mask, addr, len);
+}
+
+void UpdateMergedVRAM_BOBJ(u32 mask, u32 addr, u32 len)
+{
+    UpdateMergedVRAM(VRAMMerged_BOBJ, VRAMMap_BOBJ, 0x8, mask, addr, len);
+}
+
+void VRAMPagesDirty(u32 mask, u32 addr)
+{
+    for (int bank = 0; mask; bank++, mask >>= 1)
+    {
+        if (mask & 0x1)
+            VRAMPageDirty(bank, addr & VRAMMask[bank]);
+    }
+}
+
 void MapVRAM_AB(u32 bank, u8 cnt)
 {
     u8 oldcnt = VRAMCNT[bank];
@@ -320,6 +605,8 @@ void MapVRAM_AB(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u8 oldofs = (oldcnt >> 3) & 0x3;
     u8 ofs = (cnt >> 3) & 0x3;
     u32 bankmask = 1 << bank;
@@ -343,6 +630,7 @@ void MapVRAM_AB(u32 bank, u8 cnt)
 
         case 3: // texture
             VRAMMap_Texture[oldofs] &= ~bankmask;
+            TextureDirty(1 << oldofs);
             break;
         }
     }
@@ -366,9 +654,13 @@ void MapVRAM_AB(u32 bank, u8 cnt)
 
         case 3: // texture
             VRAMMap_Texture[ofs] |= bankmask;
+            TextureDirty(1 << ofs);
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 void MapVRAM_CD(u32 bank, u8 cnt)
@@ -380,6 +672,8 @@ void MapVRAM_CD(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -403,6 +697,7 @@ void MapVRAM_CD(u32 bank, u8 cnt)
 
         case 3: // texture
             VRAMMap_Texture[oldofs] &= ~bankmask;
+            TextureDirty(1 << oldofs);
             break;
 
         case 4: // BBG/BOBJ
@@ -438,6 +733,7 @@ void MapVRAM_CD(u32 bank, u8 cnt)
 
         case 3: // texture
             VRAMMap_Texture[ofs] |= bankmask;
+            TextureDirty(1 << ofs);
             break;
 
         case 4: // BBG/BOBJ
@@ -452,6 +748,9 @@ void MapVRAM_CD(u32 bank, u8 cnt)
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 void MapVRAM_E(u32 bank, u8 cnt)
@@ -461,6 +760,8 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -481,6 +782,7 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
         case 3: // texture palette
             UNMAP_RANGE(VRAMMap_TexPal, 0, 4);
+            TexPalDirty(0x0F);
             break;
 
         case 4: // ABG ext palette
@@ -509,6 +811,7 @@ void MapVRAM_E(u32 bank, u8 cnt)
 
         case 3: // texture palette
             MAP_RANGE(VRAMMap_TexPal, 0, 4);
+            TexPalDirty(0x0F);
             break;
 
         case 4: // ABG ext palette
@@ -518,6 +821,9 @@ void MapVRAM_E(u32 bank, u8 cnt)
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 void MapVRAM_FG(u32 bank, u8 cnt)
@@ -527,6 +833,8 @@ void MapVRAM_FG(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u8 oldofs = (oldcnt >> 3) & 0x7;
     u8 ofs = (cnt >> 3) & 0x7;
     u32 bankmask = 1 << bank;
@@ -551,6 +859,7 @@ void MapVRAM_FG(u32 bank, u8 cnt)
 
         case 3: // texture palette
             VRAMMap_TexPal[(oldofs & 0x1) + ((oldofs & 0x2) << 1)] &= ~bankmask;
+            TexPalDirty(1 << ((oldofs & 0x1) + ((oldofs & 0x2) << 1)));
             break;
 
         case 4: // ABG ext palette
@@ -586,6 +895,7 @@ void MapVRAM_FG(u32 bank, u8 cnt)
 
         case 3: // texture palette
             VRAMMap_TexPal[(ofs & 0x1) + ((ofs & 0x2) << 1)] |= bankmask;
+            TexPalDirty(1 << ((ofs & 0x1) + ((ofs & 0x2) << 1)));
             break;
 
         case 4: // ABG ext palette
@@ -600,6 +910,9 @@ void MapVRAM_FG(u32 bank, u8 cnt)
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 void MapVRAM_H(u32 bank, u8 cnt)
@@ -609,6 +922,8 @@ void MapVRAM_H(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -656,6 +971,9 @@ void MapVRAM_H(u32 bank, u8 cnt)
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 void MapVRAM_I(u32 bank, u8 cnt)
@@ -665,6 +983,8 @@ void MapVRAM_I(u32 bank, u8 cnt)
 
     if (oldcnt == cnt) return;
 
+    Sync2D();
+
     u32 bankmask = 1 << bank;
 
     if (oldcnt & (1<<7))
@@ -718,6 +1038,9 @@ void MapVRAM_I(u32 bank, u8 cnt)
             break;
         }
     }
+
+    UpdateVRAMViews();
+    NDS::UpdateFastMemVRAM();
 }
 
 
@@ -733,6 +1056,8 @@ void SetPowerCnt(u32 val)
 
     if (!(val & (1<<0))) printf("!!! CLEARING POWCNT BIT0. DANGER\n");
 
+    Sync2D();
+
     GPU2D_A->SetEnabled(val & (1<<1));
     GPU2D_B->SetEnabled(val & (1<<9));
     GPU3D::SetEnabled(val & (1<<3), val & (1<<2));
@@ -771,6 +1096,8 @@ void StartFrame()
     // * if we have display FIFO DMA
     RunFIFO = GPU2D_A->UsesFIFO() || NDS::DMAsInMode(0, 0x04);
 
+    SetupRender2DThread();
+
     TotalScanlines = 0;
     StartScanline(0);
 }
@@ -786,8 +1113,23 @@ void StartHBlank(u32 line)
         // note: this should start 48 cycles after the scanline start
         if (line < 192)
         {
-            GPU2D_A->DrawScanline(line);
-            GPU2D_B->DrawScanline(line);
+            PROFILE_SCOPE(Section_GPU2D);
+
+            Sync2D();
+            GPU2D_A->LatchScanline(line);
+            GPU2D_B->LatchScanline(line);
+
+            if (Render2DThreadRunning && !GPU2D_A->NeedsSyncDraw())
+            {
+                Render2DLine = line;
+                Render2DBusy = true;
+                Platform::Semaphore_Post(Sema_Render2DStart);
+            }
+            else
+            {
+                GPU2D_A->DrawScanline(line);
+                GPU2D_B->DrawScanline(line);
+            }
         }
 
         NDS::CheckDMAs(0, 0x02);
@@ -808,6 +1150,8 @@ void StartHBlank(u32 line)
 
 void FinishFrame(u32 lines)
 {
+    Sync2D();
+
     FrontBuffer = FrontBuffer ? 0 : 1;
     AssignFramebuffers();
 
@@ -923,4 +1267,24 @@ void SetVCount(u16 val)
     NextVCount = val;
 }
 
+
+void Render2DThreadFunc()
+{
+    PROFILE_THREAD(2);
+
+    for (;;)
+    {
+        Platform::Semaphore_Wait(Sema_Render2DStart);
+        if (!Render2DThreadRunning) return;
+
+        {
+            PROFILE_SCOPE(Section_GPU2D);
+            GPU2D_A->DrawScanline(Render2DLine);
+            GPU2D_B->DrawScanline(Render2DLine);
+        }
+
+        Platform::Semaphore_Post(Sema_Render2DDone);
+    }
+}
+
 }
@@ -61,12 +61,40 @@ extern u32 VRAMMap_Texture[4];
 extern u32 VRAMMap_TexPal[8];
 extern u32 VRAMMap_ARM7[2];
 
+// VRAM as seen by each 2D engine, one pointer per 16K page. it points to the
+// bank when a single bank is mapped there, to a page where the overlapping
+// banks are merged otherwise, or to a zero-filled page.
+// rebuilt by UpdateVRAMViews() when the mapping changes.
+extern u8* VRAMView_ABG[0x20];
+extern u8* VRAMView_AOBJ[0x10];
+extern u8* VRAMView_BBG[0x8];
+extern u8* VRAMView_BOBJ[0x8];
+
+// banks that are part of a merged page in each view. F/G and H can be
+// mirrored over several pages, so a write to one of these banks can change
+// merged pages other than the one written to, see UpdateMergedVRAM_*().
+extern u32 VRAMMergedBanks_ABG;
+extern u32 VRAMMergedBanks_AOBJ;
+extern u32 VRAMMergedBanks_BBG;
+extern u32 VRAMMergedBanks_BOBJ;
+
+// bumped whenever the contents of a texture (128K) or texture palette (16K)
+// slot may have changed
+extern u32 VRAMGen_Texture[4];
+extern u32 VRAMGen_TexPal[8];
+
+// 4K pages of each bank that were written to, for the OpenGL renderer's
+// texture uploads. cleared by whoever consumes them.
+extern u32 VRAMDirtyPages[9];
+
 extern int FrontBuffer;
 extern u32* Framebuffer[2][2];
 
 extern GPU2D* GPU2D_A;
 extern GPU2D* GPU2D_B;
 
+extern bool Render2DBusy;
+
 
 bool Init();
 void DeInit();
@@ -75,8 +103,48 @@ void Stop();
 
 void DoSavestate(Savestate* file);
 
+void TextureDirty(u32 slots);
+void TexPalDirty(u32 slots);
+
 void SetDisplaySettings(bool accel);
 
+void WaitRender2D();
+
+// the 2D render thread may be drawing a scanline. anything it reads (2D
+// registers, VRAM, palette, OAM) must not be modified before it's done.
+inline void Sync2D()
+{
+    if (Render2DBusy) WaitRender2D();
+}
+
+
+// pointer to the 16K page of VRAM seen at the given address, if it is
+// backed by exactly one bank, NULL otherwise
+// the bank number is returned in 'bank'
+u8* GetVRAMPage_ARM9(u32 addr, int* bank);
+u8* GetVRAMPage_ARM7(u32 addr, int* bank);
+
+inline void OAMDirty(u32 addr)
+{
+    if (addr & 0x400) GPU2D_B->OAMDirty();
+    else              GPU2D_A->OAMDirty();
+}
+
+inline void VRAMPageDirty(u32 bank, u32 offset)
+{
+    VRAMDirtyPages[bank] |= (1 << (offset >> 12));
+}
+
+// same, for every bank in the given mapping mask
+void VRAMPagesDirty(u32 mask, u32 addr);
+
+void UpdateVRAMViews();
+
+// redo the given bytes of every merged page that has one of the banks in mask
+void UpdateMergedVRAM_ABG(u32 mask, u32 addr, u32 len);
+void UpdateMergedVRAM_AOBJ(u32 mask, u32 addr, u32 len);
+void UpdateMergedVRAM_BBG(u32 mask, u32 addr, u32 len);
+void UpdateMergedVRAM_BOBJ(u32 mask, u32 addr, u32 len);
 
 void MapVRAM_AB(u32 bank, u8 cnt);
 void MapVRAM_CD(u32 bank, u8 cnt);
@@ -156,6 +224,8 @@ void WriteVRAM_LCDC(u32 addr, T val)
 {
     int bank;
 
+    Sync2D();
+
     switch (addr & 0xFF8FC000)
     {
     case 0x06800000: case 0x06804000: case 0x06808000: case 0x0680C000:
@@ -211,30 +281,25 @@ void WriteVRAM_LCDC(u32 addr, T val)
     default: return;
     }
 
-    if (VRAMMap_LCDC & (1<<bank)) *(T*)&VRAM[bank][addr] = val;
+    if (VRAMMap_LCDC & (1<<bank))
+    {
+        *(T*)&VRAM[bank][addr] = val;
+        VRAMPageDirty(bank, addr);
+    }
 }
 
 
 template<typename T>
 T ReadVRAM_ABG(u32 addr)
 {
-    u32 ret = 0;
-    u32 mask = VRAMMap_ABG[(addr >> 14) & 0x1F];
-
-    if (mask & (1<<0)) ret |= *(T*)&VRAM_A[addr & 0x1FFFF];
-    if (mask & (1<<1)) ret |= *(T*)&VRAM_B[addr & 0x1FFFF];
-    if (mask & (1<<2)) ret |= *(T*)&VRAM_C[addr & 0x1FFFF];
-    if (mask & (1<<3)) ret |= *(T*)&VRAM_D[addr & 0x1FFFF];
-    if (mask & (1<<4)) ret |= *(T*)&VRAM_E[addr & 0xFFFF];
-    if (mask & (1<<5)) ret |= *(T*)&VRAM_F[addr & 0x3FFF];
-    if (mask & (1<<6)) ret |= *(T*)&VRAM_G[addr & 0x3FFF];
-
-    return ret;
+    return *(T*)&VRAMView_ABG[(addr >> 14) & 0x1F][addr & 0x3FFF];
 }
 
 template<typename T>
 void WriteVRAM_ABG(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_ABG[(addr >> 14) & 0x1F];
 
     if (mask & (1<<0)) *(T*)&VRAM_A[addr & 0x1FFFF] = val;
@@ -244,27 +309,25 @@ void WriteVRAM_ABG(u32 addr, T val)
     if (mask & (1<<4)) *(T*)&VRAM_E[addr & 0xFFFF] = val;
     if (mask & (1<<5)) *(T*)&VRAM_F[addr & 0x3FFF] = val;
     if (mask & (1<<6)) *(T*)&VRAM_G[addr & 0x3FFF] = val;
+
+    if (mask & VRAMMergedBanks_ABG)
+        UpdateMergedVRAM_ABG(mask, addr, sizeof(T));
+
+    VRAMPagesDirty(mask, addr);
 }
 
 
 template<typename T>
 T ReadVRAM_AOBJ(u32 addr)
 {
-    u32 ret = 0;
-    u32 mask = VRAMMap_AOBJ[(addr >> 14) & 0xF];
-
-    if (mask & (1<<0)) ret |= *(T*)&VRAM_A[addr & 0x1FFFF];
-    if (mask & (1<<1)) ret |= *(T*)&VRAM_B[addr & 0x1FFFF];
-    if (mask & (1<<4)) ret |= *(T*)&VRAM_E[addr & 0xFFFF];
-    if (mask & (1<<5)) ret |= *(T*)&VRAM_F[addr & 0x3FFF];
-    if (mask & (1<<6)) ret |= *(T*)&VRAM_G[addr & 0x3FFF];
-
-    return ret;
+    return *(T*)&VRAMView_AOBJ[(addr >> 14) & 0xF][addr & 0x3FFF];
 }
 
 template<typename T>
 void WriteVRAM_AOBJ(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_AOBJ[(addr >> 14) & 0xF];
 
     if (mask & (1<<0)) *(T*)&VRAM_A[addr & 0x1FFFF] = val;
@@ -272,52 +335,58 @@ void WriteVRAM_AOBJ(u32 addr, T val)
     if (mask & (1<<4)) *(T*)&VRAM_E[addr & 0xFFFF] = val;
     if (mask & (1<<5)) *(T*)&VRAM_F[addr & 0x3FFF] = val;
     if (mask & (1<<6)) *(T*)&VRAM_G[addr & 0x3FFF] = val;
+
+    if (mask & VRAMMergedBanks_AOBJ)
+        UpdateMergedVRAM_AOBJ(mask, addr, sizeof(T));
+
+    VRAMPagesDirty(mask, addr);
 }
 
 
 template<typename T>
 T ReadVRAM_BBG(u32 addr)
 {
-    u32 ret = 0;
-    u32 mask = VRAMMap_BBG[(addr >> 14) & 0x7];
-
-    if (mask & (1<<2)) ret |= *(T*)&VRAM_C[addr & 0x1FFFF];
-    if (mask & (1<<7)) ret |= *(T*)&VRAM_H[addr & 0x7FFF];
-    if (mask & (1<<8)) ret |= *(T*)&VRAM_I[addr & 0x3FFF];
-
-    return ret;
+    return *(T*)&VRAMView_BBG[(addr >> 14) & 0x7][addr & 0x3FFF];
 }
 
 template<typename T>
 void WriteVRAM_BBG(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_BBG[(addr >> 14) & 0x7];
 
     if (mask & (1<<2)) *(T*)&VRAM_C[addr & 0x1FFFF] = val;
     if (mask & (1<<7)) *(T*)&VRAM_H[addr & 0x7FFF] = val;
     if (mask & (1<<8)) *(T*)&VRAM_I[addr & 0x3FFF] = val;
+
+    if (mask & VRAMMergedBanks_BBG)
+        UpdateMergedVRAM_BBG(mask, addr, sizeof(T));
+
+    VRAMPagesDirty(mask, addr);
 }
 
 
 template<typename T>
 T ReadVRAM_BOBJ(u32 addr)
 {
-    u32 ret = 0;
-    u32 mask = VRAMMap_BOBJ[(addr >> 14) & 0x7];
-
-    if (mask & (1<<3)) ret |= *(T*)&VRAM_D[addr & 0x1FFFF];
-    if (mask & (1<<8)) ret |= *(T*)&VRAM_I[addr & 0x3FFF];
-
-    return ret;
+    return *(T*)&VRAMView_BOBJ[(addr >> 14) & 0x7][addr & 0x3FFF];
 }
 
 template<typename T>
 void WriteVRAM_BOBJ(u32 addr, T val)
 {
+    Sync2D();
+
     u32 mask = VRAMMap_BOBJ[(addr >> 14) & 0x7];
 
     if (mask & (1<<3)) *(T*)&VRAM_D[addr & 0x1FFFF] = val;
     if (mask & (1<<8)) *(T*)&VRAM_I[addr & 0x3FFF] = val;
+
+    if (mask & VRAMMergedBanks_BOBJ)
+        UpdateMergedVRAM_BOBJ(mask, addr, sizeof(T));
+
+    VRAMPagesDirty(mask, addr);
 }
 
 
@@ -340,6 +409,8 @@ void WriteVRAM_ARM7(u32 addr, T val)
 
     if (mask & (1<<2)) *(T*)&VRAM_C[addr & 0x1FFFF] = val;
     if (mask & (1<<3)) *(T*)&VRAM_D[addr & 0x1FFFF] = val;
+
+    VRAMPagesDirty(mask, addr);
 }
 
 
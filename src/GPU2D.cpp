@@ -18,6 +18,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "NDS.h"
 #include "GPU.h"
 
@@ -90,6 +93,8 @@ GPU2D::~GPU2D()
 
 void GPU2D::Reset()
 {
+    SpritesDirty = true;
+
     DispCnt = 0;
     memset(BGCnt, 0, 4*2);
     memset(BGXPos, 0, 4*2);
@@ -145,6 +150,8 @@ void GPU2D::DoSavestate(Savestate* file)
 {
     file->Section((char*)(Num ? "GP2B" : "GP2A"));
 
+    SpritesDirty = true;
+
     file->Var32(&DispCnt);
     file->VarArray(BGCnt, 4*2);
     file->VarArray(BGXPos, 4*2);
@@ -297,6 +304,8 @@ void GPU2D::Write8(u32 addr, u8 val)
 {
     if (!Enabled) return;
 
+    GPU::Sync2D();
+
     switch (addr & 0x00000FFF)
     {
     case 0x000: DispCnt = (DispCnt & 0xFFFFFF00) | val; return;
@@ -379,6 +388,8 @@ void GPU2D::Write16(u32 addr, u16 val)
 {
     if (!Enabled) return;
 
+    GPU::Sync2D();
+
     switch (addr & 0x00000FFF)
     {
     case 0x000: DispCnt = (DispCnt & 0xFFFF0000) | val; return;
@@ -510,6 +521,8 @@ void GPU2D::Write32(u32 addr, u32 val)
 {
     if (!Enabled) return;
 
+    GPU::Sync2D();
+
     switch (addr & 0x00000FFF)
     {
     case 0x000:
@@ -685,30 +698,297 @@ u32 GPU2D::ColorComposite(int i, u32 val1, u32 val2)
     }
 }
 
+// whole-line versions of the above, for the final composite pass
+//
+// with SSE2, 4 pixels are processed at once. each pixel is seen as two
+// 16-bit lanes: R/B in (val & 0x003F003F), and G in ((val >> 8) & 0x003F003F),
+// where the upper lane is junk and gets overwritten by the 0xFF000000 flags.
+// the intermediate results never exceed 16 bits, so this is bit-exact with
+// the scalar functions.
 
-void GPU2D::DrawScanline(u32 line)
+#ifdef __SSE2__
+
+static inline __m128i Expand16_SSE2(__m128i val)
 {
-    int stride = Accelerated ? (256*3 + 1) : 256;
-    u32* dst = &Framebuffer[stride * line];
+    // 32-bit value (< 0x10000) -> same value in both 16-bit lanes
+    return _mm_or_si128(val, _mm_slli_epi32(val, 16));
+}
+
+static inline __m128i ColorPack_SSE2(__m128i rb, __m128i g)
+{
+    return _mm_or_si128(_mm_or_si128(rb, _mm_slli_epi32(g, 8)), _mm_set1_epi32(0xFF000000));
+}
+
+static inline __m128i ColorBlend4_SSE2(__m128i val1, __m128i val2, __m128i eva, __m128i evb)
+{
+    const __m128i mask = _mm_set1_epi32(0x003F003F);
+    const __m128i max = _mm_set1_epi16(0x3F);
+
+    __m128i rb = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(val1, mask), eva),
+                               _mm_mullo_epi16(_mm_and_si128(val2, mask), evb));
+    __m128i g = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(val1, 8), mask), eva),
+                              _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(val2, 8), mask), evb));
 
-    int n3dline = line;
-    line = GPU::VCount;
+    rb = _mm_min_epi16(_mm_srli_epi16(rb, 4), max);
+    g = _mm_min_epi16(_mm_srli_epi16(g, 4), max);
+
+    return ColorPack_SSE2(rb, g);
+}
+
+static inline __m128i ColorBlend5_SSE2(__m128i val1, __m128i val2)
+{
+    const __m128i mask = _mm_set1_epi32(0x003F003F);
+    const __m128i max = _mm_set1_epi16(0x3F);
+
+    __m128i eva32 = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(val1, 24), _mm_set1_epi32(0x1F)),
+                                  _mm_set1_epi32(1));
+    __m128i eva = Expand16_SSE2(eva32);
+    __m128i evb = _mm_sub_epi16(_mm_set1_epi16(32), eva);
+
+    __m128i rb = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(val1, mask), eva),
+                               _mm_mullo_epi16(_mm_and_si128(val2, mask), evb));
+    __m128i g = _mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(val1, 8), mask), eva),
+                              _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi32(val2, 8), mask), evb));
+
+    // +1 if eva <= 16
+    __m128i round = _mm_and_si128(_mm_cmplt_epi16(eva, _mm_set1_epi16(17)), _mm_set1_epi16(1));
+
+    rb = _mm_min_epi16(_mm_add_epi16(_mm_srli_epi16(rb, 5), round), max);
+    g = _mm_min_epi16(_mm_add_epi16(_mm_srli_epi16(g, 5), round), max);
+
+    // eva=32: first color as-is
+    __m128i keep = _mm_cmpeq_epi32(eva32, _mm_set1_epi32(32));
+    return _mm_or_si128(_mm_and_si128(keep, val1), _mm_andnot_si128(keep, ColorPack_SSE2(rb, g)));
+}
+
+static inline __m128i ColorBrightnessUp_SSE2(__m128i val, __m128i factor)
+{
+    const __m128i mask = _mm_set1_epi32(0x003F003F);
+    const __m128i max = _mm_set1_epi16(0x3F);
+
+    __m128i rb = _mm_and_si128(val, mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(val, 8), mask);
+
+    rb = _mm_add_epi16(rb, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, rb), factor), 4));
+    g = _mm_add_epi16(g, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(max, g), factor), 4));
+
+    return ColorPack_SSE2(rb, g);
+}
 
-    bool forceblank = false;
+static inline __m128i ColorBrightnessDown_SSE2(__m128i val, __m128i factor)
+{
+    const __m128i mask = _mm_set1_epi32(0x003F003F);
+
+    __m128i rb = _mm_and_si128(val, mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(val, 8), mask);
+
+    rb = _mm_sub_epi16(rb, _mm_srli_epi16(_mm_mullo_epi16(rb, factor), 4));
+    g = _mm_sub_epi16(g, _mm_srli_epi16(_mm_mullo_epi16(g, factor), 4));
+
+    return ColorPack_SSE2(rb, g);
+}
+
+static inline __m128i LayerBit_SSE2(__m128i val)
+{
+    // sprite -> 0x10, 3D -> 0x01, BGs/backdrop -> their flag as-is
+    __m128i obj = _mm_srai_epi32(val, 31);
+    __m128i _3d = _mm_andnot_si128(obj, _mm_srai_epi32(_mm_slli_epi32(val, 1), 31));
+    __m128i flag = _mm_srli_epi32(val, 24);
+
+    __m128i ret = _mm_andnot_si128(_mm_or_si128(obj, _3d), flag);
+    ret = _mm_or_si128(ret, _mm_and_si128(obj, _mm_set1_epi32(0x10)));
+    ret = _mm_or_si128(ret, _mm_and_si128(_3d, _mm_set1_epi32(0x01)));
+    return ret;
+}
+
+static inline __m128i Select_SSE2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+#endif
+
+void GPU2D::ColorCompositeLine()
+{
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bc1 = _mm_set1_epi32(BlendCnt & 0x3F);
+    const __m128i bc2 = _mm_set1_epi32((BlendCnt >> 8) & 0x3F);
+    const __m128i eva = _mm_set1_epi32(EVA);
+    const __m128i evb = _mm_set1_epi32(EVB);
+    const __m128i evy = _mm_set1_epi16(EVY);
+    u32 effect = (BlendCnt >> 6) & 0x3;
+
+    for (int i = 0; i < 256; i+=4)
+    {
+        __m128i val1 = _mm_loadu_si128((__m128i*)&BGOBJLine[i]);
+        __m128i val2 = _mm_loadu_si128((__m128i*)&BGOBJLine[256+i]);
+
+        __m128i obj1 = _mm_srai_epi32(val1, 31);
+        __m128i bit30 = _mm_srai_epi32(_mm_slli_epi32(val1, 1), 31);
+
+        __m128i target1 = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(LayerBit_SSE2(val1), bc1), zero),
+                                        _mm_set1_epi32(-1));
+        __m128i target2 = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(LayerBit_SSE2(val2), bc2), zero),
+                                        _mm_set1_epi32(-1));
+
+        __m128i win = _mm_cvtsi32_si128(*(u32*)&WindowMask[i]);
+        win = _mm_unpacklo_epi16(_mm_unpacklo_epi8(win, zero), zero);
+        win = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(win, _mm_set1_epi32(0x20)), zero),
+                            _mm_set1_epi32(-1));
+
+        // sprite blending, 3D layer blending, then the regular color effect
+        __m128i objblend = _mm_and_si128(obj1, target2);
+        __m128i _3dblend = _mm_andnot_si128(obj1, _mm_and_si128(bit30, target2));
+        __m128i regular = _mm_andnot_si128(_mm_or_si128(objblend, _3dblend), _mm_and_si128(target1, win));
+
+        __m128i blend4 = objblend;
+        __m128i up = zero, down = zero;
+        switch (effect)
+        {
+        case 1: blend4 = _mm_or_si128(blend4, _mm_and_si128(regular, target2)); break;
+        case 2: up = regular; break;
+        case 3: down = regular; break;
+        }
+
+        __m128i res = val1;
+
+        if (_mm_movemask_epi8(blend4))
+        {
+            // bitmap sprites use their own alpha
+            __m128i alpha = _mm_and_si128(objblend, bit30);
+            __m128i a = _mm_and_si128(_mm_srli_epi32(val1, 24), _mm_set1_epi32(0x1F));
+            __m128i e1 = Select_SSE2(alpha, a, eva);
+            __m128i e2 = Select_SSE2(alpha, _mm_sub_epi32(_mm_set1_epi32(16), a), evb);
+
+            res = Select_SSE2(blend4, ColorBlend4_SSE2(val1, val2, Expand16_SSE2(e1), Expand16_SSE2(e2)), res);
+        }
+        if (_mm_movemask_epi8(_3dblend))
+            res = Select_SSE2(_3dblend, ColorBlend5_SSE2(val1, val2), res);
+        if (_mm_movemask_epi8(up))
+            res = Select_SSE2(up, ColorBrightnessUp_SSE2(val1, evy), res);
+        if (_mm_movemask_epi8(down))
+            res = Select_SSE2(down, ColorBrightnessDown_SSE2(val1, evy), res);
+
+        _mm_storeu_si128((__m128i*)&BGOBJLine[i], res);
+    }
+#else
+    for (int i = 0; i < 256; i++)
+    {
+        u32 val1 = BGOBJLine[i];
+        u32 val2 = BGOBJLine[256+i];
+
+        BGOBJLine[i] = ColorComposite(i, val1, val2);
+    }
+#endif
+}
+
+void GPU2D::ColorBrightnessUpLine(u32* dst, u32 factor)
+{
+#ifdef __SSE2__
+    __m128i f = _mm_set1_epi16(factor);
+    for (int i = 0; i < 256; i+=4)
+    {
+        __m128i val = _mm_loadu_si128((__m128i*)&dst[i]);
+        _mm_storeu_si128((__m128i*)&dst[i], ColorBrightnessUp_SSE2(val, f));
+    }
+#else
+    for (int i = 0; i < 256; i++)
+        dst[i] = ColorBrightnessUp(dst[i], factor);
+#endif
+}
+
+void GPU2D::ColorBrightnessDownLine(u32* dst, u32 factor)
+{
+#ifdef __SSE2__
+    __m128i f = _mm_set1_epi16(factor);
+    for (int i = 0; i < 256; i+=4)
+    {
+        __m128i val = _mm_loadu_si128((__m128i*)&dst[i]);
+        _mm_storeu_si128((__m128i*)&dst[i], ColorBrightnessDown_SSE2(val, f));
+    }
+#else
+    for (int i = 0; i < 256; i++)
+        dst[i] = ColorBrightnessDown(dst[i], factor);
+#endif
+}
+
+void GPU2D::ConvertLine(u32* dst)
+{
+    // convert to 32-bit BGRA
+    // note: 32-bit RGBA would be more straightforward, but
+    // BGRA seems to be more compatible (Direct2D soft, cairo...)
+#ifdef __SSE2__
+    for (int i = 0; i < 256; i+=4)
+    {
+        __m128i c = _mm_loadu_si128((__m128i*)&dst[i]);
+
+        __m128i r = _mm_and_si128(_mm_slli_epi32(c, 18), _mm_set1_epi32(0xFC0000));
+        __m128i g = _mm_and_si128(_mm_slli_epi32(c, 2), _mm_set1_epi32(0xFC00));
+        __m128i b = _mm_and_si128(_mm_srli_epi32(c, 14), _mm_set1_epi32(0xFC));
+        c = _mm_or_si128(_mm_or_si128(r, g), b);
+
+        c = _mm_or_si128(c, _mm_srli_epi32(_mm_and_si128(c, _mm_set1_epi32(0xC0C0C0)), 6));
+        c = _mm_or_si128(c, _mm_set1_epi32(0xFF000000));
+        _mm_storeu_si128((__m128i*)&dst[i], c);
+    }
+#else
+    for (int i = 0; i < 256; i+=2)
+    {
+        u64 c = *(u64*)&dst[i];
+
+        u64 r = (c << 18) & 0xFC000000FC0000;
+        u64 g = (c << 2) & 0xFC000000FC00;
+        u64 b = (c >> 14) & 0xFC000000FC;
+        c = r | g | b;
+
+        *(u64*)&dst[i] = c | ((c & 0x00C0C0C000C0C0C0) >> 6) | 0xFF000000FF000000;
+    }
+#endif
+}
+
+
+void GPU2D::LatchScanline(u32 line)
+{
+    // this runs on the emulation thread, DrawScanline() may not
+    LineVCount = GPU::VCount;
+
+    LineBlank = false;
 
     // scanlines that end up outside of the GPU drawing range
     // (as a result of writing to VCount) are filled white
-    if (line > 192) forceblank = true;
+    if (LineVCount > 192) LineBlank = true;
 
     // GPU B can be completely disabled by POWCNT1
     // oddly that's not the case for GPU A
-    if (Num && !Enabled) forceblank = true;
+    if (Num && !Enabled) LineBlank = true;
 
     // forced blank
     // (checkme: are there still things that can run under this mode? likely not)
-    if (DispCnt & (1<<7)) forceblank = true;
+    if (DispCnt & (1<<7)) LineBlank = true;
+
+    if (LineBlank) return;
+
+    if (Num == 0)
+    {
+        if (!Accelerated)
+            _3DLine = GPU3D::GetLine(line);
+        else if ((CaptureCnt & (1<<31)) && (((CaptureCnt >> 29) & 0x3) != 1))
+        {
+            _3DLine = GPU3D::GetLine(line);
+            //GPU3D::GLRenderer::PrepareCaptureFrame();
+        }
+    }
+}
+
+void GPU2D::DrawScanline(u32 line)
+{
+    int stride = Accelerated ? (256*3 + 1) : 256;
+    u32* dst = &Framebuffer[stride * line];
 
-    if (forceblank)
+    line = LineVCount;
+
+    if (LineBlank)
     {
         for (int i = 0; i < 256; i++)
             dst[i] = 0xFFFFFFFF;
@@ -723,17 +1003,6 @@ void GPU2D::DrawScanline(u32 line)
     u32 dispmode = DispCnt >> 16;
     dispmode &= (Num ? 0x1 : 0x3);
 
-    if (Num == 0)
-    {
-        if (!Accelerated)
-            _3DLine = GPU3D::GetLine(n3dline);
-        else if ((CaptureCnt & (1<<31)) && (((CaptureCnt >> 29) & 0x3) != 1))
-        {
-            _3DLine = GPU3D::GetLine(n3dline);
-            //GPU3D::GLRenderer::PrepareCaptureFrame();
-        }
-    }
-
     // always render regular graphics
     DrawScanline_BGOBJ(line);
 
@@ -827,10 +1096,7 @@ void GPU2D::DrawScanline(u32 line)
             u32 factor = MasterBrightness & 0x1F;
             if (factor > 16) factor = 16;
 
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessUp(dst[i], factor);
-            }
+            ColorBrightnessUpLine(dst, factor);
         }
         else if ((MasterBrightness >> 14) == 2)
         {
@@ -838,31 +1104,17 @@ void GPU2D::DrawScanline(u32 line)
             u32 factor = MasterBrightness & 0x1F;
             if (factor > 16) factor = 16;
 
-            for (int i = 0; i < 256; i++)
-            {
-                dst[i] = ColorBrightnessDown(dst[i], factor);
-            }
+            ColorBrightnessDownLine(dst, factor);
         }
     }
 
-    // convert to 32-bit BGRA
-    // note: 32-bit RGBA would be more straightforward, but
-    // BGRA seems to be more compatible (Direct2D soft, cairo...)
-    for (int i = 0; i < 256; i+=2)
-    {
-        u64 c = *(u64*)&dst[i];
-
-        u64 r = (c << 18) & 0xFC000000FC0000;
-        u64 g = (c << 2) & 0xFC000000FC00;
-        u64 b = (c >> 14) & 0xFC000000FC;
-        c = r | g | b;
-
-        *(u64*)&dst[i] = c | ((c & 0x00C0C0C000C0C0C0) >> 6) | 0xFF000000FF000000;
-    }
+    ConvertLine(dst);
 }
 
 void GPU2D::VBlank()
 {
+    GPU::Sync2D();
+
     CaptureCnt &= ~(1<<31);
 
     DispFIFOReadPtr = 0;
@@ -871,6 +1123,8 @@ void GPU2D::VBlank()
 
 void GPU2D::VBlankEnd()
 {
+    GPU::Sync2D();
+
     // TODO: find out the exact time this happens
     BGXRefInternal[0] = BGXRef[0];
     BGXRefInternal[1] = BGXRef[1];
@@ -996,6 +1250,11 @@ void GPU2D::DoCapture(u32 line, u32 width)
     dstaddr &= 0xFFFF;
     srcBaddr &= 0xFFFF;
 
+    // the bank can be mapped back as texture memory afterwards
+    // (a line never spans more than two pages, even when wrapping around)
+    GPU::VRAMPageDirty(dstvram, dstaddr << 1);
+    GPU::VRAMPageDirty(dstvram, ((dstaddr + width - 1) & 0xFFFF) << 1);
+
     switch ((CaptureCnt >> 29) & 0x3)
     {
     case 0: // source A
@@ -1206,11 +1465,23 @@ u16* GPU2D::GetOBJExtPal(u32 pal)
 
 void GPU2D::CheckWindows(u32 line)
 {
+    u32 win0 = Win0Active & 0x1;
+    u32 win1 = Win1Active & 0x1;
+
     line &= 0xFF;
-    if (line == Win0Coords[3])      Win0Active &= ~0x1;
-    else if (line == Win0Coords[2]) Win0Active |=  0x1;
-    if (line == Win1Coords[3])      Win1Active &= ~0x1;
-    else if (line == Win1Coords[2]) Win1Active |=  0x1;
+    if (line == Win0Coords[3])      win0 = 0;
+    else if (line == Win0Coords[2]) win0 = 1;
+    if (line == Win1Coords[3])      win1 = 0;
+    else if (line == Win1Coords[2]) win1 = 1;
+
+    if (win0 != (Win0Active & 0x1) || win1 != (Win1Active & 0x1))
+    {
+        // the 2D render thread updates the horizontal bits
+        GPU::Sync2D();
+
+        Win0Active = (Win0Active & ~0x1) | win0;
+        Win1Active = (Win1Active & ~0x1) | win1;
+    }
 }
 
 void GPU2D::CalculateWindowMask(u32 line)
@@ -1378,17 +1649,10 @@ void GPU2D::DrawScanline_BGOBJ(u32 line)
     }
 
     // color special effects
-    // can likely be optimized
 
     if (!Accelerated)
     {
-        for (int i = 0; i < 256; i++)
-        {
-            u32 val1 = BGOBJLine[i];
-            u32 val2 = BGOBJLine[256+i];
-
-            BGOBJLine[i] = ColorComposite(i, val1, val2);
-        }
+        ColorCompositeLine();
     }
     else
     {
@@ -2124,7 +2388,7 @@ void GPU2D::InterleaveSprites(u32 prio)
     }
 }
 
-u32 GPU2D::DrawSprites(u32 line)
+void GPU2D::UpdateSprites()
 {
     u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
 
@@ -2143,155 +2407,148 @@ u32 GPU2D::DrawSprites(u32 line)
         64, 32, 64, 0
     };
 
-    u32 nsprites = 0;
+    memset(SpriteBands, 0, sizeof(SpriteBands));
+    memset(WinSpriteBands, 0, sizeof(WinSpriteBands));
 
-    for (int bgnum = 0x0C00; bgnum >= 0x0000; bgnum -= 0x0400)
+    u32 nsprites = 0, nwinsprites = 0;
+
+    // sprites are drawn by priority then by descending number, window sprites
+    // only by descending number. pass 4 gathers the window sprites.
+    for (int pass = 0; pass < 5; pass++)
     {
+        u32 bgnum = (3 - pass) << 10;
+
         for (int sprnum = 127; sprnum >= 0; sprnum--)
         {
             u16* attrib = &oam[sprnum*4];
 
-            if ((attrib[2] & 0x0C00) != bgnum)
+            bool window = (((attrib[0] >> 10) & 0x3) == 2);
+            if (pass == 4)
+            {
+                if (!window) continue;
+            }
+            else if (window || (attrib[2] & 0x0C00) != bgnum)
                 continue;
 
-            if (((attrib[0] >> 10) & 0x3) == 2)
+            // disabled
+            if ((attrib[0] & 0x0300) == 0x0200)
                 continue;
 
-            if (attrib[0] & 0x0100)
-            {
-                u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
-                s32 boundwidth = width;
-                s32 boundheight = height;
-
-                if (attrib[0] & 0x0200)
-                {
-                    boundwidth <<= 1;
-                    boundheight <<= 1;
-                }
-
-                u32 ypos = attrib[0] & 0xFF;
-                ypos = (line - ypos) & 0xFF;
-                if (ypos >= (u32)boundheight)
-                    continue;
-
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -boundwidth)
-                    continue;
+            u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
+            s32 width = spritewidth[sizeparam];
+            s32 height = spriteheight[sizeparam];
+            s32 boundwidth = width;
+            s32 boundheight = height;
 
-                u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
+            // prohibited shape, never drawn
+            if (!height)
+                continue;
 
-                DrawSprite_Rotscale<false>(attrib, &oam[(rotparamgroup*16) + 3], boundwidth, boundheight, width, height, xpos, ypos);
-                nsprites++;
-            }
-            else
+            if ((attrib[0] & 0x0300) == 0x0300)
             {
-                if (attrib[0] & 0x0200)
-                    continue;
-
-                u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-                s32 width = spritewidth[sizeparam];
-                s32 height = spriteheight[sizeparam];
+                boundwidth <<= 1;
+                boundheight <<= 1;
+            }
 
-                u32 ypos = attrib[0] & 0xFF;
-                ypos = (line - ypos) & 0xFF;
-                if (ypos >= (u32)height)
-                    continue;
+            s32 xpos = (s32)(attrib[1] << 23) >> 23;
+            if (xpos <= -boundwidth)
+                continue;
 
-                s32 xpos = (s32)(attrib[1] << 23) >> 23;
-                if (xpos <= -width)
-                    continue;
+            u32 num = window ? nwinsprites++ : nsprites++;
+            SpriteEntry* spr = window ? &WinSprites[num] : &Sprites[num];
+            u32 (*bands)[4] = window ? WinSpriteBands : SpriteBands;
 
-                // yflip
-                if (attrib[1] & 0x2000)
-                    ypos = height-1 - ypos;
+            spr->Attrib = attrib;
+            if (attrib[0] & 0x0100)
+                spr->RotParams = &oam[(((attrib[1] >> 9) & 0x1F) * 16) + 3];
+            else
+                spr->RotParams = NULL;
+            spr->XPos = xpos;
+            spr->YPos = attrib[0] & 0xFF;
+            spr->Width = width;
+            spr->Height = height;
+            spr->BoundWidth = boundwidth;
+            spr->BoundHeight = boundheight;
 
-                DrawSprite_Normal<false>(attrib, width, xpos, ypos);
-                nsprites++;
-            }
+            // sprites wrap around vertically
+            u32 first = spr->YPos;
+            u32 last = first + boundheight - 1;
+            for (u32 y = first & ~7; y <= last; y += 8)
+                bands[(y >> 3) & 0x1F][num >> 5] |= (1 << (num & 0x1F));
         }
     }
 
-    return nsprites;
+    SpritesDirty = false;
 }
 
-void GPU2D::DrawSpritesWindow(u32 line)
+u32 GPU2D::DrawSprites(u32 line)
 {
-    u16* oam = (u16*)&GPU::OAM[Num ? 0x400 : 0];
+    if (SpritesDirty) UpdateSprites();
 
-    const s32 spritewidth[16] =
-    {
-        8, 16, 8, 0,
-        16, 32, 8, 0,
-        32, 32, 16, 0,
-        64, 64, 32, 0
-    };
-    const s32 spriteheight[16] =
-    {
-        8, 8, 16, 0,
-        16, 8, 32, 0,
-        32, 16, 32, 0,
-        64, 32, 64, 0
-    };
+    u32 nsprites = 0;
+    u32* bands = SpriteBands[(line >> 3) & 0x1F];
 
-    for (int sprnum = 127; sprnum >= 0; sprnum--)
+    for (int i = 0; i < 4; i++)
     {
-        u16* attrib = &oam[sprnum*4];
-
-        if (((attrib[0] >> 10) & 0x3) != 2)
-            continue;
-
-        if (attrib[0] & 0x0100)
+        u32 mask = bands[i];
+        while (mask)
         {
-            u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-            s32 width = spritewidth[sizeparam];
-            s32 height = spriteheight[sizeparam];
-            s32 boundwidth = width;
-            s32 boundheight = height;
+            SpriteEntry* spr = &Sprites[(i << 5) + __builtin_ctz(mask)];
+            mask &= (mask - 1);
 
-            if (attrib[0] & 0x0200)
+            u32 ypos = (line - spr->YPos) & 0xFF;
+            if (ypos >= spr->BoundHeight)
+                continue;
+
+            if (spr->RotParams)
             {
-                boundwidth <<= 1;
-                boundheight <<= 1;
+                DrawSprite_Rotscale<false>(spr->Attrib, spr->RotParams, spr->BoundWidth, spr->BoundHeight, spr->Width, spr->Height, spr->XPos, ypos);
             }
+            else
+            {
+                // yflip
+                if (spr->Attrib[1] & 0x2000)
+                    ypos = spr->Height-1 - ypos;
 
-            u32 ypos = attrib[0] & 0xFF;
-            ypos = (line - ypos) & 0xFF;
-            if (ypos >= (u32)boundheight)
-                continue;
-
-            s32 xpos = (s32)(attrib[1] << 23) >> 23;
-            if (xpos <= -boundwidth)
-                continue;
+                DrawSprite_Normal<false>(spr->Attrib, spr->Width, spr->XPos, ypos);
+            }
+            nsprites++;
+        }
+    }
 
-            u32 rotparamgroup = (attrib[1] >> 9) & 0x1F;
+    return nsprites;
+}
 
-            DrawSprite_Rotscale<true>(attrib, &oam[(rotparamgroup*16) + 3], boundwidth, boundheight, width, height, xpos, ypos);
-        }
-        else
-        {
-            if (attrib[0] & 0x0200)
-                continue;
+void GPU2D::DrawSpritesWindow(u32 line)
+{
+    if (SpritesDirty) UpdateSprites();
 
-            u32 sizeparam = (attrib[0] >> 14) | ((attrib[1] & 0xC000) >> 12);
-            s32 width = spritewidth[sizeparam];
-            s32 height = spriteheight[sizeparam];
+    u32* bands = WinSpriteBands[(line >> 3) & 0x1F];
 
-            u32 ypos = attrib[0] & 0xFF;
-            ypos = (line - ypos) & 0xFF;
-            if (ypos >= (u32)height)
-                continue;
+    for (int i = 0; i < 4; i++)
+    {
+        u32 mask = bands[i];
+        while (mask)
+        {
+            SpriteEntry* spr = &WinSprites[(i << 5) + __builtin_ctz(mask)];
+            mask &= (mask - 1);
 
-            s32 xpos = (s32)(attrib[1] << 23) >> 23;
-            if (xpos <= -width)
+            u32 ypos = (line - spr->YPos) & 0xFF;
+            if (ypos >= spr->BoundHeight)
                 continue;
 
-            // yflip
-            if (attrib[1] & 0x2000)
-                ypos = height-1 - ypos;
+            if (spr->RotParams)
+            {
+                DrawSprite_Rotscale<true>(spr->Attrib, spr->RotParams, spr->BoundWidth, spr->BoundHeight, spr->Width, spr->Height, spr->XPos, ypos);
+            }
+            else
+            {
+                // yflip
+                if (spr->Attrib[1] & 0x2000)
+                    ypos = spr->Height-1 - ypos;
 
-            DrawSprite_Normal<true>(attrib, width, xpos, ypos);
+                DrawSprite_Normal<true>(spr->Attrib, spr->Width, spr->XPos, ypos);
+            }
         }
     }
 }
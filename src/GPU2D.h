@@ -52,6 +52,19 @@ public:
 
     void SampleFIFO(u32 offset, u32 num);
 
+    // display capture writes to VRAM, and FIFO display reads from the FIFO
+    // as it's being filled: scanlines using them can't be drawn on the 2D
+    // render thread
+    bool NeedsSyncDraw()
+    {
+        if (Num) return false;
+        if (CaptureCnt & (1<<31)) return true;
+        if (((DispCnt >> 16) & 0x3) == 3) return true;
+
+        return false;
+    }
+
+    void LatchScanline(u32 line);
     void DrawScanline(u32 line);
     void VBlank();
     void VBlankEnd();
@@ -60,6 +73,7 @@ public:
 
     void BGExtPalDirty(u32 base);
     void OBJExtPalDirty();
+    void OAMDirty() { SpritesDirty = true; }
 
     u16* GetBGExtPal(u32 slot, u32 pal);
     u16* GetOBJExtPal(u32 pal);
@@ -71,6 +85,10 @@ private:
 
     bool Accelerated;
 
+    // latched by LatchScanline() on the emulation thread
+    u32 LineVCount;
+    bool LineBlank;
+
     u32 BGOBJLine[256*3] __attribute__((aligned (8)));
     u32* _3DLine;
 
@@ -123,12 +141,37 @@ private:
     u32 BGExtPalStatus[4];
     u32 OBJExtPalStatus;
 
+    // sprites decoded from OAM, in drawing order. rebuilt when OAM changes.
+    struct SpriteEntry
+    {
+        u16* Attrib;
+        u16* RotParams; // NULL for non-rotscale sprites
+        s32 XPos;
+        u32 YPos;
+        u32 Width, Height;
+        u32 BoundWidth, BoundHeight;
+    };
+
+    SpriteEntry Sprites[128];
+    SpriteEntry WinSprites[128];
+
+    // for each band of 8 scanlines, bitmask of the sprites above that are on it
+    u32 SpriteBands[32][4];
+    u32 WinSpriteBands[32][4];
+
+    bool SpritesDirty;
+
     u32 ColorBlend4(u32 val1, u32 val2, u32 eva, u32 evb);
     u32 ColorBlend5(u32 val1, u32 val2);
     u32 ColorBrightnessUp(u32 val, u32 factor);
     u32 ColorBrightnessDown(u32 val, u32 factor);
     u32 ColorComposite(int i, u32 val1, u32 val2);
 
+    void ColorCompositeLine();
+    void ColorBrightnessUpLine(u32* dst, u32 factor);
+    void ColorBrightnessDownLine(u32* dst, u32 factor);
+    void ConvertLine(u32* dst);
+
     template<u32 bgmode> void DrawScanlineBGMode(u32 line, u32 nsprites);
     void DrawScanlineBGMode6(u32 line, u32 nsprites);
     void DrawScanline_BGOBJ(u32 line);
@@ -144,6 +187,7 @@ private:
     void DrawBG_Large(u32 line);
 
     void InterleaveSprites(u32 prio);
+    void UpdateSprites();
     u32 DrawSprites(u32 line);
     void DrawSpritesWindow(u32 line);
     template<bool window> void DrawSprite_Rotscale(u16* attrib, u16* rotparams, u32 boundwidth, u32 boundheight, u32 width, u32 height, s32 xpos, s32 ypos);
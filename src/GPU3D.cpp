@@ -23,6 +23,11 @@
 #include "GPU.h"
 #include "FIFO.h"
 #include "Config.h"
+#include "Profiler.h"
+
+#ifdef GPU3D_SIMD
+#include <immintrin.h>
+#endif
 
 
 // 3D engine notes
@@ -670,7 +675,7 @@ void MatrixLoad4x3(s32* m, s32* s)
     m[12] = s[9]; m[13] = s[10]; m[14] = s[11]; m[15] = 0x1000;
 }
 
-void MatrixMult4x4(s32* m, s32* s)
+void MatrixMult4x4_Scalar(s32* m, s32* s)
 {
     s32 tmp[16];
     memcpy(tmp, m, 16*4);
@@ -697,7 +702,7 @@ void MatrixMult4x4(s32* m, s32* s)
     m[15] = ((s64)s[12]*tmp[3] + (s64)s[13]*tmp[7] + (s64)s[14]*tmp[11] + (s64)s[15]*tmp[15]) >> 12;
 }
 
-void MatrixMult4x3(s32* m, s32* s)
+void MatrixMult4x3_Scalar(s32* m, s32* s)
 {
     s32 tmp[16];
     memcpy(tmp, m, 16*4);
@@ -724,7 +729,7 @@ void MatrixMult4x3(s32* m, s32* s)
     m[15] = ((s64)s[9]*tmp[3] + (s64)s[10]*tmp[7] + (s64)s[11]*tmp[11] + (s64)0x1000*tmp[15]) >> 12;
 }
 
-void MatrixMult3x3(s32* m, s32* s)
+void MatrixMult3x3_Scalar(s32* m, s32* s)
 {
     s32 tmp[12];
     memcpy(tmp, m, 12*4);
@@ -746,6 +751,204 @@ void MatrixMult3x3(s32* m, s32* s)
     m[11] = ((s64)s[6]*tmp[3] + (s64)s[7]*tmp[7] + (s64)s[8]*tmp[11]) >> 12;
 }
 
+void TransformVertex_Scalar(s32* out, s16* vertex, s32* m)
+{
+    s64 v[4] = {(s64)vertex[0], (s64)vertex[1], (s64)vertex[2], 0x1000};
+
+    out[0] = (v[0]*m[0] + v[1]*m[4] + v[2]*m[8] + v[3]*m[12]) >> 12;
+    out[1] = (v[0]*m[1] + v[1]*m[5] + v[2]*m[9] + v[3]*m[13]) >> 12;
+    out[2] = (v[0]*m[2] + v[1]*m[6] + v[2]*m[10] + v[3]*m[14]) >> 12;
+    out[3] = (v[0]*m[3] + v[1]*m[7] + v[2]*m[11] + v[3]*m[15]) >> 12;
+}
+
+void TransformNormal_Scalar(s32* out, s16* normal, s32* m)
+{
+    out[0] = (normal[0]*m[0] + normal[1]*m[4] + normal[2]*m[8]) >> 12;
+    out[1] = (normal[0]*m[1] + normal[1]*m[5] + normal[2]*m[9]) >> 12;
+    out[2] = (normal[0]*m[2] + normal[1]*m[6] + normal[2]*m[10]) >> 12;
+}
+
+void LightLevels_Scalar(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (!(mask & (1<<i)))
+            continue;
+
+        // overflow handling (for example, if the normal length is >1)
+        // according to some hardware tests
+        // * diffuse level is saturated to 255
+        // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
+        // TODO: check how it behaves when the computed shininess is >=0x200
+
+        s32 difflevel = (-(lightdir[i][0]*normal[0] +
+                         lightdir[i][1]*normal[1] +
+                         lightdir[i][2]*normal[2])) >> 10;
+        if (difflevel < 0) difflevel = 0;
+        else if (difflevel > 255) difflevel = 255;
+
+        s32 shinelevel = -(((lightdir[i][0]>>1)*normal[0] +
+                          (lightdir[i][1]>>1)*normal[1] +
+                          ((lightdir[i][2]-0x200)>>1)*normal[2]) >> 10);
+        if (shinelevel < 0) shinelevel = 0;
+        else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
+        shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
+        if (shinelevel < 0) shinelevel = 0;
+
+        diff[i] = difflevel;
+        shine[i] = shinelevel;
+    }
+}
+
+#ifdef GPU3D_SIMD
+
+// the products are 32x32->64-bit and summed on 64 bits, like in the plain
+// versions. only the low 32 bits of the shifted sums are kept, so shifting
+// them logically gives the same result as the arithmetic shift.
+
+// (sum of coef[j] * row j of m, for j < n) >> shift, for the four columns
+template<int shift>
+inline __m128i FixedRow(s32* coef, s32* m, int n)
+{
+#if defined(GPU3D_SIMD_AVX2) || defined(__AVX2__)
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int j = 0; j < n; j++)
+    {
+        __m256i row = _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i*)&m[j*4]));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epi32(_mm256_set1_epi32(coef[j]), row));
+    }
+
+    sum = _mm256_srli_epi64(sum, shift);
+    sum = _mm256_permutevar8x32_epi32(sum, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    return _mm256_castsi256_si128(sum);
+#else
+    // columns 0/2 and 1/3 go in separate 64-bit lanes
+    __m128i even = _mm_setzero_si128();
+    __m128i odd = _mm_setzero_si128();
+
+    for (int j = 0; j < n; j++)
+    {
+        __m128i c = _mm_set1_epi32(coef[j]);
+        __m128i row = _mm_loadu_si128((__m128i*)&m[j*4]);
+        even = _mm_add_epi64(even, _mm_mul_epi32(c, row));
+        odd = _mm_add_epi64(odd, _mm_mul_epi32(c, _mm_srli_epi64(row, 32)));
+    }
+
+    even = _mm_srli_epi64(even, shift);
+    odd = _mm_slli_epi64(_mm_srli_epi64(odd, shift), 32);
+    return _mm_blend_epi16(even, odd, 0xCC);
+#endif
+}
+
+void MatrixMult4x4_SIMD(s32* m, s32* s)
+{
+    s32 tmp[16];
+    memcpy(tmp, m, 16*4);
+
+    // m = s*m
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*)&m[i*4], FixedRow<12>(&s[i*4], tmp, 4));
+}
+
+void MatrixMult4x3_SIMD(s32* m, s32* s)
+{
+    s32 tmp[16];
+    memcpy(tmp, m, 16*4);
+
+    // m = s*m
+    for (int i = 0; i < 3; i++)
+        _mm_storeu_si128((__m128i*)&m[i*4], FixedRow<12>(&s[i*3], tmp, 3));
+
+    s32 last[4] = {s[9], s[10], s[11], 0x1000};
+    _mm_storeu_si128((__m128i*)&m[12], FixedRow<12>(last, tmp, 4));
+}
+
+void MatrixMult3x3_SIMD(s32* m, s32* s)
+{
+    s32 tmp[12];
+    memcpy(tmp, m, 12*4);
+
+    // m = s*m
+    for (int i = 0; i < 3; i++)
+        _mm_storeu_si128((__m128i*)&m[i*4], FixedRow<12>(&s[i*3], tmp, 3));
+}
+
+void TransformVertex_SIMD(s32* out, s16* vertex, s32* m)
+{
+    s32 v[4] = {vertex[0], vertex[1], vertex[2], 0x1000};
+    _mm_storeu_si128((__m128i*)out, FixedRow<12>(v, m, 4));
+}
+
+void TransformNormal_SIMD(s32* out, s16* normal, s32* m)
+{
+    // this one is done on 32 bits
+    __m128i sum = _mm_mullo_epi32(_mm_set1_epi32(normal[0]), _mm_loadu_si128((__m128i*)&m[0]));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(normal[1]), _mm_loadu_si128((__m128i*)&m[4])));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(normal[2]), _mm_loadu_si128((__m128i*)&m[8])));
+
+    s32 res[4];
+    _mm_storeu_si128((__m128i*)res, _mm_srai_epi32(sum, 12));
+    out[0] = res[0];
+    out[1] = res[1];
+    out[2] = res[2];
+}
+
+void LightLevels_SIMD(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask)
+{
+    // all four lights at once, see LightLevels_Scalar()
+    // disabled lights get computed too, their levels are just not used.
+    // only bail out if there are none to do
+    if (!(mask & 0xF))
+        return;
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i lx = _mm_setr_epi32(lightdir[0][0], lightdir[1][0], lightdir[2][0], lightdir[3][0]);
+    __m128i ly = _mm_setr_epi32(lightdir[0][1], lightdir[1][1], lightdir[2][1], lightdir[3][1]);
+    __m128i lz = _mm_setr_epi32(lightdir[0][2], lightdir[1][2], lightdir[2][2], lightdir[3][2]);
+    __m128i nx = _mm_set1_epi32(normal[0]);
+    __m128i ny = _mm_set1_epi32(normal[1]);
+    __m128i nz = _mm_set1_epi32(normal[2]);
+
+    __m128i d = _mm_mullo_epi32(lx, nx);
+    d = _mm_add_epi32(d, _mm_mullo_epi32(ly, ny));
+    d = _mm_add_epi32(d, _mm_mullo_epi32(lz, nz));
+    d = _mm_srai_epi32(_mm_sub_epi32(zero, d), 10);
+    d = _mm_min_epi32(_mm_max_epi32(d, zero), _mm_set1_epi32(255));
+
+    __m128i s = _mm_mullo_epi32(_mm_srai_epi32(lx, 1), nx);
+    s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_srai_epi32(ly, 1), ny));
+    s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_srai_epi32(_mm_sub_epi32(lz, _mm_set1_epi32(0x200)), 1), nz));
+    s = _mm_sub_epi32(zero, _mm_srai_epi32(s, 10));
+
+    __m128i over = _mm_cmpgt_epi32(s, _mm_set1_epi32(255));
+    __m128i mirror = _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(0x100), s), _mm_set1_epi32(0xFF));
+    s = _mm_blendv_epi8(_mm_max_epi32(s, zero), mirror, over);
+    s = _mm_sub_epi32(_mm_srai_epi32(_mm_mullo_epi32(s, s), 7), _mm_set1_epi32(0x100));
+    s = _mm_max_epi32(s, zero);
+
+    _mm_storeu_si128((__m128i*)diff, d);
+    _mm_storeu_si128((__m128i*)shine, s);
+}
+
+inline void MatrixMult4x4(s32* m, s32* s) { MatrixMult4x4_SIMD(m, s); }
+inline void MatrixMult4x3(s32* m, s32* s) { MatrixMult4x3_SIMD(m, s); }
+inline void MatrixMult3x3(s32* m, s32* s) { MatrixMult3x3_SIMD(m, s); }
+inline void TransformVertex(s32* out, s16* vertex, s32* m) { TransformVertex_SIMD(out, vertex, m); }
+inline void TransformNormal(s32* out, s16* normal, s32* m) { TransformNormal_SIMD(out, normal, m); }
+inline void LightLevels(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask) { LightLevels_SIMD(diff, shine, normal, lightdir, mask); }
+
+#else
+
+inline void MatrixMult4x4(s32* m, s32* s) { MatrixMult4x4_Scalar(m, s); }
+inline void MatrixMult4x3(s32* m, s32* s) { MatrixMult4x3_Scalar(m, s); }
+inline void MatrixMult3x3(s32* m, s32* s) { MatrixMult3x3_Scalar(m, s); }
+inline void TransformVertex(s32* out, s16* vertex, s32* m) { TransformVertex_Scalar(out, vertex, m); }
+inline void TransformNormal(s32* out, s16* normal, s32* m) { TransformNormal_Scalar(out, normal, m); }
+inline void LightLevels(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask) { LightLevels_Scalar(diff, shine, normal, lightdir, mask); }
+
+#endif // GPU3D_SIMD
+
 void MatrixScale(s32* m, s32* s)
 {
     m[0] = ((s64)s[0]*m[0]) >> 12;
@@ -1346,10 +1549,7 @@ void SubmitVertex()
     Vertex* vertextrans = &TempVertexBuffer[VertexNumInPoly];
 
     UpdateClipMatrix();
-    vertextrans->Position[0] = (vertex[0]*ClipMatrix[0] + vertex[1]*ClipMatrix[4] + vertex[2]*ClipMatrix[8] + vertex[3]*ClipMatrix[12]) >> 12;
-    vertextrans->Position[1] = (vertex[0]*ClipMatrix[1] + vertex[1]*ClipMatrix[5] + vertex[2]*ClipMatrix[9] + vertex[3]*ClipMatrix[13]) >> 12;
-    vertextrans->Position[2] = (vertex[0]*ClipMatrix[2] + vertex[1]*ClipMatrix[6] + vertex[2]*ClipMatrix[10] + vertex[3]*ClipMatrix[14]) >> 12;
-    vertextrans->Position[3] = (vertex[0]*ClipMatrix[3] + vertex[1]*ClipMatrix[7] + vertex[2]*ClipMatrix[11] + vertex[3]*ClipMatrix[15]) >> 12;
+    TransformVertex(vertextrans->Position, CurVertex, ClipMatrix);
 
     // this probably shouldn't be.
     // the way color is handled during clipping needs investigation. TODO
@@ -1447,9 +1647,10 @@ void CalculateLighting()
     }
 
     s32 normaltrans[3];
-    normaltrans[0] = (Normal[0]*VecMatrix[0] + Normal[1]*VecMatrix[4] + Normal[2]*VecMatrix[8]) >> 12;
-    normaltrans[1] = (Normal[0]*VecMatrix[1] + Normal[1]*VecMatrix[5] + Normal[2]*VecMatrix[9]) >> 12;
-    normaltrans[2] = (Normal[0]*VecMatrix[2] + Normal[1]*VecMatrix[6] + Normal[2]*VecMatrix[10]) >> 12;
+    TransformNormal(normaltrans, Normal, VecMatrix);
+
+    s32 difflevels[4], shinelevels[4];
+    LightLevels(difflevels, shinelevels, normaltrans, LightDirection, CurPolygonAttr);
 
     VertexColor[0] = MatEmission[0];
     VertexColor[1] = MatEmission[1];
@@ -1461,25 +1662,8 @@ void CalculateLighting()
         if (!(CurPolygonAttr & (1<<i)))
             continue;
 
-        // overflow handling (for example, if the normal length is >1)
-        // according to some hardware tests
-        // * diffuse level is saturated to 255
-        // * shininess level mirrors back to 0 and is ANDed with 0xFF, that before being squared
-        // TODO: check how it behaves when the computed shininess is >=0x200
-
-        s32 difflevel = (-(LightDirection[i][0]*normaltrans[0] +
-                         LightDirection[i][1]*normaltrans[1] +
-                         LightDirection[i][2]*normaltrans[2])) >> 10;
-        if (difflevel < 0) difflevel = 0;
-        else if (difflevel > 255) difflevel = 255;
-
-        s32 shinelevel = -(((LightDirection[i][0]>>1)*normaltrans[0] +
-                          (LightDirection[i][1]>>1)*normaltrans[1] +
-                          ((LightDirection[i][2]-0x200)>>1)*normaltrans[2]) >> 10);
-        if (shinelevel < 0) shinelevel = 0;
-        else if (shinelevel > 255) shinelevel = (0x100 - shinelevel) & 0xFF;
-        shinelevel = ((shinelevel * shinelevel) >> 7) - 0x100; // really (2*shinelevel*shinelevel)-1
-        if (shinelevel < 0) shinelevel = 0;
+        s32 difflevel = difflevels[i];
+        s32 shinelevel = shinelevels[i];
 
         if (UseShininessTable)
         {
@@ -1612,13 +1796,8 @@ void BoxTest(u32* params)
 
 void PosTest()
 {
-    s64 vertex[4] = {(s64)CurVertex[0], (s64)CurVertex[1], (s64)CurVertex[2], 0x1000};
-
     UpdateClipMatrix();
-    PosTestResult[0] = (vertex[0]*ClipMatrix[0] + vertex[1]*ClipMatrix[4] + vertex[2]*ClipMatrix[8] + vertex[3]*ClipMatrix[12]) >> 12;
-    PosTestResult[1] = (vertex[0]*ClipMatrix[1] + vertex[1]*ClipMatrix[5] + vertex[2]*ClipMatrix[9] + vertex[3]*ClipMatrix[13]) >> 12;
-    PosTestResult[2] = (vertex[0]*ClipMatrix[2] + vertex[1]*ClipMatrix[6] + vertex[2]*ClipMatrix[10] + vertex[3]*ClipMatrix[14]) >> 12;
-    PosTestResult[3] = (vertex[0]*ClipMatrix[3] + vertex[1]*ClipMatrix[7] + vertex[2]*ClipMatrix[11] + vertex[3]*ClipMatrix[15]) >> 12;
+    TransformVertex(PosTestResult, CurVertex, ClipMatrix);
 
     AddCycles(5);
 }
@@ -2466,8 +2645,16 @@ void VBlank()
 
 void VCount215()
 {
-    if (Renderer == 0) SoftRenderer::RenderFrame();
-    else               GLRenderer::RenderFrame();
+    if (Renderer == 0)
+    {
+        // the software renderer accounts for itself, as it may be threaded
+        SoftRenderer::RenderFrame();
+    }
+    else
+    {
+        PROFILE_SCOPE(Section_Render3D);
+        GLRenderer::RenderFrame();
+    }
 }
 
 u32* GetLine(int line)
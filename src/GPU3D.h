@@ -125,6 +125,33 @@ void Write8(u32 addr, u8 val);
 void Write16(u32 addr, u16 val);
 void Write32(u32 addr, u32 val);
 
+// fixed-point math of the geometry engine
+// vectorized versions of it are built for SSE4.1 or AVX2, as set by the
+// GEOMETRY_SIMD CMake option (or by targeting them for the whole build).
+// the plain versions are kept so melonDS-bench can check both against
+// each other.
+#if defined(GPU3D_SIMD_AVX2) || defined(__AVX2__)
+#define GPU3D_SIMD "AVX2"
+#elif defined(GPU3D_SIMD_SSE41) || defined(__SSE4_1__)
+#define GPU3D_SIMD "SSE4.1"
+#endif
+
+void MatrixMult4x4_Scalar(s32* m, s32* s);
+void MatrixMult4x3_Scalar(s32* m, s32* s);
+void MatrixMult3x3_Scalar(s32* m, s32* s);
+void TransformVertex_Scalar(s32* out, s16* vertex, s32* m);
+void TransformNormal_Scalar(s32* out, s16* normal, s32* m);
+void LightLevels_Scalar(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask);
+
+#ifdef GPU3D_SIMD
+void MatrixMult4x4_SIMD(s32* m, s32* s);
+void MatrixMult4x3_SIMD(s32* m, s32* s);
+void MatrixMult3x3_SIMD(s32* m, s32* s);
+void TransformVertex_SIMD(s32* out, s16* vertex, s32* m);
+void TransformNormal_SIMD(s32* out, s16* normal, s32* m);
+void LightLevels_SIMD(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask);
+#endif
+
 namespace SoftRenderer
 {
 
@@ -107,6 +107,10 @@ u32 NumTriangles;
 GLuint TexMemID;
 GLuint TexPalMemID;
 
+// VRAM last uploaded to each texture and texture palette slot
+u8* TexMemSource[4];
+u8* TexPalMemSource[6];
+
 int ScaleFactor;
 bool Antialias;
 int ScreenW, ScreenH;
@@ -371,6 +375,9 @@ bool Init()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB5_A1, 1024, 48, 0, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, NULL);
 
+    memset(TexMemSource, 0, sizeof(TexMemSource));
+    memset(TexPalMemSource, 0, sizeof(TexPalMemSource));
+
     return true;
 }
 
@@ -902,6 +909,25 @@ void RenderSceneChunk(int y, int h)
 }
 
 
+void UploadVRAMPages(u32 dirty, int numpages, int y, int pagelines, GLenum format, GLenum type, u8* vram)
+{
+    // upload runs of consecutive dirty pages
+    for (int i = 0; i < numpages;)
+    {
+        if (!(dirty & (1U<<i)))
+        {
+            i++;
+            continue;
+        }
+
+        int start = i;
+        while (i < numpages && (dirty & (1U<<i))) i++;
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y + (start*pagelines), 1024, (i-start)*pagelines,
+                        format, type, &vram[start << 12]);
+    }
+}
+
 void RenderFrame()
 {
     CurShaderID = -1;
@@ -961,21 +987,36 @@ void RenderFrame()
     if (unibuf) memcpy(unibuf, &ShaderConfig, sizeof(ShaderConfig));
     glUnmapBuffer(GL_UNIFORM_BUFFER);
 
-    // SUCKY!!!!!!!!!!!!!!!!!!
-    // TODO: detect when VRAM blocks are modified!
+    // a slot is uploaded whole when a different bank gets mapped there
+    // otherwise, only the 4K pages that were written to since the last upload
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, TexMemID);
     for (int i = 0; i < 4; i++)
     {
         u32 mask = GPU::VRAMMap_Texture[i];
-        u8* vram;
+        int bank;
         if (!mask) continue;
-        else if (mask & (1<<0)) vram = GPU::VRAM_A;
-        else if (mask & (1<<1)) vram = GPU::VRAM_B;
-        else if (mask & (1<<2)) vram = GPU::VRAM_C;
-        else if (mask & (1<<3)) vram = GPU::VRAM_D;
+        else if (mask & (1<<0)) bank = 0;
+        else if (mask & (1<<1)) bank = 1;
+        else if (mask & (1<<2)) bank = 2;
+        else if (mask & (1<<3)) bank = 3;
+        else continue;
 
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, i*128, 1024, 128, GL_RED_INTEGER, GL_UNSIGNED_BYTE, vram);
+        u8* vram = GPU::VRAM[bank];
+        u32 dirty = GPU::VRAMDirtyPages[bank];
+        GPU::VRAMDirtyPages[bank] = 0;
+
+        if (TexMemSource[i] != vram)
+        {
+            for (int j = 0; j < 4; j++)
+                if (TexMemSource[j] == vram) TexMemSource[j] = NULL;
+
+            TexMemSource[i] = vram;
+            dirty = 0xFFFFFFFF;
+        }
+
+        // 1K per line, 4 lines per page
+        UploadVRAMPages(dirty, 32, i*128, 4, GL_RED_INTEGER, GL_UNSIGNED_BYTE, vram);
     }
 
     glActiveTexture(GL_TEXTURE1);
@@ -984,13 +1025,29 @@ void RenderFrame()
     {
         // 6 x 16K chunks
         u32 mask = GPU::VRAMMap_TexPal[i];
-        u8* vram;
+        int bank;
+        u32 offset = 0;
         if (!mask) continue;
-        else if (mask & (1<<4)) vram = &GPU::VRAM_E[(i&3)*0x4000];
-        else if (mask & (1<<5)) vram = GPU::VRAM_F;
-        else if (mask & (1<<6)) vram = GPU::VRAM_G;
+        else if (mask & (1<<4)) { bank = 4; offset = (i&3)*0x4000; }
+        else if (mask & (1<<5)) bank = 5;
+        else if (mask & (1<<6)) bank = 6;
+        else continue;
+
+        u8* vram = &GPU::VRAM[bank][offset];
+        u32 dirty = (GPU::VRAMDirtyPages[bank] >> (offset >> 12)) & 0xF;
+        GPU::VRAMDirtyPages[bank] &= ~(0xF << (offset >> 12));
+
+        if (TexPalMemSource[i] != vram)
+        {
+            for (int j = 0; j < 6; j++)
+                if (TexPalMemSource[j] == vram) TexPalMemSource[j] = NULL;
+
+            TexPalMemSource[i] = vram;
+            dirty = 0xF;
+        }
 
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, i*8, 1024, 8, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, vram);
+        // 2K per line, 2 lines per page
+        UploadVRAMPages(dirty, 4, i*8, 2, GL_RGBA, GL_UNSIGNED_SHORT_1_5_5_5_REV, vram);
     }
 
     glDisable(GL_SCISSOR_TEST);
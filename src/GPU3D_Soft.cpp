@@ -18,10 +18,12 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <thread>
 #include "NDS.h"
 #include "GPU.h"
 #include "Config.h"
 #include "Platform.h"
+#include "Profiler.h"
 
 
 namespace GPU3D
@@ -53,9 +55,6 @@ u32 AttrBuffer[BufferSize * 2];
 // bit22: translucent flag
 // bit24-29: polygon ID for opaque pixels
 
-u8 StencilBuffer[256*2];
-bool PrevIsShadowMask;
-
 bool Enabled;
 
 // threading
@@ -69,6 +68,14 @@ void* Sema_ScanlineCount;
 
 void RenderThreadFunc();
 
+void SetupBandThreads();
+void StopBandThreads();
+void ResetBands();
+
+void InitTexCache();
+void DeInitTexCache();
+void FlushTexCache();
+
 
 void StopRenderThread()
 {
@@ -79,6 +86,8 @@ void StopRenderThread()
         Platform::Thread_Wait(RenderThread);
         Platform::Thread_Free(RenderThread);
     }
+
+    StopBandThreads();
 }
 
 void SetupRenderThread()
@@ -94,6 +103,8 @@ void SetupRenderThread()
         if (RenderThreadRendering)
             Platform::Semaphore_Wait(Sema_RenderDone);
 
+        SetupBandThreads();
+
         Platform::Semaphore_Reset(Sema_RenderStart);
         Platform::Semaphore_Reset(Sema_ScanlineCount);
 
@@ -115,6 +126,10 @@ bool Init()
     RenderThreadRunning = false;
     RenderThreadRendering = false;
 
+    ResetBands();
+
+    InitTexCache();
+
     return true;
 }
 
@@ -125,6 +140,8 @@ void DeInit()
     Platform::Semaphore_Free(Sema_RenderStart);
     Platform::Semaphore_Free(Sema_RenderDone);
     Platform::Semaphore_Free(Sema_ScanlineCount);
+
+    DeInitTexCache();
 }
 
 void Reset()
@@ -133,7 +150,8 @@ void Reset()
     memset(DepthBuffer, 0, BufferSize * 2 * 4);
     memset(AttrBuffer, 0, BufferSize * 2 * 4);
 
-    PrevIsShadowMask = false;
+    ResetBands();
+    FlushTexCache();
 
     SetupRenderThread();
 }
@@ -538,56 +556,82 @@ typedef struct
     u32 CurVL, CurVR;
     u32 NextVL, NextVR;
 
+    u32* Texels;
+
 } RendererPolygon;
 
+// polygons to be drawn this frame, in order
+Polygon* PolygonData[2048];
+int NumPolygons;
+
 RendererPolygon PolygonList[2048];
 
+// polygons bucketed by their first scanline, in the order they're drawn in
+u16 PolygonsByYTop[2048];
+u16 YTopStart[192+1];
+
+// with threaded rendering, the frame can be split in horizontal bands which
+// are drawn in parallel. the render thread draws the first band itself, and
+// does the final pass of all scanlines, in order. the other bands get their
+// own threads.
+//
+// each band has its own edge state for the polygons, and its own list of the
+// polygons being drawn on the current scanline (active edge list).
+//
+// the shadow stencil buffer and the 'previous polygon was a shadow mask' flag
+// carry over from one scanline to the next. when a band needs them before it
+// has set them itself, it takes them from the previous band once that one is
+// done. the first band gets them from the end of the previous frame.
+
+const int MaxBands = 8;
 
-void TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha)
+typedef struct
 {
-    u32 vramaddr = (texparam & 0xFFFF) << 3;
+    s32 YStart, YEnd;
 
-    s32 width = 8 << ((texparam >> 20) & 0x7);
-    s32 height = 8 << ((texparam >> 23) & 0x7);
+    RendererPolygon* Polygons;
 
-    s >>= 4;
-    t >>= 4;
+    u16 ActivePolygons[2][2048];
+    int NumActivePolygons;
+    int CurActivePolygons;
 
-    // texture wrapping
-    // TODO: optimize this somehow
-    // testing shows that it's hardly worth optimizing, actually
+    u8 StencilBuffer[256*2];
+    bool PrevIsShadowMask;
+    u8 StencilKnown; // bit0-1: stencil buffer lines, bit2: PrevIsShadowMask
+    bool Carried;
 
-    if (texparam & (1<<16))
-    {
-        if (texparam & (1<<18))
-        {
-            if (s & width) s = (width-1) - (s & (width-1));
-            else           s = (s & (width-1));
-        }
-        else
-            s &= width-1;
-    }
-    else
-    {
-        if (s < 0) s = 0;
-        else if (s >= width) s = width-1;
-    }
+    void* Thread;
+    void* Sema_Start;
+    void* Sema_ScanlineDone;
+    void* Sema_Done;
 
-    if (texparam & (1<<17))
-    {
-        if (texparam & (1<<19))
-        {
-            if (t & height) t = (height-1) - (t & (height-1));
-            else            t = (t & (height-1));
-        }
-        else
-            t &= height-1;
-    }
-    else
-    {
-        if (t < 0) t = 0;
-        else if (t >= height) t = height-1;
-    }
+} RenderBand;
+
+RenderBand Bands[MaxBands];
+int NumBands;
+int NumBandThreads;
+bool BandThreadsRunning;
+
+void CarryStencil(RenderBand* band)
+{
+    // take what this band hasn't set by itself from the previous band
+    RenderBand* prev = band - 1;
+    Platform::Semaphore_Wait(prev->Sema_Done);
+
+    if (!(band->StencilKnown & 0x1)) memcpy(&band->StencilBuffer[0], &prev->StencilBuffer[0], 256);
+    if (!(band->StencilKnown & 0x2)) memcpy(&band->StencilBuffer[256], &prev->StencilBuffer[256], 256);
+    if (!(band->StencilKnown & 0x4)) band->PrevIsShadowMask = prev->PrevIsShadowMask;
+
+    band->StencilKnown = 0x7;
+    band->Carried = true;
+}
+
+
+void DecodeTexel(u32 texparam, u32 texpal, s32 s, s32 t, u16* color, u8* alpha)
+{
+    u32 vramaddr = (texparam & 0xFFFF) << 3;
+
+    s32 width = 8 << ((texparam >> 20) & 0x7);
 
     u8 alpha0;
     if (texparam & (1<<29)) alpha0 = 0;
@@ -769,6 +813,247 @@ void TextureLookup(u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha
     }
 }
 
+// decoded texture cache
+//
+// textures are decoded to 32-bit texels (bit0-15: color, bit16-20: alpha) the
+// first time a frame uses them, so drawing a pixel only takes wrapping the
+// texture coordinates and loading a texel. entries are keyed by the parts of
+// TEXIMAGE_PARAM that affect decoding (address, size, format, color 0 mode) and
+// by the palette address. they are kept across frames until the texture or
+// palette slots they were decoded from get remapped.
+//
+// the texel pool is flushed as a whole when it runs out of room.
+
+const u32 TexCacheMaxEntries = 1024;
+const u32 TexCacheHashSize = 1024;
+const u32 TexelPoolSize = 2*1024*1024;
+
+const u32 TexParamKeyMask = 0x3FF0FFFF;
+
+// bits per texel, and palette size in bytes, for each texture format
+const u32 TexelBits[8] = {0, 8, 2, 4, 8, 2, 8, 16};
+const u32 TexPalSize[8] = {0, 64, 8, 32, 512, 0x10004, 16, 0};
+
+typedef struct
+{
+    u32 TexParam, TexPal;
+    u8 TexSlots, PalSlots;
+    bool Valid;
+    s32 Next;
+    u32* Texels;
+
+} TexCacheEntry;
+
+TexCacheEntry TexCache[TexCacheMaxEntries];
+u32 TexCacheNumEntries;
+s32 TexCacheHash[TexCacheHashSize];
+
+u32* TexelPool;
+u32 TexelPoolUsed;
+
+u32 TexCacheGen_Texture[4];
+u32 TexCacheGen_TexPal[8];
+
+// decoded texture of each polygon in PolygonData
+// NULL if it isn't textured or didn't fit in the cache
+u32* PolygonTexels[2048];
+
+void InitTexCache()
+{
+    TexelPool = new u32[TexelPoolSize];
+    FlushTexCache();
+}
+
+void DeInitTexCache()
+{
+    delete[] TexelPool;
+}
+
+void FlushTexCache()
+{
+    TexCacheNumEntries = 0;
+    TexelPoolUsed = 0;
+
+    for (u32 i = 0; i < TexCacheHashSize; i++)
+        TexCacheHash[i] = -1;
+}
+
+void CheckTexCache()
+{
+    // drop the textures whose slots were remapped since the last frame
+
+    u32 texdirty = 0, paldirty = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        u32 gen = GPU::VRAMGen_Texture[i];
+        if (gen != TexCacheGen_Texture[i]) texdirty |= (1<<i);
+        TexCacheGen_Texture[i] = gen;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        u32 gen = GPU::VRAMGen_TexPal[i];
+        if (gen != TexCacheGen_TexPal[i]) paldirty |= (1<<i);
+        TexCacheGen_TexPal[i] = gen;
+    }
+
+    if (!(texdirty | paldirty)) return;
+
+    for (u32 i = 0; i < TexCacheNumEntries; i++)
+    {
+        TexCacheEntry* entry = &TexCache[i];
+        if ((entry->TexSlots & texdirty) || (entry->PalSlots & paldirty))
+            entry->Valid = false;
+    }
+}
+
+u32 SlotMask(u32 addr, u32 len, u32 shift, u32 numslots)
+{
+    u32 first = addr >> shift;
+    u32 last = (addr + len - 1) >> shift;
+
+    if ((last - first) >= numslots)
+        return (1 << numslots) - 1;
+
+    u32 mask = 0;
+    for (u32 i = first; i <= last; i++)
+        mask |= (1 << (i & (numslots-1)));
+
+    return mask;
+}
+
+TexCacheEntry* GetTexture(u32 texparam, u32 texpal)
+{
+    u32 fmt = (texparam >> 26) & 0x7;
+
+    texparam &= TexParamKeyMask;
+    if (fmt == 7) texpal = 0;
+
+    u32 hash = (texparam ^ (texparam >> 16) ^ (texpal << 2)) & (TexCacheHashSize-1);
+
+    for (s32 i = TexCacheHash[hash]; i != -1; i = TexCache[i].Next)
+    {
+        TexCacheEntry* entry = &TexCache[i];
+        if (entry->Valid && entry->TexParam == texparam && entry->TexPal == texpal)
+            return entry;
+    }
+
+    u32 vramaddr = (texparam & 0xFFFF) << 3;
+    s32 width = 8 << ((texparam >> 20) & 0x7);
+    s32 height = 8 << ((texparam >> 23) & 0x7);
+    u32 numtexels = width * height;
+
+    if (TexCacheNumEntries >= TexCacheMaxEntries || (TexelPoolUsed + numtexels) > TexelPoolSize)
+        return NULL;
+
+    TexCacheEntry* entry = &TexCache[TexCacheNumEntries];
+    entry->Next = TexCacheHash[hash];
+    TexCacheHash[hash] = TexCacheNumEntries++;
+
+    entry->TexParam = texparam;
+    entry->TexPal = texpal;
+    entry->Valid = true;
+
+    entry->TexSlots = SlotMask(vramaddr, (numtexels * TexelBits[fmt]) >> 3, 17, 4);
+    if (fmt == 5) entry->TexSlots |= (1<<1); // palette indexes
+    entry->PalSlots = 0;
+    if (TexPalSize[fmt])
+        entry->PalSlots = SlotMask(texpal << ((fmt == 2) ? 3 : 4), TexPalSize[fmt], 14, 8);
+
+    entry->Texels = &TexelPool[TexelPoolUsed];
+    TexelPoolUsed += numtexels;
+
+    u32* texel = entry->Texels;
+    for (s32 t = 0; t < height; t++)
+    {
+        for (s32 s = 0; s < width; s++)
+        {
+            u16 color; u8 alpha;
+            DecodeTexel(texparam, texpal, s, t, &color, &alpha);
+            *texel++ = color | (alpha << 16);
+        }
+    }
+
+    return entry;
+}
+
+bool SetupTextures()
+{
+    bool ret = true;
+
+    for (int i = 0; i < NumPolygons; i++)
+    {
+        Polygon* polygon = PolygonData[i];
+        u32* texels = NULL;
+
+        if ((RenderDispCnt & (1<<0)) && (((polygon->TexParam >> 26) & 0x7) != 0))
+        {
+            TexCacheEntry* tex = GetTexture(polygon->TexParam, polygon->TexPalette);
+            if (tex) texels = tex->Texels;
+            else     ret = false;
+        }
+
+        PolygonTexels[i] = texels;
+    }
+
+    return ret;
+}
+
+void TextureLookup(u32* texels, u32 texparam, u32 texpal, s16 s, s16 t, u16* color, u8* alpha)
+{
+    s32 width = 8 << ((texparam >> 20) & 0x7);
+    s32 height = 8 << ((texparam >> 23) & 0x7);
+
+    s >>= 4;
+    t >>= 4;
+
+    // texture wrapping
+    // TODO: optimize this somehow
+    // testing shows that it's hardly worth optimizing, actually
+
+    if (texparam & (1<<16))
+    {
+        if (texparam & (1<<18))
+        {
+            if (s & width) s = (width-1) - (s & (width-1));
+            else           s = (s & (width-1));
+        }
+        else
+            s &= width-1;
+    }
+    else
+    {
+        if (s < 0) s = 0;
+        else if (s >= width) s = width-1;
+    }
+
+    if (texparam & (1<<17))
+    {
+        if (texparam & (1<<19))
+        {
+            if (t & height) t = (height-1) - (t & (height-1));
+            else            t = (t & (height-1));
+        }
+        else
+            t &= height-1;
+    }
+    else
+    {
+        if (t < 0) t = 0;
+        else if (t >= height) t = height-1;
+    }
+
+    if (texels)
+    {
+        u32 texel = texels[(t * width) + s];
+        *color = texel & 0xFFFF;
+        *alpha = texel >> 16;
+    }
+    else
+        DecodeTexel(texparam, texpal, s, t, color, alpha);
+}
+
 // depth test is 'less or equal' instead of 'less than' under the following conditions:
 // * when drawing a front-facing pixel over an opaque back-facing pixel
 // * when drawing wireframe edges, under certain conditions (TODO)
@@ -849,7 +1134,7 @@ u32 AlphaBlend(u32 srccolor, u32 dstcolor, u32 alpha)
     return srcR | (srcG << 8) | (srcB << 16) | (dstalpha << 24);
 }
 
-u32 RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
+u32 RenderPixel(Polygon* polygon, u32* texels, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
 {
     u8 r, g, b, a;
 
@@ -886,7 +1171,7 @@ u32 RenderPixel(Polygon* polygon, u8 vr, u8 vg, u8 vb, s16 s, s16 t)
         u8 tr, tg, tb;
 
         u16 tcolor; u8 talpha;
-        TextureLookup(polygon->TexParam, polygon->TexPalette, s, t, &tcolor, &talpha);
+        TextureLookup(texels, polygon->TexParam, polygon->TexPalette, s, t, &tcolor, &talpha);
 
         tr = (tcolor << 1) & 0x3E; if (tr) tr++;
         tg = (tcolor >> 4) & 0x3E; if (tg) tg++;
@@ -1050,7 +1335,7 @@ void SetupPolygonRightEdge(RendererPolygon* rp, s32 y)
                               polygon->FinalW[rp->CurVR], polygon->FinalW[rp->NextVR], y);
 }
 
-void SetupPolygon(RendererPolygon* rp, Polygon* polygon)
+void SetupPolygon(RendererPolygon* rp, Polygon* polygon, u32* texels)
 {
     u32 nverts = polygon->NumVertices;
 
@@ -1058,6 +1343,7 @@ void SetupPolygon(RendererPolygon* rp, Polygon* polygon)
     s32 ytop = polygon->YTop, ybot = polygon->YBottom;
 
     rp->PolyData = polygon;
+    rp->Texels = texels;
 
     rp->CurVL = vtop;
     rp->CurVR = vtop;
@@ -1103,7 +1389,7 @@ void SetupPolygon(RendererPolygon* rp, Polygon* polygon)
     }
 }
 
-void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
+void RenderShadowMaskScanline(RenderBand* band, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -1121,10 +1407,20 @@ void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    if (!PrevIsShadowMask)
-        memset(&StencilBuffer[256 * (y&0x1)], 0, 256);
+    u8* stencil = &band->StencilBuffer[256 * (y&0x1)];
 
-    PrevIsShadowMask = true;
+    if (!(band->StencilKnown & 0x4))
+        CarryStencil(band);
+
+    if (!band->PrevIsShadowMask)
+    {
+        memset(stencil, 0, 256);
+        band->StencilKnown |= (1 << (y&0x1));
+    }
+    else if (!(band->StencilKnown & (1 << (y&0x1))))
+        CarryStencil(band);
+
+    band->PrevIsShadowMask = true;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -1247,13 +1543,13 @@ void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
             continue;
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] |= 0x1;
+            stencil[x] |= 0x1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                stencil[x] |= 0x2;
         }
     }
 
@@ -1273,13 +1569,13 @@ void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
         u32 dstattr = AttrBuffer[pixeladdr];
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] = 1;
+            stencil[x] = 1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                stencil[x] |= 0x2;
         }
     }
 
@@ -1302,13 +1598,13 @@ void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
             continue;
 
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
-            StencilBuffer[256*(y&0x1) + x] = 1;
+            stencil[x] = 1;
 
         if (dstattr & 0x3)
         {
             pixeladdr += BufferSize;
             if (!fnDepthTest(DepthBuffer[pixeladdr], z, AttrBuffer[pixeladdr]))
-                StencilBuffer[256*(y&0x1) + x] |= 0x2;
+                stencil[x] |= 0x2;
         }
     }
 
@@ -1316,7 +1612,7 @@ void RenderShadowMaskScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void RenderPolygonScanline(RendererPolygon* rp, s32 y)
+void RenderPolygonScanline(RenderBand* band, RendererPolygon* rp, s32 y)
 {
     Polygon* polygon = rp->PolyData;
 
@@ -1334,7 +1630,11 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
     else
         fnDepthTest = DepthTest_LessThan;
 
-    PrevIsShadowMask = false;
+    if (polygon->IsShadow && !(band->StencilKnown & (1 << (y&0x1))))
+        CarryStencil(band);
+
+    band->PrevIsShadowMask = false;
+    band->StencilKnown |= 0x4;
 
     if (polygon->YTop != polygon->YBottom)
     {
@@ -1474,7 +1774,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = band->StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1491,7 +1791,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // against the pixel underneath
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
         {
-            if (!(dstattr & 0x3)) continue;
+            if (!(dstattr & 0x3) || pixeladdr >= BufferSize) continue;
 
             pixeladdr += BufferSize;
             dstattr = AttrBuffer[pixeladdr];
@@ -1506,7 +1806,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1570,7 +1870,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = band->StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1587,7 +1887,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // against the pixel underneath
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
         {
-            if (!(dstattr & 0x3)) continue;
+            if (!(dstattr & 0x3) || pixeladdr >= BufferSize) continue;
 
             pixeladdr += BufferSize;
             dstattr = AttrBuffer[pixeladdr];
@@ -1602,7 +1902,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1644,7 +1944,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // check stencil buffer for shadows
         if (polygon->IsShadow)
         {
-            u8 stencil = StencilBuffer[256*(y&0x1) + x];
+            u8 stencil = band->StencilBuffer[256*(y&0x1) + x];
             if (!stencil)
                 continue;
             if (!(stencil & 0x1))
@@ -1661,7 +1961,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         // against the pixel underneath
         if (!fnDepthTest(DepthBuffer[pixeladdr], z, dstattr))
         {
-            if (!(dstattr & 0x3)) continue;
+            if (!(dstattr & 0x3) || pixeladdr >= BufferSize) continue;
 
             pixeladdr += BufferSize;
             dstattr = AttrBuffer[pixeladdr];
@@ -1676,7 +1976,7 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
         s16 s = interpX.Interpolate(sl, sr);
         s16 t = interpX.Interpolate(tl, tr);
 
-        u32 color = RenderPixel(polygon, vr>>3, vg>>3, vb>>3, s, t);
+        u32 color = RenderPixel(polygon, rp->Texels, vr>>3, vg>>3, vb>>3, s, t);
         u8 alpha = color >> 24;
 
         // alpha test
@@ -1730,23 +2030,191 @@ void RenderPolygonScanline(RendererPolygon* rp, s32 y)
     rp->XR = rp->SlopeR.Step();
 }
 
-void RenderScanline(s32 y, int npolys)
+inline bool PolygonOnScanline(Polygon* polygon, s32 y)
 {
-    for (int i = 0; i < npolys; i++)
+    return y >= polygon->YTop && (y < polygon->YBottom || (y == polygon->YTop && polygon->YBottom == polygon->YTop));
+}
+
+void SetupActivePolygons()
+{
+    // counting sort by first scanline, which keeps the order within buckets
+
+    memset(YTopStart, 0, sizeof(YTopStart));
+
+    for (int i = 0; i < NumPolygons; i++)
     {
-        RendererPolygon* rp = &PolygonList[i];
-        Polygon* polygon = rp->PolyData;
+        s32 ytop = PolygonData[i]->YTop;
+        if (ytop > 191) continue;
+        if (ytop < 0) ytop = 0;
+        YTopStart[ytop+1]++;
+    }
+
+    for (int y = 0; y < 192; y++)
+        YTopStart[y+1] += YTopStart[y];
+
+    u16 pos[192];
+    memcpy(pos, YTopStart, sizeof(pos));
+
+    for (int i = 0; i < NumPolygons; i++)
+    {
+        s32 ytop = PolygonData[i]->YTop;
+        if (ytop > 191) continue;
+        if (ytop < 0) ytop = 0;
+        PolygonsByYTop[pos[ytop]++] = i;
+    }
+}
+
+void UpdateActivePolygons(RenderBand* band, s32 y)
+{
+    // merge the polygons starting on this scanline into the active list,
+    // dropping those that ended. once a polygon is out, it doesn't come back.
+
+    u16* oldlist = band->ActivePolygons[band->CurActivePolygons];
+    u16* newlist = band->ActivePolygons[band->CurActivePolygons ^ 1];
+    int numold = band->NumActivePolygons;
+    int num = 0;
+
+    u16* added = &PolygonsByYTop[YTopStart[y]];
+    int numadded = YTopStart[y+1] - YTopStart[y];
 
-        if (y >= polygon->YTop && (y < polygon->YBottom || (y == polygon->YTop && polygon->YBottom == polygon->YTop)))
+    int i = 0, j = 0;
+    while (i < numold || j < numadded)
+    {
+        if (j >= numadded || (i < numold && oldlist[i] < added[j]))
         {
-            if (polygon->IsShadowMask)
-                RenderShadowMaskScanline(rp, y);
-            else
-                RenderPolygonScanline(rp, y);
+            u16 id = oldlist[i++];
+            if (PolygonOnScanline(PolygonData[id], y))
+                newlist[num++] = id;
+        }
+        else
+        {
+            u16 id = added[j++];
+            if (PolygonOnScanline(PolygonData[id], y))
+            {
+                SetupPolygon(&band->Polygons[id], PolygonData[id], PolygonTexels[id]);
+                newlist[num++] = id;
+            }
+        }
+    }
+
+    band->NumActivePolygons = num;
+    band->CurActivePolygons ^= 1;
+}
+
+void RenderScanline(RenderBand* band, s32 y)
+{
+    UpdateActivePolygons(band, y);
+
+    u16* list = band->ActivePolygons[band->CurActivePolygons];
+    for (int i = 0; i < band->NumActivePolygons; i++)
+    {
+        RendererPolygon* rp = &band->Polygons[list[i]];
+
+        if (rp->PolyData->IsShadowMask)
+            RenderShadowMaskScanline(band, rp, y);
+        else
+            RenderPolygonScanline(band, rp, y);
+    }
+}
+
+void SplitBands()
+{
+    // give each band about the same amount of polygon scanlines to draw
+
+    s32 cost[192+1];
+    memset(cost, 0, sizeof(cost));
+
+    for (int i = 0; i < NumPolygons; i++)
+    {
+        s32 ytop = PolygonData[i]->YTop;
+        s32 ybot = PolygonData[i]->YBottom;
+        if (ytop < 0) ytop = 0;
+        if (ytop > 191) continue;
+        if (ybot <= ytop) ybot = ytop + 1;
+        if (ybot > 192) ybot = 192;
+
+        cost[ytop]++;
+        cost[ybot]--;
+    }
+
+    u32 total = 0;
+    s32 active = 0;
+    for (int y = 0; y < 192; y++)
+    {
+        active += cost[y];
+        cost[y] = active + 1;
+        total += cost[y];
+    }
+
+    s32 y = 0;
+    u32 acc = 0;
+    for (int b = 0; b < NumBands-1; b++)
+    {
+        u32 target = (u32)(((u64)total * (b+1)) / NumBands);
+
+        // leave at least one scanline for each of the next bands
+        s32 ymax = 192 - (NumBands-1-b);
+
+        Bands[b].YStart = y;
+        do
+        {
+            acc += cost[y++];
         }
+        while (acc < target && y < ymax);
+        Bands[b].YEnd = y;
+    }
+
+    Bands[NumBands-1].YStart = y;
+    Bands[NumBands-1].YEnd = 192;
+}
+
+void SetupBand(RenderBand* band)
+{
+    // set up the polygons that started above this band, at its first scanline
+
+    s32 ystart = band->YStart;
+    u16* list = band->ActivePolygons[0];
+    int num = 0;
+
+    for (int i = 0; i < NumPolygons; i++)
+    {
+        Polygon* polygon = PolygonData[i];
+        if (polygon->YTop >= ystart || polygon->YBottom <= ystart) continue;
+
+        RendererPolygon* rp = &band->Polygons[i];
+        SetupPolygon(rp, polygon, PolygonTexels[i]);
+        SetupPolygonLeftEdge(rp, ystart);
+        SetupPolygonRightEdge(rp, ystart);
+
+        list[num++] = i;
+    }
+
+    band->NumActivePolygons = num;
+    band->CurActivePolygons = 0;
+
+    if (band != &Bands[0])
+    {
+        band->StencilKnown = 0;
+        band->Carried = false;
     }
 }
 
+void FinishBand(RenderBand* band)
+{
+    if (band != &Bands[0] && !band->Carried)
+        CarryStencil(band);
+
+    Platform::Semaphore_Post(band->Sema_Done);
+}
+
+void ResetBands()
+{
+    RenderBand* band = &Bands[0];
+
+    band->Polygons = PolygonList;
+    band->PrevIsShadowMask = false;
+    band->StencilKnown = 0x7;
+}
 
 u32 CalculateFogDensity(u32 pixeladdr)
 {
@@ -2047,18 +2515,48 @@ void ClearBuffers()
 
 void RenderPolygons(bool threaded, Polygon** polygons, int npolys)
 {
-    int j = 0;
+    NumPolygons = 0;
     for (int i = 0; i < npolys; i++)
     {
         if (polygons[i]->Degenerate) continue;
-        SetupPolygon(&PolygonList[j++], polygons[i]);
+        PolygonData[NumPolygons++] = polygons[i];
+    }
+
+    CheckTexCache();
+    if (!SetupTextures())
+    {
+        // out of room: start over with an empty cache
+        // the textures that still don't fit get decoded as they're drawn
+        FlushTexCache();
+        SetupTextures();
     }
 
-    RenderScanline(0, j);
+    SetupActivePolygons();
+
+    NumBands = threaded ? (NumBandThreads + 1) : 1;
+    SplitBands();
 
-    for (s32 y = 1; y < 192; y++)
+    for (int b = 1; b < NumBands; b++)
+        Platform::Semaphore_Post(Bands[b].Sema_Start);
+
+    SetupBand(&Bands[0]);
+
+    int b = 0;
+    for (s32 y = 0; y < 192; y++)
     {
-        RenderScanline(y, j);
+        if (y == Bands[b].YEnd)
+        {
+            if (b == 0) FinishBand(&Bands[0]);
+            b++;
+        }
+
+        if (b == 0)
+            RenderScanline(&Bands[0], y);
+        else
+            Platform::Semaphore_Wait(Bands[b].Sema_ScanlineDone);
+
+        if (y == 0) continue;
+
         ScanlineFinalPass(y-1);
 
         if (threaded)
@@ -2069,12 +2567,26 @@ void RenderPolygons(bool threaded, Polygon** polygons, int npolys)
 
     if (threaded)
         Platform::Semaphore_Post(Sema_ScanlineCount);
+
+    if (NumBands > 1)
+    {
+        // once the last band is done, all of them are
+        // keep its stencil state for the next frame
+        RenderBand* last = &Bands[NumBands-1];
+        Platform::Semaphore_Wait(last->Sema_Done);
+
+        memcpy(Bands[0].StencilBuffer, last->StencilBuffer, sizeof(last->StencilBuffer));
+        Bands[0].PrevIsShadowMask = last->PrevIsShadowMask;
+    }
 }
 
 void VCount144()
 {
     if (RenderThreadRunning)
+    {
+        PROFILE_SCOPE(Section_Render3DWait);
         Platform::Semaphore_Wait(Sema_RenderDone);
+    }
 }
 
 void RenderFrame()
@@ -2085,6 +2597,7 @@ void RenderFrame()
     }
     else
     {
+        PROFILE_SCOPE(Section_Render3D);
         ClearBuffers();
         RenderPolygons(false, &RenderPolygonRAM[0], RenderNumPolygons);
     }
@@ -2092,26 +2605,140 @@ void RenderFrame()
 
 void RenderThreadFunc()
 {
+    PROFILE_THREAD(1);
+
     for (;;)
     {
         Platform::Semaphore_Wait(Sema_RenderStart);
         if (!RenderThreadRunning) return;
 
         RenderThreadRendering = true;
-        ClearBuffers();
-        RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
+        {
+            PROFILE_SCOPE(Section_Render3D);
+            ClearBuffers();
+            RenderPolygons(true, &RenderPolygonRAM[0], RenderNumPolygons);
+        }
 
         Platform::Semaphore_Post(Sema_RenderDone);
         RenderThreadRendering = false;
     }
 }
 
+void RenderBandThread(int num)
+{
+    RenderBand* band = &Bands[num];
+
+    PROFILE_THREAD(2 + num);
+
+    for (;;)
+    {
+        Platform::Semaphore_Wait(band->Sema_Start);
+        if (!BandThreadsRunning) return;
+
+        PROFILE_SCOPE(Section_Render3D);
+
+        SetupBand(band);
+
+        for (s32 y = band->YStart; y < band->YEnd; y++)
+        {
+            RenderScanline(band, y);
+            Platform::Semaphore_Post(band->Sema_ScanlineDone);
+        }
+
+        FinishBand(band);
+    }
+}
+
+template<int num>
+void BandThreadFunc()
+{
+    RenderBandThread(num);
+}
+
+void (*BandThreadFuncs[MaxBands])() =
+{
+    NULL,
+    BandThreadFunc<1>, BandThreadFunc<2>, BandThreadFunc<3>,
+    BandThreadFunc<4>, BandThreadFunc<5>, BandThreadFunc<6>,
+    BandThreadFunc<7>
+};
+
+void StopBandThreads()
+{
+    if (!NumBandThreads) return;
+
+    BandThreadsRunning = false;
+
+    for (int i = 1; i <= NumBandThreads; i++)
+    {
+        RenderBand* band = &Bands[i];
+
+        Platform::Semaphore_Post(band->Sema_Start);
+        Platform::Thread_Wait(band->Thread);
+        Platform::Thread_Free(band->Thread);
+
+        Platform::Semaphore_Free(band->Sema_Start);
+        Platform::Semaphore_Free(band->Sema_ScanlineDone);
+        Platform::Semaphore_Free(band->Sema_Done);
+
+        delete[] band->Polygons;
+        band->Polygons = NULL;
+    }
+
+    Platform::Semaphore_Free(Bands[0].Sema_Done);
+
+    NumBandThreads = 0;
+}
+
+void SetupBandThreads()
+{
+    // the render thread draws one band, the other ones get their own thread
+    // 1 (the default) is a single band. 0 = one band per host thread,
+    // leaving one for the emulator, up to 4
+    int nbands = Config::Render3DThreads;
+    if (nbands < 1)
+    {
+        nbands = (int)std::thread::hardware_concurrency() - 1;
+        if (nbands > 4) nbands = 4;
+    }
+    if (nbands < 1) nbands = 1;
+    if (nbands > MaxBands) nbands = MaxBands;
+
+    if (nbands-1 == NumBandThreads) return;
+
+    StopBandThreads();
+
+    BandThreadsRunning = true;
+
+    // the first band is drawn by the render thread, but the second one
+    // needs to know when it's done
+    Bands[0].Sema_Done = Platform::Semaphore_Create();
+
+    for (int i = 1; i < nbands; i++)
+    {
+        RenderBand* band = &Bands[i];
+
+        band->Polygons = new RendererPolygon[2048];
+
+        band->Sema_Start = Platform::Semaphore_Create();
+        band->Sema_ScanlineDone = Platform::Semaphore_Create();
+        band->Sema_Done = Platform::Semaphore_Create();
+
+        band->Thread = Platform::Thread_Create(BandThreadFuncs[i]);
+    }
+
+    NumBandThreads = nbands-1;
+}
+
 u32* GetLine(int line)
 {
     if (RenderThreadRunning)
     {
         if (line < 192)
+        {
+            PROFILE_SCOPE(Section_Render3DWait);
             Platform::Semaphore_Wait(Sema_ScanlineCount);
+        }
     }
 
     return &ColorBuffer[(line * ScanlineWidth) + FirstPixelOffset];
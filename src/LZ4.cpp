@@ -0,0 +1,216 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <string.h>
+#include "LZ4.h"
+
+/*
+    LZ4 block format: a list of sequences
+
+    token: literal length (high nibble), match length minus 4 (low nibble)
+    a nibble of 15 is followed by extra length bytes, added until one isn't 255
+    literals
+    match offset, 16-bit little endian
+    (extra match length bytes)
+
+    the last sequence only has literals. the last 5 bytes are always
+    literals, and the last match starts at least 12 bytes before the end.
+*/
+
+namespace LZ4
+{
+
+const u32 kHashBits = 16;
+const u32 kMinMatch = 4;
+const u32 kLastLiterals = 5;
+const u32 kMatchFindLimit = 12;
+const u32 kMaxOffset = 65535;
+
+
+u32 CompressBound(u32 len)
+{
+    return len + (len / 255) + 16;
+}
+
+inline u32 Read32(const u8* ptr)
+{
+    u32 ret;
+    memcpy(&ret, ptr, 4);
+    return ret;
+}
+
+inline u32 Hash(u32 seq)
+{
+    return (seq * 2654435761U) >> (32 - kHashBits);
+}
+
+u8* WriteLength(u8* op, u32 len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (u8)len;
+    return op;
+}
+
+u32 Compress(const u8* src, u32 srclen, u8* dst)
+{
+    u8* op = dst;
+    u32 anchor = 0;
+
+    if (srclen > kMatchFindLimit)
+    {
+        u32* table = new u32[1 << kHashBits];
+        memset(table, 0xFF, (1 << kHashBits) * sizeof(u32));
+
+        u32 limit = srclen - kMatchFindLimit;
+        u32 matchlimit = srclen - kLastLiterals;
+        u32 ip = 0;
+
+        while (ip < limit)
+        {
+            u32 seq = Read32(&src[ip]);
+            u32 h = Hash(seq);
+            u32 ref = table[h];
+            table[h] = ip;
+
+            if (ref >= ip || (ip - ref) > kMaxOffset || Read32(&src[ref]) != seq)
+            {
+                // skip faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            u32 len = kMinMatch;
+            while ((ip + len) < matchlimit && src[ref + len] == src[ip + len])
+                len++;
+
+            u32 litlen = ip - anchor;
+            u8* token = op++;
+
+            if (litlen >= 15)
+            {
+                *token = 15 << 4;
+                op = WriteLength(op, litlen - 15);
+            }
+            else
+                *token = litlen << 4;
+
+            memcpy(op, &src[anchor], litlen);
+            op += litlen;
+
+            u32 offset = ip - ref;
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+
+            len -= kMinMatch;
+            if (len >= 15)
+            {
+                *token |= 15;
+                op = WriteLength(op, len - 15);
+            }
+            else
+                *token |= len;
+
+            ip += len + kMinMatch;
+            anchor = ip;
+        }
+
+        delete[] table;
+    }
+
+    u32 litlen = srclen - anchor;
+    if (litlen >= 15)
+    {
+        *op++ = 15 << 4;
+        op = WriteLength(op, litlen - 15);
+    }
+    else
+        *op++ = litlen << 4;
+
+    memcpy(op, &src[anchor], litlen);
+    op += litlen;
+
+    return (u32)(op - dst);
+}
+
+bool ReadLength(const u8* src, u32 srclen, u32* ip, u32* len)
+{
+    for (;;)
+    {
+        if (*ip >= srclen) return false;
+
+        u8 val = src[(*ip)++];
+        *len += val;
+        if (val != 255) return true;
+    }
+}
+
+bool Decompress(const u8* src, u32 srclen, u8* dst, u32 dstlen)
+{
+    u32 ip = 0;
+    u32 op = 0;
+
+    while (ip < srclen)
+    {
+        u8 token = src[ip++];
+
+        u32 litlen = token >> 4;
+        if (litlen == 15 && !ReadLength(src, srclen, &ip, &litlen))
+            return false;
+
+        if (litlen > (srclen - ip) || litlen > (dstlen - op))
+            return false;
+
+        memcpy(&dst[op], &src[ip], litlen);
+        ip += litlen;
+        op += litlen;
+
+        if (ip == srclen) break; // last sequence
+
+        if ((srclen - ip) < 2) return false;
+        u32 offset = src[ip] | (src[ip+1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return false;
+
+        u32 len = token & 0xF;
+        if (len == 15 && !ReadLength(src, srclen, &ip, &len))
+            return false;
+        len += kMinMatch;
+
+        if (len > (dstlen - op)) return false;
+
+        u8* out = &dst[op];
+        const u8* match = out - offset;
+        if (offset >= len)
+            memcpy(out, match, len);
+        else
+        {
+            // overlapping copy, repeats the last offset bytes
+            for (u32 i = 0; i < len; i++)
+                out[i] = match[i];
+        }
+        op += len;
+    }
+
+    return op == dstlen;
+}
+
+}
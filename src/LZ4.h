@@ -0,0 +1,48 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "types.h"
+
+// LZ4 block format compression
+// compatible with the reference LZ4 block format, but only the fast greedy
+// compressor. meant for savestates: a lot of zeroes and repeated data.
+//
+// blocks are interchangeable with the reference library's
+// LZ4_compress_default()/LZ4_decompress_safe(), so this can be swapped for
+// upstream lz4.c without breaking existing compressed savestates.
+// the decoder bounds-checks everything and rejects malformed blocks.
+
+namespace LZ4
+{
+
+// maximum compressed size for len bytes of input
+u32 CompressBound(u32 len);
+
+// dst must be at least CompressBound(srclen) bytes
+// returns the compressed size
+u32 Compress(const u8* src, u32 srclen, u8* dst);
+
+// returns false if the data is corrupt or doesn't decompress to exactly dstlen bytes
+bool Decompress(const u8* src, u32 srclen, u8* dst, u32 dstlen);
+
+}
+
+#endif // LZ4_H
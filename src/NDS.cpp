@@ -21,6 +21,8 @@
 #include "Config.h"
 #include "NDS.h"
 #include "ARM.h"
+#include "ARMCache.h"
+#include "ARMJIT.h"
 #include "NDSCart.h"
 #include "DMA.h"
 #include "FIFO.h"
@@ -30,6 +32,9 @@
 #include "RTC.h"
 #include "Wifi.h"
 #include "Platform.h"
+#include "Profiler.h"
+#include "Rewind.h"
+#include "ROMList.h"
 
 
 namespace NDS
@@ -73,13 +78,22 @@ const s32 kMaxIterationCycles = 16;
 
 u32 ARM9ClockShift;
 
+bool IdleLoopSkip;
+bool IdleLoopExcluded;
+u64 IdleSkippedCycles[2];
+u32 IdleEpoch;
+
 // no need to worry about those overflowing, they can keep going for atleast 4350 years
 u64 ARM9Timestamp, ARM9Target;
 u64 ARM7Timestamp, ARM7Target;
 u64 SysTimestamp;
 
 SchedEvent SchedList[Event_MAX];
-u32 SchedListMask;
+
+// pending events, as a binary min-heap ordered by timestamp then event ID
+u32 SchedHeap[Event_MAX];
+u32 SchedHeapSize;
+s32 SchedHeapPos[Event_MAX]; // -1 if not scheduled
 
 u32 CPUStop;
 
@@ -97,6 +111,11 @@ u32 SWRAM_ARM7Mask;
 
 u8 ARM7WRAM[0x10000];
 
+u8* ARM9FastMem[kFastMemPages];
+u32 ARM9FastMemCode[kFastMemPages];
+u8* ARM7FastMem[kFastMemPages];
+u32 ARM7FastMemCode[kFastMemPages];
+
 u16 ExMemCnt[2];
 
 u8 ROMSeed0[2*8];
@@ -149,6 +168,8 @@ void SqrtDone(u32 param);
 void RunTimer(u32 tid, s32 cycles);
 void SetWifiWaitCnt(u16 val);
 void SetGBASlotTimings();
+void ResetFastMem();
+void MapFastMem(u8** map, u32* code, u32 start, u32 end, u8* mem, u32 mask, u32 codeaddr);
 
 
 bool Init()
@@ -168,12 +189,20 @@ bool Init()
     IPCFIFO9 = new FIFO<u32>(16);
     IPCFIFO7 = new FIFO<u32>(16);
 
+    if (!ARMCache::Init()) return false;
+    if (!ARMJIT::Init()) return false;
+    if (!ROMList::Init()) return false;
     if (!NDSCart::Init()) return false;
     if (!GPU::Init()) return false;
     if (!SPU::Init()) return false;
     if (!SPI::Init()) return false;
     if (!RTC::Init()) return false;
     if (!Wifi::Init()) return false;
+    if (!Rewind::Init()) return false;
+
+#ifdef ENABLE_PROFILER
+    Profiler::Init();
+#endif
 
     return true;
 }
@@ -189,12 +218,20 @@ void DeInit()
     delete IPCFIFO9;
     delete IPCFIFO7;
 
+    ARMCache::DeInit();
+    ARMJIT::DeInit();
+    ROMList::DeInit();
     NDSCart::DeInit();
     GPU::DeInit();
     SPU::DeInit();
     SPI::DeInit();
     RTC::DeInit();
     Wifi::DeInit();
+    Rewind::DeInit();
+
+#ifdef ENABLE_PROFILER
+    Profiler::DeInit();
+#endif
 }
 
 
@@ -428,12 +465,19 @@ void Reset()
     ARM7Timestamp = 0; ARM7Target = 0;
     SysTimestamp = 0;
 
+    IdleSkippedCycles[0] = 0;
+    IdleSkippedCycles[1] = 0;
+    IdleEpoch = 0;
+
     InitTimings();
 
     memset(MainRAM, 0, MAIN_RAM_SIZE);
     memset(SharedWRAM, 0, 0x8000);
     memset(ARM7WRAM, 0, 0x10000);
 
+    ARMCache::Reset();
+
+    ResetFastMem();
     MapSharedWRAM(0);
 
     ExMemCnt[0] = 0;
@@ -484,7 +528,8 @@ void Reset()
     memset(DMA9Fill, 0, 4*4);
 
     memset(SchedList, 0, sizeof(SchedList));
-    SchedListMask = 0;
+    SchedHeapSize = 0;
+    for (i = 0; i < Event_MAX; i++) SchedHeapPos[i] = -1;
 
     KeyInput = 0x007F03FF;
     KeyCnt = 0;
@@ -496,6 +541,7 @@ void Reset()
     SPI::Reset();
     RTC::Reset();
     Wifi::Reset();
+    Rewind::Reset();
 }
 
 void Stop()
@@ -505,6 +551,71 @@ void Stop()
     Platform::StopEmu();
     GPU::Stop();
     SPU::Stop();
+    NDSCart::FlushSRAM();
+}
+
+bool SchedBefore(u32 a, u32 b)
+{
+    // ties are broken by event ID, so the order is always the same
+    if (SchedList[a].Timestamp != SchedList[b].Timestamp)
+        return SchedList[a].Timestamp < SchedList[b].Timestamp;
+    return a < b;
+}
+
+void SchedSet(u32 pos, u32 id)
+{
+    SchedHeap[pos] = id;
+    SchedHeapPos[id] = pos;
+}
+
+void SchedSiftUp(u32 pos)
+{
+    u32 id = SchedHeap[pos];
+    while (pos > 0)
+    {
+        u32 parent = (pos - 1) >> 1;
+        if (!SchedBefore(id, SchedHeap[parent])) break;
+        SchedSet(pos, SchedHeap[parent]);
+        pos = parent;
+    }
+    SchedSet(pos, id);
+}
+
+void SchedSiftDown(u32 pos)
+{
+    u32 id = SchedHeap[pos];
+    for (;;)
+    {
+        u32 child = pos*2 + 1;
+        if (child >= SchedHeapSize) break;
+        if (child+1 < SchedHeapSize && SchedBefore(SchedHeap[child+1], SchedHeap[child])) child++;
+        if (!SchedBefore(SchedHeap[child], id)) break;
+        SchedSet(pos, SchedHeap[child]);
+        pos = child;
+    }
+    SchedSet(pos, id);
+}
+
+void SchedInsert(u32 id)
+{
+    SchedSet(SchedHeapSize, id);
+    SchedSiftUp(SchedHeapSize++);
+}
+
+void SchedRemove(u32 id)
+{
+    s32 pos = SchedHeapPos[id];
+    if (pos == -1) return;
+
+    SchedHeapPos[id] = -1;
+    SchedHeapSize--;
+    if ((u32)pos == SchedHeapSize) return;
+
+    // move the last one in the freed slot, and put it back in order
+    u32 moved = SchedHeap[SchedHeapSize];
+    SchedSet(pos, moved);
+    SchedSiftUp(pos);
+    SchedSiftDown(SchedHeapPos[moved]);
 }
 
 bool DoSavestate_Scheduler(Savestate* file)
@@ -651,7 +762,25 @@ bool DoSavestate(Savestate* file)
     file->VarArray(DMA9Fill, 4*sizeof(u32));
 
     if (!DoSavestate_Scheduler(file)) return false;
-    file->Var32(&SchedListMask);
+
+    // kept as a bitmask for compatibility with older savestates
+    // (going past 32 events will need a new savestate version)
+    u32 schedmask = 0;
+    if (file->Saving)
+    {
+        for (int i = 0; i < Event_MAX; i++)
+            if (SchedHeapPos[i] != -1) schedmask |= (1<<i);
+    }
+    file->Var32(&schedmask);
+    if (!file->Saving)
+    {
+        SchedHeapSize = 0;
+        for (int i = 0; i < Event_MAX; i++)
+        {
+            SchedHeapPos[i] = -1;
+            if (schedmask & (1<<i)) SchedInsert(i);
+        }
+    }
     file->Var64(&ARM9Timestamp);
     file->Var64(&ARM9Target);
     file->Var64(&ARM7Timestamp);
@@ -680,6 +809,8 @@ bool DoSavestate(Savestate* file)
 
     if (!file->Saving)
     {
+        IdleEpoch++;
+
         InitTimings();
         SetGBASlotTimings();
 
@@ -701,15 +832,44 @@ bool DoSavestate(Savestate* file)
     if (!file->Saving)
     {
         GPU::SetPowerCnt(PowerControl9);
+
+        // memory was replaced wholesale, cached code is stale
+        ARMCache::Reset();
     }
 
     return true;
 }
 
+void CheckIdleLoopExclude()
+{
+    // IdleLoopExclude is a list of game codes (ie. ABCD,EFGH) for which
+    // idle loops shouldn't be skipped
+    char code[5];
+    memcpy(code, &NDSCart::CartROM[0x0C], 4);
+    code[4] = '\0';
+
+    IdleLoopExcluded = false;
+    const char* list = Config::IdleLoopExclude;
+    while (*list)
+    {
+        u32 len = strcspn(list, ", ");
+        if (len == 4 && !strncmp(list, code, 4))
+        {
+            printf("idle loop skipping disabled for %s\n", code);
+            IdleLoopExcluded = true;
+            break;
+        }
+
+        list += len;
+        if (*list) list++;
+    }
+}
+
 bool LoadROM(const char* path, const char* sram, bool direct)
 {
     if (NDSCart::LoadROM(path, sram, direct))
     {
+        CheckIdleLoopExclude();
         Running = true;
         return true;
     }
@@ -723,6 +883,7 @@ bool LoadROM(const char* path, const char* sram, bool direct)
 void LoadBIOS()
 {
     Reset();
+    IdleLoopExcluded = false;
     Running = true;
 }
 
@@ -738,18 +899,8 @@ u64 NextTarget()
 {
     u64 ret = SysTimestamp + kMaxIterationCycles;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
-    {
-        if (!mask) break;
-        if (mask & 0x1)
-        {
-            if (SchedList[i].Timestamp < ret)
-                ret = SchedList[i].Timestamp;
-        }
-
-        mask >>= 1;
-    }
+    if (SchedHeapSize && SchedList[SchedHeap[0]].Timestamp < ret)
+        ret = SchedList[SchedHeap[0]].Timestamp;
 
     return ret;
 }
@@ -758,20 +909,45 @@ void RunSystem(u64 timestamp)
 {
     SysTimestamp = timestamp;
 
-    u32 mask = SchedListMask;
-    for (int i = 0; i < Event_MAX; i++)
+    // gather the events that are due, without unscheduling them yet
+    u32 due[Event_MAX];
+    u32 numdue = 0;
+    u32 stack[Event_MAX];
+    u32 sp = 0;
+    if (SchedHeapSize) stack[sp++] = 0;
+    while (sp)
     {
-        if (!mask) break;
-        if (mask & 0x1)
+        u32 pos = stack[--sp];
+        if (SchedList[SchedHeap[pos]].Timestamp > SysTimestamp) continue;
+
+        due[numdue++] = SchedHeap[pos];
+        if (pos*2+1 < SchedHeapSize) stack[sp++] = pos*2+1;
+        if (pos*2+2 < SchedHeapSize) stack[sp++] = pos*2+2;
+    }
+
+    // and run them in ID order
+    for (u32 i = 1; i < numdue; i++)
+    {
+        u32 id = due[i];
+        u32 j = i;
+        for (; j > 0 && due[j-1] > id; j--) due[j] = due[j-1];
+        due[j] = id;
+    }
+
+    if (numdue) IdleEpoch++;
+
+    for (u32 i = 0; i < numdue; i++)
+    {
+        u32 id = due[i];
+
+        // an earlier event may have rescheduled this one
+        if (SchedList[id].Timestamp <= SysTimestamp)
         {
-            if (SchedList[i].Timestamp <= SysTimestamp)
-            {
-                SchedListMask &= ~(1<<i);
-                SchedList[i].Func(SchedList[i].Param);
-            }
-        }
+            SchedRemove(id);
 
-        mask >>= 1;
+            PROFILE_EVENT(id);
+            SchedList[id].Func(SchedList[id].Param);
+        }
     }
 }
 
@@ -782,8 +958,17 @@ u32 RunFrame()
     if (!Running) return 263; // dorp
     if (CPUStop & 0x40000000) return 263;
 
+    PROFILE_BEGIN_FRAME();
+
     GPU::StartFrame();
 
+    // input may have changed
+    IdleEpoch++;
+
+    bool cached = Config::CPUBackend != 0;
+    ARMJIT::Enabled = Config::CPUBackend == 2;
+    IdleLoopSkip = Config::IdleLoopSkip && !IdleLoopExcluded;
+
     while (Running && GPU::TotalScanlines==0)
     {
         // TODO: give it some margin, so it can directly do 17 cycles instead of 16 then 1
@@ -800,18 +985,31 @@ u32 RunFrame()
         }
         else if (CPUStop & 0x0FFF)
         {
+            PROFILE_SCOPE(Section_DMA9);
             DMAs[0]->Run();
             if (!(CPUStop & 0x80000000)) DMAs[1]->Run();
             if (!(CPUStop & 0x80000000)) DMAs[2]->Run();
             if (!(CPUStop & 0x80000000)) DMAs[3]->Run();
         }
+        else if (cached)
+        {
+            PROFILE_SCOPE(Section_ARM9);
+            ARM9->ExecuteCached();
+        }
         else
         {
+            PROFILE_SCOPE(Section_ARM9);
             ARM9->Execute();
         }
 
-        RunTimers(0);
-        GPU3D::Run();
+        {
+            PROFILE_SCOPE(Section_Timers);
+            RunTimers(0);
+        }
+        {
+            PROFILE_SCOPE(Section_GPU3D);
+            GPU3D::Run();
+        }
 
         target = ARM9Timestamp >> ARM9ClockShift;
         CurCPU = 1;
@@ -822,16 +1020,24 @@ u32 RunFrame()
 
             if (CPUStop & 0x0FFF0000)
             {
+                PROFILE_SCOPE(Section_DMA7);
                 DMAs[4]->Run();
                 DMAs[5]->Run();
                 DMAs[6]->Run();
                 DMAs[7]->Run();
             }
+            else if (cached)
+            {
+                PROFILE_SCOPE(Section_ARM7);
+                ARM7->ExecuteCached();
+            }
             else
             {
+                PROFILE_SCOPE(Section_ARM7);
                 ARM7->Execute();
             }
 
+            PROFILE_SCOPE(Section_Timers);
             RunTimers(1);
         }
 
@@ -854,8 +1060,15 @@ u32 RunFrame()
            GPU3D::Timestamp-SysTimestamp);
 #endif
 
+    // make sure this frame's audio is out
+    SPU::Sync();
+
+    NDSCart::EndFrame();
+
     NumFrames++;
 
+    PROFILE_END_FRAME();
+
     return GPU::TotalScanlines;
 }
 
@@ -875,7 +1088,7 @@ void Reschedule(u64 target)
 
 void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 param)
 {
-    if (SchedListMask & (1<<id))
+    if (SchedHeapPos[id] != -1)
     {
         printf("!! EVENT %d ALREADY SCHEDULED\n", id);
         return;
@@ -896,14 +1109,14 @@ void ScheduleEvent(u32 id, bool periodic, s32 delay, void (*func)(u32), u32 para
     evt->Func = func;
     evt->Param = param;
 
-    SchedListMask |= (1<<id);
+    SchedInsert(id);
 
     Reschedule(evt->Timestamp);
 }
 
 void CancelEvent(u32 id)
 {
-    SchedListMask &= ~(1<<id);
+    SchedRemove(id);
 }
 
 
@@ -998,6 +1211,100 @@ void MapSharedWRAM(u8 val)
         SWRAM_ARM7Mask = 0x7FFF;
         break;
     }
+
+    ARMCache::UpdateMapping();
+
+    if (SWRAM_ARM9)
+        MapFastMem(ARM9FastMem, ARM9FastMemCode, 0x03000000, 0x04000000, SWRAM_ARM9, SWRAM_ARM9Mask,
+                   ARMCache::kCode_SharedWRAM + (SWRAM_ARM9 - SharedWRAM));
+    else
+        MapFastMem(ARM9FastMem, ARM9FastMemCode, 0x03000000, 0x04000000, NULL, 0, 0);
+
+    if (SWRAM_ARM7)
+        MapFastMem(ARM7FastMem, ARM7FastMemCode, 0x03000000, 0x03800000, SWRAM_ARM7, SWRAM_ARM7Mask,
+                   ARMCache::kCode_SharedWRAM + (SWRAM_ARM7 - SharedWRAM));
+    else
+        MapFastMem(ARM7FastMem, ARM7FastMemCode, 0x03000000, 0x03800000, ARM7WRAM, 0xFFFF,
+                   ARMCache::kCode_ARM7WRAM);
+}
+
+void MapFastMem(u8** map, u32* code, u32 start, u32 end, u8* mem, u32 mask, u32 codeaddr)
+{
+    for (u32 addr = start; addr < end; addr += (1 << kFastMemShift))
+    {
+        u32 page = addr >> kFastMemShift;
+
+        if (!mem)
+        {
+            map[page] = NULL;
+            continue;
+        }
+
+        map[page] = &mem[addr & mask];
+        code[page] = codeaddr + (addr & mask);
+    }
+}
+
+void ResetFastMem()
+{
+    memset(ARM9FastMem, 0, sizeof(ARM9FastMem));
+    memset(ARM7FastMem, 0, sizeof(ARM7FastMem));
+
+    MapFastMem(ARM9FastMem, ARM9FastMemCode, 0x02000000, 0x03000000, MainRAM, MAIN_RAM_SIZE - 1,
+               ARMCache::kCode_MainRAM);
+    MapFastMem(ARM7FastMem, ARM7FastMemCode, 0x02000000, 0x03000000, MainRAM, MAIN_RAM_SIZE - 1,
+               ARMCache::kCode_MainRAM);
+    MapFastMem(ARM7FastMem, ARM7FastMemCode, 0x03800000, 0x04000000, ARM7WRAM, 0xFFFF,
+               ARMCache::kCode_ARM7WRAM);
+}
+
+void UpdateFastMemVRAM()
+{
+    for (u32 addr = 0x06000000; addr < 0x07000000; addr += (1 << kFastMemShift))
+    {
+        u32 page = addr >> kFastMemShift;
+
+        int bank;
+
+        ARM9FastMem[page] = GPU::GetVRAMPage_ARM9(addr, &bank);
+        if (ARM9FastMem[page])
+            ARM9FastMemCode[page] = kFastMemVRAM | (bank << 20) | (ARM9FastMem[page] - GPU::VRAM[bank]);
+
+        ARM7FastMem[page] = GPU::GetVRAMPage_ARM7(addr, &bank);
+        if (ARM7FastMem[page])
+            ARM7FastMemCode[page] = kFastMemVRAM | (bank << 20) | (ARM7FastMem[page] - GPU::VRAM[bank]);
+    }
+}
+
+template<typename T>
+inline T* FastMemPtr(u8** map, u32 addr)
+{
+    if (addr & 0xF0000000) return NULL;
+
+    u8* page = map[addr >> kFastMemShift];
+    if (!page) return NULL;
+
+    return (T*)&page[addr & kFastMemMask];
+}
+
+template<typename T>
+inline bool FastMemWrite(u8** map, u32* code, u32 addr, T val)
+{
+    if (addr & 0xF0000000) return false;
+
+    u32 page = addr >> kFastMemShift;
+    if (!map[page]) return false;
+
+    u32 pagecode = code[page];
+    if (!(pagecode & kFastMemVRAM))
+        ARMCache::CheckWrite(pagecode + (addr & kFastMemMask));
+    else
+    {
+        GPU::Sync2D();
+        GPU::VRAMPageDirty((pagecode >> 20) & 0xF, (pagecode & 0xFFFFF) + (addr & kFastMemMask));
+    }
+    *(T*)&map[page][addr & kFastMemMask] = val;
+    return true;
 }
 
 
@@ -1047,6 +1354,7 @@ void SetGBASlotTimings()
 void SetIRQ(u32 cpu, u32 irq)
 {
     IF[cpu] |= (1 << irq);
+    IdleEpoch++;
 }
 
 void ClearIRQ(u32 cpu, u32 irq)
@@ -1297,6 +1605,44 @@ void RunTimers(u32 cpu)
 }
 
 
+bool IdleLoopSafeRead(u32 cpu, u32 addr)
+{
+    // within one CPU's time slice, the only thing that can change memory or
+    // these registers is the CPU itself. the other CPU and the DMAs run
+    // separately, and events only fire between slices.
+    // timers, GXSTAT and FIFO data registers are out, as reading them isn't
+    // free of side effects or depends on the current timestamp
+    switch (addr & 0xFF000000)
+    {
+    case 0x02000000:
+    case 0x03000000:
+        return true;
+
+    case 0x04000000:
+        switch (addr & ~0x3)
+        {
+        case 0x04000004: // DISPSTAT/VCOUNT
+        case 0x04000130: // KEYINPUT
+        case 0x04000180: // IPCSYNC
+        case 0x04000184: // IPCFIFOCNT
+        case 0x04000208: // IME
+        case 0x04000210: // IE
+        case 0x04000214: // IF
+            return true;
+
+        case 0x04000280: // DIVCNT
+        case 0x040002B0: // SQRTCNT
+            return cpu == 0;
+
+        case 0x04000134: // RCNT/EXTKEYIN
+            return cpu == 1;
+        }
+        return false;
+    }
+
+    return false;
+}
+
 
 bool DMAsInMode(u32 cpu, u32 mode)
 {
@@ -1550,6 +1896,9 @@ void debug(u32 param)
 
 u8 ARM9Read8(u32 addr)
 {
+    u8* fast = FastMemPtr<u8>(ARM9FastMem, addr);
+    if (fast) return *fast;
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u8*)&ARM9BIOS[addr & 0xFFF];
@@ -1611,6 +1960,9 @@ u8 ARM9Read8(u32 addr)
 
 u16 ARM9Read16(u32 addr)
 {
+    u16* fast = FastMemPtr<u16>(ARM9FastMem, addr);
+    if (fast) return *fast;
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u16*)&ARM9BIOS[addr & 0xFFF];
@@ -1672,6 +2024,9 @@ u16 ARM9Read16(u32 addr)
 
 u32 ARM9Read32(u32 addr)
 {
+    u32* fast = FastMemPtr<u32>(ARM9FastMem, addr);
+    if (fast) return *fast;
+
     if ((addr & 0xFFFFF000) == 0xFFFF0000)
     {
         return *(u32*)&ARM9BIOS[addr & 0xFFF];
@@ -1733,15 +2088,22 @@ u32 ARM9Read32(u32 addr)
 
 void ARM9Write8(u32 addr, u8 val)
 {
+    // (8-bit VRAM writes are ignored on the ARM9)
+    if ((addr & 0xFF000000) != 0x06000000 &&
+        FastMemWrite<u8>(ARM9FastMem, ARM9FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF000000)
     {
     case 0x02000000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u8*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
             *(u8*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
         }
         return;
@@ -1762,15 +2124,20 @@ void ARM9Write8(u32 addr, u8 val)
 
 void ARM9Write16(u32 addr, u16 val)
 {
+    if (FastMemWrite<u16>(ARM9FastMem, ARM9FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF000000)
     {
     case 0x02000000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u16*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
             *(u16*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
         }
         return;
@@ -1781,6 +2148,7 @@ void ARM9Write16(u32 addr, u16 val)
 
     case 0x05000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u16*)&GPU::Palette[addr & 0x7FF] = val;
         return;
 
@@ -1796,7 +2164,9 @@ void ARM9Write16(u32 addr, u16 val)
 
     case 0x07000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u16*)&GPU::OAM[addr & 0x7FF] = val;
+        GPU::OAMDirty(addr);
         return;
     }
 
@@ -1805,15 +2175,20 @@ void ARM9Write16(u32 addr, u16 val)
 
 void ARM9Write32(u32 addr, u32 val)
 {
+    if (FastMemWrite<u32>(ARM9FastMem, ARM9FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF000000)
     {
     case 0x02000000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u32*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return ;
 
     case 0x03000000:
         if (SWRAM_ARM9)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM9 - SharedWRAM) + (addr & SWRAM_ARM9Mask));
             *(u32*)&SWRAM_ARM9[addr & SWRAM_ARM9Mask] = val;
         }
         return;
@@ -1824,6 +2199,7 @@ void ARM9Write32(u32 addr, u32 val)
 
     case 0x05000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u32*)&GPU::Palette[addr & 0x7FF] = val;
         return;
 
@@ -1839,7 +2215,9 @@ void ARM9Write32(u32 addr, u32 val)
 
     case 0x07000000:
         if (!(PowerControl9 & ((addr & 0x400) ? (1<<9) : (1<<1)))) return;
+        GPU::Sync2D();
         *(u32*)&GPU::OAM[addr & 0x7FF] = val;
+        GPU::OAMDirty(addr);
         return;
     }
 
@@ -1880,6 +2258,9 @@ bool ARM9GetMemRegion(u32 addr, bool write, MemRegion* region)
 
 u8 ARM7Read8(u32 addr)
 {
+    u8* fast = FastMemPtr<u8>(ARM7FastMem, addr);
+    if (fast) return *fast;
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -1936,6 +2317,9 @@ u8 ARM7Read8(u32 addr)
 
 u16 ARM7Read16(u32 addr)
 {
+    u16* fast = FastMemPtr<u16>(ARM7FastMem, addr);
+    if (fast) return *fast;
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -1999,6 +2383,9 @@ u16 ARM7Read16(u32 addr)
 
 u32 ARM7Read32(u32 addr)
 {
+    u32* fast = FastMemPtr<u32>(ARM7FastMem, addr);
+    if (fast) return *fast;
+
     if (addr < 0x00004000)
     {
         if (ARM7->R[15] >= 0x4000)
@@ -2062,26 +2449,33 @@ u32 ARM7Read32(u32 addr)
 
 void ARM7Write8(u32 addr, u8 val)
 {
+    if (FastMemWrite<u8>(ARM7FastMem, ARM7FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF800000)
     {
     case 0x02000000:
     case 0x02800000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u8*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             *(u8*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
             return;
         }
         else
         {
+            ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
             *(u8*)&ARM7WRAM[addr & 0xFFFF] = val;
             return;
         }
 
     case 0x03800000:
+        ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
         *(u8*)&ARM7WRAM[addr & 0xFFFF] = val;
         return;
 
@@ -2100,26 +2494,33 @@ void ARM7Write8(u32 addr, u8 val)
 
 void ARM7Write16(u32 addr, u16 val)
 {
+    if (FastMemWrite<u16>(ARM7FastMem, ARM7FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF800000)
     {
     case 0x02000000:
     case 0x02800000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u16*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             *(u16*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
             return;
         }
         else
         {
+            ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
             *(u16*)&ARM7WRAM[addr & 0xFFFF] = val;
             return;
         }
 
     case 0x03800000:
+        ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
         *(u16*)&ARM7WRAM[addr & 0xFFFF] = val;
         return;
 
@@ -2146,26 +2547,33 @@ void ARM7Write16(u32 addr, u16 val)
 
 void ARM7Write32(u32 addr, u32 val)
 {
+    if (FastMemWrite<u32>(ARM7FastMem, ARM7FastMemCode, addr, val))
+        return;
+
     switch (addr & 0xFF800000)
     {
     case 0x02000000:
     case 0x02800000:
+        ARMCache::CheckWrite(ARMCache::kCode_MainRAM + (addr & (MAIN_RAM_SIZE - 1)));
         *(u32*)&MainRAM[addr & (MAIN_RAM_SIZE - 1)] = val;
         return;
 
     case 0x03000000:
         if (SWRAM_ARM7)
         {
+            ARMCache::CheckWrite(ARMCache::kCode_SharedWRAM + (SWRAM_ARM7 - SharedWRAM) + (addr & SWRAM_ARM7Mask));
             *(u32*)&SWRAM_ARM7[addr & SWRAM_ARM7Mask] = val;
             return;
         }
         else
         {
+            ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
             *(u32*)&ARM7WRAM[addr & 0xFFFF] = val;
             return;
         }
 
     case 0x03800000:
+        ARMCache::CheckWrite(ARMCache::kCode_ARM7WRAM + (addr & 0xFFFF));
         *(u32*)&ARM7WRAM[addr & 0xFFFF] = val;
         return;
 
@@ -2518,6 +2926,8 @@ u32 ARM9IORead32(u32 addr)
     case 0x04100000:
         if (IPCFIFOCnt9 & 0x8000)
         {
+            IdleEpoch++; // changes the FIFO state seen by the other CPU
+
             u32 ret;
             if (IPCFIFO7->IsEmpty())
             {
@@ -2560,6 +2970,8 @@ u32 ARM9IORead32(u32 addr)
 
 void ARM9IOWrite8(u32 addr, u8 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x0400006C:
@@ -2639,6 +3051,8 @@ void ARM9IOWrite8(u32 addr, u8 val)
 
 void ARM9IOWrite16(u32 addr, u16 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x04000004: GPU::SetDispStat(0, val); return;
@@ -2801,6 +3215,8 @@ void ARM9IOWrite16(u32 addr, u16 val)
 
 void ARM9IOWrite32(u32 addr, u32 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x04000060: GPU3D::Write32(addr, val); return;
@@ -3131,6 +3547,8 @@ u32 ARM7IORead32(u32 addr)
     case 0x04100000:
         if (IPCFIFOCnt7 & 0x8000)
         {
+            IdleEpoch++; // changes the FIFO state seen by the other CPU
+
             u32 ret;
             if (IPCFIFO9->IsEmpty())
             {
@@ -3165,6 +3583,8 @@ u32 ARM7IORead32(u32 addr)
 
 void ARM7IOWrite8(u32 addr, u8 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x04000132:
@@ -3239,6 +3659,8 @@ void ARM7IOWrite8(u32 addr, u8 val)
 
 void ARM7IOWrite16(u32 addr, u16 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x04000004: GPU::SetDispStat(1, val); return;
@@ -3364,6 +3786,8 @@ void ARM7IOWrite16(u32 addr, u16 val)
 
 void ARM7IOWrite32(u32 addr, u32 val)
 {
+    IdleEpoch++;
+
     switch (addr)
     {
     case 0x040000B0: DMAs[4]->SrcAddr = val; return;
@@ -105,6 +105,14 @@ extern u64 ARM9Timestamp, ARM9Target;
 extern u64 ARM7Timestamp, ARM7Target;
 extern u32 ARM9ClockShift;
 
+// idle loop skipping: whether it's enabled for the current game, and the
+// cycles skipped so far (in each CPU's own clock cycles)
+// IdleEpoch is bumped whenever something other than a CPU itself may have
+// changed what its idle loop reads (events, IO writes, IRQs, watched RAM)
+extern bool IdleLoopSkip;
+extern u64 IdleSkippedCycles[2];
+extern u32 IdleEpoch;
+
 // hax
 extern u32 IME[2];
 extern u32 IE[2];
@@ -124,6 +132,30 @@ extern u8 ARM7BIOS[0x4000];
 
 extern u8 MainRAM[MAIN_RAM_SIZE];
 
+extern u8 SharedWRAM[0x8000];
+extern u8* SWRAM_ARM9;
+extern u8* SWRAM_ARM7;
+extern u32 SWRAM_ARM9Mask;
+extern u32 SWRAM_ARM7Mask;
+
+extern u8 ARM7WRAM[0x10000];
+
+// software TLB for the CPU buses: direct pointers to plain memory (main RAM,
+// WRAM, VRAM with a single bank mapped) in 16K pages, covering the first
+// 256MB of the address space. NULL means the access goes through the regular
+// handlers. FastMemCode gives the code address of each page, for ARMCache
+// write checks. VRAM pages have kFastMemVRAM set instead, along with the bank
+// (bit20-23) and the offset within it, for dirty tracking
+const u32 kFastMemShift = 14;
+const u32 kFastMemMask = (1 << kFastMemShift) - 1;
+const u32 kFastMemPages = 0x10000000 >> kFastMemShift;
+const u32 kFastMemVRAM = 0x80000000;
+
+extern u8* ARM9FastMem[kFastMemPages];
+extern u32 ARM9FastMemCode[kFastMemPages];
+extern u8* ARM7FastMem[kFastMemPages];
+extern u32 ARM7FastMemCode[kFastMemPages];
+
 bool Init();
 void DeInit();
 void Reset();
@@ -160,6 +192,7 @@ void debug(u32 p);
 void Halt();
 
 void MapSharedWRAM(u8 val);
+void UpdateFastMemVRAM();
 
 void SetIRQ(u32 cpu, u32 irq);
 void ClearIRQ(u32 cpu, u32 irq);
@@ -180,6 +213,8 @@ void StopDMAs(u32 cpu, u32 mode);
 
 void RunTimers(u32 cpu);
 
+bool IdleLoopSafeRead(u32 cpu, u32 addr);
+
 u8 ARM9Read8(u32 addr);
 u16 ARM9Read16(u32 addr);
 u32 ARM9Read32(u32 addr);
@@ -22,8 +22,13 @@
 #include "NDSCart.h"
 #include "ARM.h"
 #include "CRC32.h"
+#include "ROMList.h"
 #include "Platform.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 
 namespace NDSCart_SRAM
 {
@@ -43,6 +48,16 @@ u8 Data;
 u8 StatusReg;
 u32 Addr;
 
+// the save file is only written to once the game hasn't written to save
+// memory for kFlushDelay frames, and only the 4K pages that changed
+const u32 kPageShift = 12;
+const u32 kFlushDelay = 60;
+
+u32* DirtyPages;
+u32 FlushTimer;
+
+void Flush();
+
 
 void Write_Null(u8 val, bool islast);
 void Write_EEPROMTiny(u8 val, bool islast);
@@ -54,18 +69,102 @@ void Write_Discover(u8 val, bool islast);
 bool Init()
 {
     SRAM = NULL;
+    SRAMLength = 0;
+    DirtyPages = NULL;
+    FlushTimer = 0;
     return true;
 }
 
 void DeInit()
 {
+    if (FlushTimer) Flush();
+
     if (SRAM) delete[] SRAM;
+    if (DirtyPages) delete[] DirtyPages;
 }
 
 void Reset()
 {
+    if (FlushTimer) Flush();
+
     if (SRAM) delete[] SRAM;
     SRAM = NULL;
+    SRAMLength = 0;
+}
+
+void InitDirtyPages()
+{
+    if (DirtyPages) delete[] DirtyPages;
+    DirtyPages = NULL;
+    FlushTimer = 0;
+
+    if (!SRAMLength) return;
+
+    u32 numpages = (SRAMLength + (1<<kPageShift) - 1) >> kPageShift;
+    DirtyPages = new u32[(numpages + 31) >> 5];
+    memset(DirtyPages, 0, ((numpages + 31) >> 5) * 4);
+}
+
+void SetAllDirty()
+{
+    if (!DirtyPages) return;
+
+    u32 numpages = (SRAMLength + (1<<kPageShift) - 1) >> kPageShift;
+    memset(DirtyPages, 0xFF, ((numpages + 31) >> 5) * 4);
+}
+
+inline void SetDirty(u32 addr)
+{
+    u32 page = (addr & (SRAMLength-1)) >> kPageShift;
+    DirtyPages[page >> 5] |= (1 << (page & 0x1F));
+}
+
+void Flush()
+{
+    FlushTimer = 0;
+    if (!SRAMLength) return;
+
+    FILE* f = Platform::OpenFile(SRAMPath, "r+b");
+    if (!f)
+    {
+        // new save file, write it whole
+        f = Platform::OpenFile(SRAMPath, "wb");
+        if (!f) return;
+        SetAllDirty();
+    }
+
+    u32 numpages = (SRAMLength + (1<<kPageShift) - 1) >> kPageShift;
+    u32 page = 0;
+    while (page < numpages)
+    {
+        if (!(DirtyPages[page >> 5] & (1 << (page & 0x1F))))
+        {
+            page++;
+            continue;
+        }
+
+        // write runs of dirty pages in one go
+        u32 start = page;
+        while (page < numpages && (DirtyPages[page >> 5] & (1 << (page & 0x1F))))
+            page++;
+
+        u32 offset = start << kPageShift;
+        u32 len = (page << kPageShift) - offset;
+        if (offset + len > SRAMLength) len = SRAMLength - offset;
+
+        fseek(f, offset, SEEK_SET);
+        fwrite(&SRAM[offset], len, 1, f);
+    }
+
+    fclose(f);
+
+    memset(DirtyPages, 0, ((numpages + 31) >> 5) * 4);
+}
+
+void EndFrame()
+{
+    if (FlushTimer && !--FlushTimer)
+        Flush();
 }
 
 void DoSavestate(Savestate* file)
@@ -79,6 +178,10 @@ void DoSavestate(Savestate* file)
     //if (!file->Saving && SRAMLength)
     //    delete[] SRAM;
 
+    // writes from before the savestate was loaded go to disk as they would have
+    if (!file->Saving && FlushTimer)
+        Flush();
+
     u32 oldlen = SRAMLength;
 
     file->Var32(&SRAMLength);
@@ -89,6 +192,8 @@ void DoSavestate(Savestate* file)
 
         if (oldlen) delete[] SRAM;
         if (SRAMLength) SRAM = new u8[SRAMLength];
+
+        InitDirtyPages();
     }
     if (SRAMLength)
     {
@@ -96,6 +201,11 @@ void DoSavestate(Savestate* file)
         //    SRAM = new u8[SRAMLength];
 
         file->VarArray(SRAM, SRAMLength);
+
+        // the loaded contents are written to the save file along with the
+        // next write from the game
+        if (!file->Saving)
+            SetAllDirty();
     }
 
     // SPI status shito
@@ -111,6 +221,8 @@ void DoSavestate(Savestate* file)
 
 void LoadSave(const char* path, u32 type)
 {
+    if (FlushTimer) Flush();
+
     if (SRAM) delete[] SRAM;
 
     strncpy(SRAMPath, path, 1023);
@@ -141,6 +253,8 @@ void LoadSave(const char* path, u32 type)
         }
     }
 
+    InitDirtyPages();
+
     switch (SRAMLength)
     {
     case 512: WriteFunc = Write_EEPROMTiny; break;
@@ -185,6 +299,8 @@ void RelocateSave(const char* path, bool write)
 
     fwrite(SRAM, SRAMLength, 1, f);
     fclose(f);
+
+    if (DirtyPages) InitDirtyPages();
 }
 
 u8 Read()
@@ -208,6 +324,7 @@ void Write_EEPROMTiny(u8 val, bool islast)
         else
         {
             SRAM[(Addr + ((CurCmd==0x0A)?0x100:0)) & 0x1FF] = val;
+            SetDirty(0);
             Addr++;
         }
         break;
@@ -254,6 +371,7 @@ void Write_EEPROM(u8 val, bool islast)
         else
         {
             SRAM[Addr & (SRAMLength-1)] = val;
+            SetDirty(Addr);
             Addr++;
         }
         break;
@@ -297,6 +415,7 @@ void Write_Flash(u8 val, bool islast)
         else
         {
             SRAM[Addr & (SRAMLength-1)] = 0;
+            SetDirty(Addr);
             Addr++;
         }
         break;
@@ -325,6 +444,7 @@ void Write_Flash(u8 val, bool islast)
         else
         {
             SRAM[Addr & (SRAMLength-1)] = val;
+            SetDirty(Addr);
             Addr++;
         }
         break;
@@ -345,6 +465,7 @@ void Write_Flash(u8 val, bool islast)
             for (u32 i = 0; i < 0x10000; i++)
             {
                 SRAM[Addr & (SRAMLength-1)] = 0;
+                SetDirty(Addr);
                 Addr++;
             }
         }
@@ -362,6 +483,7 @@ void Write_Flash(u8 val, bool islast)
             for (u32 i = 0; i < 0x100; i++)
             {
                 SRAM[Addr & (SRAMLength-1)] = 0;
+                SetDirty(Addr);
                 Addr++;
             }
         }
@@ -441,14 +563,10 @@ void Write(u8 val, u32 hold)
         break;
     }
 
-    if (islast && (CurCmd == 0x02 || CurCmd == 0x0A) && (SRAMLength > 0))
+    if (islast && (CurCmd == 0x02 || CurCmd == 0x0A || CurCmd == 0xD8 || CurCmd == 0xDB) && (SRAMLength > 0))
     {
-        FILE* f = Platform::OpenFile(SRAMPath, "wb");
-        if (f)
-        {
-            fwrite(SRAM, SRAMLength, 1, f);
-            fclose(f);
-        }
+        // restart the delay, a game usually saves with a lot of small writes
+        FlushTimer = kFlushDelay;
     }
 }
 
@@ -471,7 +589,9 @@ u32 DataOutLen;
 bool CartInserted;
 u8* CartROM;
 u32 CartROMSize;
+bool CartROMMapped;
 u32 CartCRC;
+bool CartCRCValid;
 u32 CartID;
 bool CartIsHomebrew;
 
@@ -598,13 +718,29 @@ bool Init()
     if (!NDSCart_SRAM::Init()) return false;
 
     CartROM = NULL;
+    CartROMMapped = false;
 
     return true;
 }
 
+void FreeROM()
+{
+    if (!CartROM) return;
+
+#ifndef _WIN32
+    if (CartROMMapped)
+        munmap(CartROM, CartROMSize);
+    else
+#endif
+        delete[] CartROM;
+
+    CartROM = NULL;
+    CartROMMapped = false;
+}
+
 void DeInit()
 {
-    if (CartROM) delete[] CartROM;
+    FreeROM();
 
     NDSCart_SRAM::DeInit();
 }
@@ -625,8 +761,7 @@ void Reset()
     DataOutLen = 0;
 
     CartInserted = false;
-    if (CartROM) delete[] CartROM;
-    CartROM = NULL;
+    FreeROM();
     CartROMSize = 0;
     CartID = 0;
     CartIsHomebrew = false;
@@ -666,6 +801,17 @@ void DoSavestate(Savestate* file)
     NDSCart_SRAM::DoSavestate(file);
 }
 
+void EndFrame()
+{
+    NDSCart_SRAM::EndFrame();
+}
+
+void FlushSRAM()
+{
+    if (NDSCart_SRAM::FlushTimer)
+        NDSCart_SRAM::Flush();
+}
+
 
 void ApplyDLDIPatch()
 {
@@ -811,65 +957,52 @@ void ApplyDLDIPatch()
 
 bool ReadROMParams(u32 gamecode, u32* params)
 {
-    // format for romlist.bin:
-    // [gamecode] [ROM size] [save type] [reserved]
-    // list must be sorted by gamecode
-
-    FILE* f = Platform::OpenLocalFile("romlist.bin", "rb");
-    if (!f) return false;
-
-    fseek(f, 0, SEEK_END);
-    u32 len = (u32)ftell(f);
-    u32 maxlen = len;
-    len >>= 4; // 16 bytes per entry
+    const ROMList::Entry* entry = ROMList::FindByGameCode(gamecode);
 
-    u32 offset = 0;
-    u32 chk_size = len >> 1;
-    for (;;)
-    {
-        u32 key = 0;
-        fseek(f, offset + (chk_size << 4), SEEK_SET);
-        fread(&key, 4, 1, f);
+    // old CRC-based lists need the ROM CRC, only compute it then
+    if (!entry && ROMList::HasCRCEntries())
+        entry = ROMList::FindByCRC(ROMCRC32());
 
-        printf("chk_size=%d, key=%08X, wanted=%08X, offset=%08X\n", chk_size, key, gamecode, offset);
+    if (!entry) return false;
 
-        if (key == gamecode)
-        {
-            fread(params, 4, 3, f);
-            fclose(f);
-            return true;
-        }
-        else
-        {
-            if (key < gamecode)
-            {
-                if (chk_size == 0)
-                    offset += 0x10;
-                else
-                    offset += (chk_size << 4);
-            }
-            else if (chk_size == 0)
-            {
-                fclose(f);
-                return false;
-            }
+    params[0] = entry->ROMSize;
+    params[1] = entry->SaveMemType;
+    params[2] = entry->Flags;
+    return true;
+}
 
-            chk_size >>= 1;
-        }
 
-        if (offset >= maxlen)
-        {
-            fclose(f);
-            return false;
-        }
+u8* MapROM(FILE* f, u32 len, u32 size)
+{
+#ifdef _WIN32
+    // Windows always uses the read path: the area past the end of the file
+    // must read as zeroes, and a file view can't be placed in front of
+    // zeroed memory in one reserved region without the placeholder APIs
+    // of recent Windows versions.
+    return NULL;
+#else
+    // the area past the end of the file must read as zeroes, so the whole
+    // power-of-two size is reserved as anonymous memory and the file is
+    // mapped over the start of it.
+    // the mapping is private: pages we write to (secure area re-encryption)
+    // become copies, the others stay shared with the page cache.
+    u8* rom = (u8*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rom == (u8*)MAP_FAILED) return NULL;
+
+    if (mmap(rom, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(f), 0) == MAP_FAILED)
+    {
+        munmap(rom, size);
+        return NULL;
     }
-}
 
+    return rom;
+#endif
+}
 
 bool LoadROM(const char* path, const char* sram, bool direct)
 {
-    // TODO: streaming mode? for really big ROMs or systems with limited RAM
-    // for now we're lazy
+    // the ROM is memory-mapped where possible, so it's only read from disk
+    // as it's accessed, and not copied at all
 
     FILE* f = Platform::OpenFile(path, "rb");
     if (!f)
@@ -891,16 +1024,22 @@ bool LoadROM(const char* path, const char* sram, bool direct)
     fread(&gamecode, 4, 1, f);
     printf("Game code: %c%c%c%c\n", gamecode&0xFF, (gamecode>>8)&0xFF, (gamecode>>16)&0xFF, gamecode>>24);
 
-    CartROM = new u8[CartROMSize];
-    memset(CartROM, 0, CartROMSize);
-    fseek(f, 0, SEEK_SET);
-    fread(CartROM, 1, len, f);
+    CartROM = MapROM(f, len, CartROMSize);
+    if (CartROM)
+    {
+        CartROMMapped = true;
+    }
+    else
+    {
+        CartROM = new u8[CartROMSize];
+        memset(CartROM, 0, CartROMSize);
+        fseek(f, 0, SEEK_SET);
+        fread(CartROM, 1, len, f);
+    }
 
     fclose(f);
-    //CartROM = f;
 
-    CartCRC = CRC32(CartROM, CartROMSize);
-    printf("ROM CRC32: %08X\n", CartCRC);
+    CartCRCValid = false;
 
     u32 romparams[3];
     if (!ReadROMParams(gamecode, romparams))
@@ -990,6 +1129,20 @@ bool LoadROM(const char* path, const char* sram, bool direct)
     return true;
 }
 
+u32 ROMCRC32()
+{
+    // reading a big ROM whole takes a while, so only do it if needed
+    // this is first called from ReadROMParams(), before the secure area is
+    // re-encrypted, so the CRC is the one of the ROM file as-is
+    if (!CartCRCValid)
+    {
+        CartCRC = CRC32(CartROM, CartROMSize);
+        CartCRCValid = true;
+    }
+
+    return CartCRC;
+}
+
 void RelocateSave(const char* path, bool write)
 {
     // herp derp
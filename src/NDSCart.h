@@ -45,6 +45,14 @@ void Reset();
 void DoSavestate(Savestate* file);
 
 bool LoadROM(const char* path, const char* sram, bool direct);
+
+// CRC32 of the loaded ROM, computed on first use
+u32 ROMCRC32();
+
+// save memory writes are written to disk after a delay, see NDSCart_SRAM
+void EndFrame();
+// writes them right away
+void FlushSRAM();
 void RelocateSave(const char* path, bool write);
 
 void WriteROMCnt(u32 val);
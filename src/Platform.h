@@ -42,6 +42,11 @@ void StopEmu();
 FILE* OpenFile(const char* path, const char* mode, bool mustexist=false);
 FILE* OpenLocalFile(const char* path, const char* mode);
 
+// UTF8 rename() and remove() wrappers
+// RenameFile() replaces newpath if it already exists
+bool RenameFile(const char* oldpath, const char* newpath);
+bool RemoveFile(const char* path);
+
 inline bool FileExists(const char* name)
 {
     FILE* f = OpenFile(name, "rb");
@@ -66,6 +71,8 @@ void* Semaphore_Create();
 void Semaphore_Free(void* sema);
 void Semaphore_Reset(void* sema);
 void Semaphore_Wait(void* sema);
+// returns false if nothing was posted within the timeout (in milliseconds)
+bool Semaphore_WaitTimeout(void* sema, int timeout);
 void Semaphore_Post(void* sema);
 
 void* GL_GetProcAddress(const char* proc);
@@ -0,0 +1,315 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include "Profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Platform.h"
+
+
+namespace Profiler
+{
+
+const char* kSectionNames[Section_MAX] =
+{
+    "ARM9",
+    "ARM7",
+    "DMA9",
+    "DMA7",
+    "Timers",
+    "GPU3D",
+    "SPU",
+    "GPU2D",
+    "Render3D",
+    "Render3DWait",
+
+    "Event_LCD",
+    "Event_SPU",
+    "Event_Wifi",
+    "Event_DisplayFIFO",
+    "Event_ROMTransfer",
+    "Event_ROMSPITransfer",
+    "Event_SPITransfer",
+    "Event_Div",
+    "Event_Sqrt",
+};
+
+// sections up to this one run too often to be traced one by one
+const u32 kLastCounterOnlySection = Section_GPU3D;
+
+const u32 kTraceBufferSize = 8192;
+
+typedef struct
+{
+    u32 Section;
+    u32 Thread;
+    u64 Start, End;
+
+} TraceEvent;
+
+// the 3D renderer thread adds to these too
+std::atomic<u64> FrameTime[Section_MAX];
+std::atomic<u64> FrameCalls[Section_MAX];
+
+Counter LastFrame[Section_MAX];
+Counter Total[Section_MAX];
+
+u32 NumFrames;
+u64 FrameStart;
+
+FILE* JSONFile;
+
+FILE* TraceFile;
+bool TraceFirst;
+u64 TraceStart;
+std::mutex TraceLock;
+TraceEvent TraceBuffer[kTraceBufferSize];
+u32 TraceBufferLen;
+
+thread_local u32 CurThread = 0;
+
+
+void Init()
+{
+    JSONFile = NULL;
+    TraceFile = NULL;
+
+    Reset();
+}
+
+void DeInit()
+{
+    CloseJSON();
+    CloseTrace();
+}
+
+void Reset()
+{
+    for (u32 i = 0; i < Section_MAX; i++)
+    {
+        FrameTime[i] = 0;
+        FrameCalls[i] = 0;
+    }
+
+    memset(LastFrame, 0, sizeof(LastFrame));
+    memset(Total, 0, sizeof(Total));
+
+    NumFrames = 0;
+    FrameStart = Now();
+}
+
+
+u64 Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FlushTrace()
+{
+    for (u32 i = 0; i < TraceBufferLen; i++)
+    {
+        TraceEvent* ev = &TraceBuffer[i];
+
+        fprintf(TraceFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                TraceFirst ? "" : ",\n",
+                kSectionNames[ev->Section],
+                (ev->Start - TraceStart) / 1000.0,
+                (ev->End - ev->Start) / 1000.0,
+                ev->Thread);
+        TraceFirst = false;
+    }
+
+    TraceBufferLen = 0;
+}
+
+void AddTime(u32 section, u64 start, u64 end)
+{
+    FrameTime[section].fetch_add(end - start, std::memory_order_relaxed);
+    FrameCalls[section].fetch_add(1, std::memory_order_relaxed);
+
+    if (TraceFile && section > kLastCounterOnlySection)
+    {
+        std::lock_guard<std::mutex> lock(TraceLock);
+        if (!TraceFile) return;
+
+        if (TraceBufferLen >= kTraceBufferSize)
+            FlushTrace();
+
+        TraceEvent* ev = &TraceBuffer[TraceBufferLen++];
+        ev->Section = section;
+        ev->Thread = CurThread;
+        ev->Start = start;
+        ev->End = end;
+    }
+}
+
+void SetThread(u32 thread)
+{
+    CurThread = thread;
+}
+
+
+void BeginFrame()
+{
+    FrameStart = Now();
+}
+
+void EndFrame()
+{
+    u64 frameend = Now();
+
+    for (u32 i = 0; i < Section_MAX; i++)
+    {
+        LastFrame[i].Time = FrameTime[i].exchange(0, std::memory_order_relaxed);
+        LastFrame[i].Calls = FrameCalls[i].exchange(0, std::memory_order_relaxed);
+
+        Total[i].Time += LastFrame[i].Time;
+        Total[i].Calls += LastFrame[i].Calls;
+    }
+
+    if (JSONFile)
+    {
+        fprintf(JSONFile, "{\"frame\":%u,\"ns\":%llu,\"sections\":{",
+                NumFrames, (unsigned long long)(frameend - FrameStart));
+        for (u32 i = 0; i < Section_MAX; i++)
+        {
+            fprintf(JSONFile, "%s\"%s\":{\"ns\":%llu,\"calls\":%llu}",
+                    i ? "," : "",
+                    kSectionNames[i],
+                    (unsigned long long)LastFrame[i].Time,
+                    (unsigned long long)LastFrame[i].Calls);
+        }
+        fprintf(JSONFile, "}}\n");
+    }
+
+    if (TraceFile)
+    {
+        std::lock_guard<std::mutex> lock(TraceLock);
+        FlushTrace();
+
+        double ts = (FrameStart - TraceStart) / 1000.0;
+
+        fprintf(TraceFile, "%s{\"name\":\"Frame %u\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0}",
+                TraceFirst ? "" : ",\n",
+                NumFrames, ts, (frameend - FrameStart) / 1000.0);
+        TraceFirst = false;
+
+        // host time of the counter-only sections, in microseconds
+        fprintf(TraceFile, ",\n{\"name\":\"Frame time (us)\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":0,\"args\":{", ts);
+        for (u32 i = 0; i <= kLastCounterOnlySection; i++)
+        {
+            fprintf(TraceFile, "%s\"%s\":%.3f",
+                    i ? "," : "",
+                    kSectionNames[i],
+                    LastFrame[i].Time / 1000.0);
+        }
+        fprintf(TraceFile, "}}");
+    }
+
+    NumFrames++;
+}
+
+
+void GetFrameCounters(Counter* counters)
+{
+    memcpy(counters, LastFrame, sizeof(LastFrame));
+}
+
+void GetTotalCounters(Counter* counters)
+{
+    memcpy(counters, Total, sizeof(Total));
+}
+
+const char* GetSectionName(u32 section)
+{
+    if (section >= Section_MAX) return "";
+    return kSectionNames[section];
+}
+
+
+bool OpenJSON(const char* path)
+{
+    CloseJSON();
+
+    JSONFile = Platform::OpenFile(path, "w");
+    if (!JSONFile)
+    {
+        printf("Profiler: could not open %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+void CloseJSON()
+{
+    if (!JSONFile) return;
+
+    fclose(JSONFile);
+    JSONFile = NULL;
+}
+
+bool OpenTrace(const char* path)
+{
+    CloseTrace();
+
+    FILE* f = Platform::OpenFile(path, "w");
+    if (!f)
+    {
+        printf("Profiler: could not open %s\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(TraceLock);
+
+    fprintf(f, "[\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"emulator\"}},\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"3D renderer\"}},\n");
+    fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":2,\"args\":{\"name\":\"2D renderer\"}}");
+    for (u32 i = 1; i < 8; i++)
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"3D renderer band %u\"}}", 2+i, i);
+
+    TraceFirst = false;
+    TraceStart = Now();
+    TraceBufferLen = 0;
+    TraceFile = f;
+    return true;
+}
+
+void CloseTrace()
+{
+    if (!TraceFile) return;
+
+    std::lock_guard<std::mutex> lock(TraceLock);
+
+    FlushTrace();
+    fprintf(TraceFile, "\n]\n");
+    fclose(TraceFile);
+    TraceFile = NULL;
+}
+
+}
+
+#endif // ENABLE_PROFILER
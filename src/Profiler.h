@@ -0,0 +1,124 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "types.h"
+#include "NDS.h"
+
+// host time profiler for the emulator core
+//
+// only built with ENABLE_PROFILER defined (cmake -DENABLE_PROFILER=ON).
+// otherwise the PROFILE_* macros expand to nothing, and none of this exists.
+//
+// time and call counts are accumulated per section, per frame and in total.
+// sections nest: scheduler events include what they call (GPU2D, SPU, DMA
+// starts, ...), so the sum of all sections is more than the frame time.
+//
+// the per-frame counters can be written to a JSON lines file, and a Chrome
+// trace (chrome://tracing, Perfetto) can be recorded. in the trace, the
+// sections that run a lot of times per frame (CPUs, DMA, timers, geometry)
+// only show up as per-frame counters, to keep the file size sane.
+
+#ifdef ENABLE_PROFILER
+
+namespace Profiler
+{
+
+enum
+{
+    Section_ARM9 = 0,
+    Section_ARM7,
+    Section_DMA9,
+    Section_DMA7,
+    Section_Timers,
+    Section_GPU3D,
+    Section_SPU,
+    Section_GPU2D,
+    Section_Render3D,
+    Section_Render3DWait,
+
+    // one per scheduler event ID
+    Section_Event,
+
+    Section_MAX = Section_Event + NDS::Event_MAX
+};
+
+typedef struct
+{
+    u64 Time; // nanoseconds
+    u64 Calls;
+
+} Counter;
+
+void Init();
+void DeInit();
+void Reset();
+
+void BeginFrame();
+void EndFrame();
+
+// counters for the last complete frame, and since the last Reset()
+void GetFrameCounters(Counter* counters);
+void GetTotalCounters(Counter* counters);
+
+const char* GetSectionName(u32 section);
+
+bool OpenJSON(const char* path);
+void CloseJSON();
+
+bool OpenTrace(const char* path);
+void CloseTrace();
+
+// thread the calling code runs on, for the trace (0 = emulator thread)
+void SetThread(u32 thread);
+
+u64 Now();
+void AddTime(u32 section, u64 start, u64 end);
+
+class Scope
+{
+public:
+    Scope(u32 section) : Section(section), Start(Now()) {}
+    ~Scope() { AddTime(Section, Start, Now()); }
+
+private:
+    u32 Section;
+    u64 Start;
+};
+
+}
+
+#define PROFILE_SCOPE(section) Profiler::Scope profscope(Profiler::section)
+#define PROFILE_EVENT(id) Profiler::Scope profscope(Profiler::Section_Event + (id))
+#define PROFILE_THREAD(thread) Profiler::SetThread(thread)
+#define PROFILE_BEGIN_FRAME() Profiler::BeginFrame()
+#define PROFILE_END_FRAME() Profiler::EndFrame()
+
+#else
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_EVENT(id)
+#define PROFILE_THREAD(thread)
+#define PROFILE_BEGIN_FRAME()
+#define PROFILE_END_FRAME()
+
+#endif // ENABLE_PROFILER
+
+#endif // PROFILER_H
@@ -0,0 +1,202 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ROMList.h"
+#include "Platform.h"
+
+
+namespace ROMList
+{
+
+Entry* List;
+u32 NumList;
+
+// open addressing hash tables, each slot is an index into List plus one
+// or zero if empty. they are kept at most half full.
+u32* GameCodeIndex;
+u32* CRCIndex;
+u32 IndexMask;
+
+bool CRCEntries;
+
+
+u32 Hash(u32 key)
+{
+    key *= 0x9E3779B1;
+    return key ^ (key >> 16);
+}
+
+u32 Key(const Entry* entry, bool crc)
+{
+    return crc ? entry->CRC32 : entry->GameCode;
+}
+
+void AddToIndex(u32* index, bool crc, u32 num)
+{
+    u32 key = Key(&List[num], crc);
+    u32 slot = Hash(key) & IndexMask;
+    while (index[slot])
+    {
+        // keep the first entry if a key is listed twice
+        if (Key(&List[index[slot]-1], crc) == key)
+            return;
+
+        slot = (slot + 1) & IndexMask;
+    }
+
+    index[slot] = num + 1;
+}
+
+bool Init()
+{
+    List = NULL;
+    NumList = 0;
+    GameCodeIndex = NULL;
+    CRCIndex = NULL;
+    IndexMask = 0;
+    CRCEntries = false;
+
+    FILE* f = Platform::OpenLocalFile("romlist.bin", "rb");
+    if (!f)
+    {
+        printf("romlist.bin not found, save memory types will be guessed\n");
+        return true;
+    }
+
+    fseek(f, 0, SEEK_END);
+    u32 len = (u32)ftell(f) >> 4;
+    fseek(f, 0, SEEK_SET);
+
+    u32* raw = new u32[len*4 + 1];
+    len = fread(raw, 16, len, f);
+    fclose(f);
+
+    if (len == 0)
+    {
+        delete[] raw;
+        return true;
+    }
+
+    // keys are stored in ascending order, so a list that starts with a key
+    // whose top byte is zero is an old CRC-based list. gamecodes are ASCII.
+    bool crclist = (raw[0] >> 24) == 0;
+
+    List = new Entry[len];
+    NumList = len;
+    for (u32 i = 0; i < len; i++)
+    {
+        Entry* entry = &List[i];
+        if (crclist)
+        {
+            entry->GameCode = 0;
+            entry->CRC32 = raw[i*4 + 0];
+        }
+        else
+        {
+            entry->GameCode = raw[i*4 + 0];
+            entry->CRC32 = 0;
+        }
+        entry->ROMSize = raw[i*4 + 1];
+        entry->SaveMemType = raw[i*4 + 2];
+        entry->Flags = raw[i*4 + 3];
+    }
+
+    delete[] raw;
+
+    u32 size = 16;
+    while (size < len*2) size <<= 1;
+    IndexMask = size - 1;
+
+    GameCodeIndex = new u32[size];
+    CRCIndex = new u32[size];
+    memset(GameCodeIndex, 0, size*4);
+    memset(CRCIndex, 0, size*4);
+
+    for (u32 i = 0; i < len; i++)
+    {
+        if (List[i].GameCode) AddToIndex(GameCodeIndex, false, i);
+        if (List[i].CRC32)
+        {
+            AddToIndex(CRCIndex, true, i);
+            if (!List[i].GameCode) CRCEntries = true;
+        }
+    }
+
+    printf("romlist.bin: %d entries%s\n", NumList, crclist ? " (CRC-based)" : "");
+    return true;
+}
+
+void DeInit()
+{
+    if (List) delete[] List;
+    if (GameCodeIndex) delete[] GameCodeIndex;
+    if (CRCIndex) delete[] CRCIndex;
+
+    List = NULL;
+    NumList = 0;
+    GameCodeIndex = NULL;
+    CRCIndex = NULL;
+    CRCEntries = false;
+}
+
+u32 NumEntries()
+{
+    return NumList;
+}
+
+const Entry* FindByGameCode(u32 gamecode)
+{
+    if (!GameCodeIndex || !gamecode) return NULL;
+
+    u32 slot = Hash(gamecode) & IndexMask;
+    while (GameCodeIndex[slot])
+    {
+        const Entry* entry = &List[GameCodeIndex[slot]-1];
+        if (entry->GameCode == gamecode) return entry;
+
+        slot = (slot + 1) & IndexMask;
+    }
+
+    return NULL;
+}
+
+const Entry* FindByCRC(u32 crc)
+{
+    if (!CRCIndex || !crc) return NULL;
+
+    u32 slot = Hash(crc) & IndexMask;
+    while (CRCIndex[slot])
+    {
+        const Entry* entry = &List[CRCIndex[slot]-1];
+        if (entry->CRC32 == crc) return entry;
+
+        slot = (slot + 1) & IndexMask;
+    }
+
+    return NULL;
+}
+
+bool HasCRCEntries()
+{
+    return CRCEntries;
+}
+
+}
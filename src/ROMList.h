@@ -0,0 +1,62 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef ROMLIST_H
+#define ROMLIST_H
+
+#include "types.h"
+
+// game database
+//
+// romlist.bin is loaded once at startup into a table sorted by gamecode,
+// with hash indexes for gamecode and ROM CRC lookups.
+//
+// romlist.bin format, 16 bytes per entry, sorted by key:
+// [gamecode] [ROM size] [save type] [flags]
+// old lists use the ROM CRC32 as the key instead of the gamecode.
+
+namespace ROMList
+{
+
+struct Entry
+{
+    u32 GameCode;
+    u32 CRC32;      // 0 if not known
+    u32 ROMSize;
+    u32 SaveMemType;
+
+    // per-game hints (idle loops, renderer quirks, ...)
+    // from the reserved field of romlist.bin, none are defined yet
+    u32 Flags;
+};
+
+bool Init();
+void DeInit();
+
+u32 NumEntries();
+
+// return NULL if the game isn't in the list
+const Entry* FindByGameCode(u32 gamecode);
+const Entry* FindByCRC(u32 crc);
+
+// whether there are entries that can only be found by CRC
+bool HasCRCEntries();
+
+}
+
+#endif // ROMLIST_H
@@ -0,0 +1,306 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Rewind.h"
+#include "Config.h"
+#include "NDS.h"
+#include "Savestate.h"
+
+
+namespace Rewind
+{
+
+// new snapshot, written by the savestate code
+u8* State;
+u32 StateSize;
+
+// last snapshot
+u8* Current;
+u32 CurrentSize;
+u32 CurrentLen;
+
+// delta between two snapshots
+// format: repeated {u32 unchanged words, u32 changed words, XOR of the changed words}
+u8* Delta;
+u32 DeltaSize;
+
+// ring buffer of deltas, newest last
+// each entry is {u32 length, delta, u32 length} so it can be walked both ways
+u8* Ring;
+u32 RingSize;
+u32 RingStart, RingEnd;
+u32 RingUsed;
+u32 NumEntries;
+
+u32 FrameCount;
+
+
+bool Init()
+{
+    State = NULL;
+    StateSize = 0;
+    Current = NULL;
+    CurrentSize = 0;
+    Delta = NULL;
+    DeltaSize = 0;
+    Ring = NULL;
+    RingSize = 0;
+
+    Reset();
+    return true;
+}
+
+void DeInit()
+{
+    if (State) free(State);
+    if (Current) free(Current);
+    if (Delta) free(Delta);
+    if (Ring) delete[] Ring;
+}
+
+void Reset()
+{
+    CurrentLen = 0;
+
+    RingStart = 0;
+    RingEnd = 0;
+    RingUsed = 0;
+    NumEntries = 0;
+
+    FrameCount = 0;
+}
+
+
+void RingWrite(u32 pos, const void* data, u32 len)
+{
+    u32 first = RingSize - pos;
+    if (first >= len)
+    {
+        memcpy(&Ring[pos], data, len);
+    }
+    else
+    {
+        memcpy(&Ring[pos], data, first);
+        memcpy(Ring, &((u8*)data)[first], len - first);
+    }
+}
+
+void RingRead(u32 pos, void* data, u32 len)
+{
+    u32 first = RingSize - pos;
+    if (first >= len)
+    {
+        memcpy(data, &Ring[pos], len);
+    }
+    else
+    {
+        memcpy(data, &Ring[pos], first);
+        memcpy(&((u8*)data)[first], Ring, len - first);
+    }
+}
+
+void DropOldest()
+{
+    u32 len;
+    RingRead(RingStart, &len, 4);
+
+    RingStart = (RingStart + len + 8) % RingSize;
+    RingUsed -= (len + 8);
+    NumEntries--;
+}
+
+void PushDelta(u32 len)
+{
+    if (len + 8 > RingSize)
+    {
+        // can't keep anything older than the current snapshot
+        RingStart = RingEnd = RingUsed = NumEntries = 0;
+        return;
+    }
+
+    while ((RingSize - RingUsed) < (len + 8))
+        DropOldest();
+
+    RingWrite(RingEnd, &len, 4);
+    RingWrite((RingEnd + 4) % RingSize, Delta, len);
+    RingWrite((RingEnd + 4 + len) % RingSize, &len, 4);
+
+    RingEnd = (RingEnd + len + 8) % RingSize;
+    RingUsed += (len + 8);
+    NumEntries++;
+}
+
+u32 PopDelta()
+{
+    u32 len;
+    RingRead((RingEnd + RingSize - 4) % RingSize, &len, 4);
+
+    RingEnd = (RingEnd + RingSize - (len + 8)) % RingSize;
+    RingRead((RingEnd + 4) % RingSize, Delta, len);
+
+    RingUsed -= (len + 8);
+    NumEntries--;
+    return len;
+}
+
+u32 EncodeDelta(u32* prev, u32* cur, u32 numwords)
+{
+    // a changed run only ends at two unchanged words in a row, so the
+    // output can't be bigger than numwords+2 words
+    u32* out = (u32*)Delta;
+    u32 n = 0;
+    u32 i = 0;
+
+    while (i < numwords)
+    {
+        u32 skipstart = i;
+        while (i < numwords && prev[i] == cur[i]) i++;
+        if (i == numwords) break;
+
+        u32 start = i;
+        while (i < numwords)
+        {
+            if (prev[i] == cur[i] && (i+1 == numwords || prev[i+1] == cur[i+1]))
+                break;
+            i++;
+        }
+
+        out[n++] = start - skipstart;
+        out[n++] = i - start;
+        for (u32 j = start; j < i; j++)
+            out[n++] = prev[j] ^ cur[j];
+    }
+
+    return n << 2;
+}
+
+void ApplyDelta(u32* buf, u32 len)
+{
+    u32* in = (u32*)Delta;
+    u32 n = len >> 2;
+    u32 i = 0;
+    u32 pos = 0;
+
+    while (i < n)
+    {
+        pos += in[i++];
+        u32 count = in[i++];
+        for (u32 j = 0; j < count; j++)
+            buf[pos++] ^= in[i++];
+    }
+}
+
+bool Grow(u8** buf, u32* size, u32 len)
+{
+    if (*size >= len) return true;
+
+    u8* newbuf = (u8*)realloc(*buf, len);
+    if (!newbuf) return false;
+
+    *buf = newbuf;
+    *size = len;
+    return true;
+}
+
+
+void Frame()
+{
+    if (Config::RewindInterval < 1) return;
+
+    FrameCount++;
+    if (FrameCount < (u32)Config::RewindInterval) return;
+    FrameCount = 0;
+
+    if (!Ring)
+    {
+        RingSize = Config::RewindBufferSize << 20;
+        if (RingSize < 0x100000) RingSize = 0x100000;
+        Ring = new u8[RingSize];
+    }
+
+    Savestate* state = new Savestate(&State, &StateSize);
+    NDS::DoSavestate(state);
+    u32 len = state->GetLength();
+    bool error = state->Error;
+    delete state;
+
+    if (error) return;
+
+    // deltas are done per word, pad the state with zeroes
+    u32 numwords = (len + 3) >> 2;
+    if (!Grow(&State, &StateSize, numwords << 2) ||
+        !Grow(&Delta, &DeltaSize, (numwords + 2) << 2))
+    {
+        printf("rewind: out of memory\n");
+        Reset();
+        return;
+    }
+    memset(&State[len], 0, (numwords << 2) - len);
+
+    if (len == CurrentLen)
+    {
+        u32 deltalen = EncodeDelta((u32*)Current, (u32*)State, numwords);
+        PushDelta(deltalen);
+    }
+    else
+    {
+        // can't be diffed against the previous snapshot
+        RingStart = RingEnd = RingUsed = NumEntries = 0;
+    }
+
+    u8* tmp = Current; Current = State; State = tmp;
+    u32 tmpsize = CurrentSize; CurrentSize = StateSize; StateSize = tmpsize;
+    CurrentLen = len;
+}
+
+bool Step()
+{
+    if (!CurrentLen) return false;
+
+    Savestate* state = new Savestate(Current, CurrentLen);
+    NDS::DoSavestate(state);
+    bool error = state->Error;
+    delete state;
+
+    if (NumEntries)
+    {
+        u32 len = PopDelta();
+        ApplyDelta((u32*)Current, len);
+    }
+    else
+        CurrentLen = 0;
+
+    FrameCount = 0;
+    return !error;
+}
+
+
+u32 NumSnapshots()
+{
+    return CurrentLen ? (NumEntries + 1) : 0;
+}
+
+u32 MemoryUsed()
+{
+    return CurrentLen + RingUsed;
+}
+
+}
@@ -0,0 +1,55 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "types.h"
+
+// rewind buffer
+//
+// every Config::RewindInterval frames, an in-memory savestate is taken. the
+// last one is kept whole, the older ones are stored in a ring buffer of
+// Config::RewindBufferSize megabytes as the XOR of each state with the next
+// one, with unchanged runs skipped. most of the state doesn't change from
+// one snapshot to the next, so these are usually a few KB.
+//
+// the oldest snapshots are dropped when the ring buffer is full.
+
+namespace Rewind
+{
+
+bool Init();
+void DeInit();
+
+// drops all the snapshots
+void Reset();
+
+// to be called after each emulated frame
+void Frame();
+
+// goes back to the last snapshot and drops it
+// returns false if there are no snapshots left
+bool Step();
+
+u32 NumSnapshots();
+u32 MemoryUsed();
+
+}
+
+#endif // REWIND_H
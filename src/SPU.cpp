@@ -20,6 +20,9 @@
 #include <string.h>
 #include "NDS.h"
 #include "SPU.h"
+#include "ARMCache.h"
+#include "Config.h"
+#include "Profiler.h"
 
 
 // SPU TODO
@@ -63,6 +66,22 @@ const s16 PSGTable[8][8] =
 
 const u32 kSamplesPerRun = 1;
 
+// mixing is deferred when nothing can observe it, and done in batches
+// whenever something would: register accesses, writes to the sample data
+// (through the ARMCache page flags), savestates and the end of the frame.
+// the Event_SPU tick is kept as is, so the CPU run slices stay the same.
+const u32 kMaxPendingSamples = 1024;
+const u32 kMaxMixSamples = 256;
+
+u32 PendingSamples;
+
+// main RAM page ranges flagged with kPage_SPU
+u32 WatchStart[32];
+u32 WatchEnd[32];
+u32 NumWatch;
+
+void Unwatch();
+
 const u32 OutputBufferSize = 2*1024;
 s16 OutputBuffer[2 * OutputBufferSize];
 u32 OutputReadOffset;
@@ -113,6 +132,9 @@ void Reset()
     Capture[0]->Reset();
     Capture[1]->Reset();
 
+    PendingSamples = 0;
+    NumWatch = 0;
+
     NDS::ScheduleEvent(NDS::Event_SPU, true, 1024*kSamplesPerRun, Mix, kSamplesPerRun);
 }
 
@@ -123,6 +145,14 @@ void Stop()
 
 void DoSavestate(Savestate* file)
 {
+    if (file->Saving)
+        Sync();
+    else
+    {
+        Unwatch();
+        PendingSamples = 0;
+    }
+
     file->Section("SPU.");
 
     file->Var16(&Cnt);
@@ -580,12 +610,14 @@ void CaptureUnit::Run(s32 sample)
 }
 
 
-void Mix(u32 samples)
+void DoMix(u32 samples)
 {
-    s32 channelbuf[32];
-    s32 leftbuf[32], rightbuf[32];
-    s32 ch0buf[32], ch1buf[32], ch2buf[32], ch3buf[32];
-    s32 leftoutput[32], rightoutput[32];
+    PROFILE_SCOPE(Section_SPU);
+
+    s32 channelbuf[kMaxMixSamples];
+    s32 leftbuf[kMaxMixSamples], rightbuf[kMaxMixSamples];
+    s32 ch0buf[kMaxMixSamples], ch1buf[kMaxMixSamples], ch2buf[kMaxMixSamples], ch3buf[kMaxMixSamples];
+    s32 leftoutput[kMaxMixSamples], rightoutput[kMaxMixSamples];
 
     for (u32 s = 0; s < samples; s++)
     {
@@ -735,10 +767,113 @@ void Mix(u32 samples)
         OutputWriteOffset += 2;
         OutputWriteOffset &= ((2*OutputBufferSize)-1);
     }
+}
+
+bool CanDeferMix()
+{
+    if (!Config::AudioBatchMix) return false;
+
+    // capture writes to memory, which the CPUs may read at any time
+    if ((Capture[0]->Cnt | Capture[1]->Cnt) & 0x80) return false;
+
+    for (int i = 0; i < 16; i++)
+    {
+        Channel* chan = Channels[i];
+        if (!(chan->Cnt & (1<<31))) continue;
+        if (((chan->Cnt >> 29) & 0x3) == 3) continue; // PSG/noise
+
+        // only writes to main RAM are tracked
+        u32 start = chan->SrcAddr;
+        u32 end = start + chan->LoopPos + chan->Length;
+        if ((start >> 24) != 0x02 || (end > start && ((end-1) >> 24) != 0x02))
+            return false;
+    }
+
+    return true;
+}
+
+void WatchRange(u32 start, u32 end)
+{
+    u32 first = (ARMCache::kCode_MainRAM + start) >> ARMCache::kPageShift;
+    u32 last = (ARMCache::kCode_MainRAM + end - 1) >> ARMCache::kPageShift;
+
+    for (u32 p = first; p <= last; p++)
+        ARMCache::PageFlags[p] |= ARMCache::kPage_SPU;
+
+    WatchStart[NumWatch] = first;
+    WatchEnd[NumWatch] = last;
+    NumWatch++;
+}
+
+void Watch()
+{
+    for (int i = 0; i < 16; i++)
+    {
+        Channel* chan = Channels[i];
+        if (!(chan->Cnt & (1<<31))) continue;
+        if (((chan->Cnt >> 29) & 0x3) == 3) continue;
+
+        u32 len = chan->LoopPos + chan->Length;
+        if (!len) continue;
+
+        if (len >= MAIN_RAM_SIZE)
+        {
+            WatchRange(0, MAIN_RAM_SIZE);
+            continue;
+        }
+
+        u32 start = chan->SrcAddr & (MAIN_RAM_SIZE - 1);
+        if (start + len > MAIN_RAM_SIZE)
+        {
+            WatchRange(start, MAIN_RAM_SIZE);
+            WatchRange(0, start + len - MAIN_RAM_SIZE);
+        }
+        else
+            WatchRange(start, start + len);
+    }
+}
+
+void Unwatch()
+{
+    for (u32 i = 0; i < NumWatch; i++)
+    {
+        for (u32 p = WatchStart[i]; p <= WatchEnd[i]; p++)
+            ARMCache::PageFlags[p] &= ~ARMCache::kPage_SPU;
+    }
+
+    NumWatch = 0;
+}
+
+void Mix(u32 samples)
+{
+    PendingSamples += samples;
+
+    if (!CanDeferMix() || PendingSamples >= kMaxPendingSamples)
+        Sync();
+    else if (PendingSamples == samples)
+        Watch();
 
     NDS::ScheduleEvent(NDS::Event_SPU, true, 1024*kSamplesPerRun, Mix, kSamplesPerRun);
 }
 
+void Sync()
+{
+    if (!PendingSamples) return;
+
+    u32 samples = PendingSamples;
+    PendingSamples = 0;
+    Unwatch();
+
+    while (samples > 0)
+    {
+        u32 num = samples;
+        if (num > kMaxMixSamples) num = kMaxMixSamples;
+
+        DoMix(num);
+        samples -= num;
+    }
+}
+
 
 int ReadOutput(s16* data, int samples)
 {
@@ -765,6 +900,8 @@ int ReadOutput(s16* data, int samples)
 
 u8 Read8(u32 addr)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -795,6 +932,8 @@ u8 Read8(u32 addr)
 
 u16 Read16(u32 addr)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -822,6 +961,8 @@ u16 Read16(u32 addr)
 
 u32 Read32(u32 addr)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -851,6 +992,8 @@ u32 Read32(u32 addr)
 
 void Write8(u32 addr, u8 val)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -892,6 +1035,8 @@ void Write8(u32 addr, u8 val)
 
 void Write16(u32 addr, u16 val)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
@@ -941,6 +1086,8 @@ void Write16(u32 addr, u16 val)
 
 void Write32(u32 addr, u32 val)
 {
+    Sync();
+
     if (addr < 0x04000500)
     {
         Channel* chan = Channels[(addr >> 4) & 0xF];
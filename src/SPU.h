@@ -35,6 +35,9 @@ void SetBias(u16 bias);
 
 void Mix(u32 samples);
 
+// mixes any samples that were deferred
+void Sync();
+
 int ReadOutput(s16* data, int samples);
 
 u8 Read8(u32 addr);
@@ -17,8 +17,11 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "Savestate.h"
 #include "Platform.h"
+#include "LZ4.h"
 
 /*
     Savestate format
@@ -45,14 +48,35 @@
     version difference:
     * different major means savestate file is incompatible
     * different minor means adjustments may have to be made
+
+    the state is built in memory, then written to the file if any. section
+    lengths are patched in place when the next section starts.
+
+    compressed savestate files:
+    00 - magic MELZ
+    04 - uncompressed length
+    08 - compressed length
+    0C - reserved
+    10 - savestate as above, LZ4 block
 */
 
+const char* kSavestateMagic = "MELN";
+const char* kCompressedMagic = "MELZ";
+
+
 Savestate::Savestate(const char* filename, bool save)
 {
-    const char* magic = "MELN";
-
     Error = false;
 
+    file = NULL;
+    Buffer = NULL;
+    BufferSize = 0;
+    Length = 0;
+    Pos = 0;
+    OwnBuffer = true;
+    OutBuffer = NULL;
+    OutBufferSize = NULL;
+
     if (save)
     {
         Saving = true;
@@ -64,93 +88,223 @@ Savestate::Savestate(const char* filename, bool save)
             return;
         }
 
-        VersionMajor = SAVESTATE_MAJOR;
-        VersionMinor = SAVESTATE_MINOR;
-
-        fwrite(magic, 4, 1, file);
-        fwrite(&VersionMajor, 2, 1, file);
-        fwrite(&VersionMinor, 2, 1, file);
-        fseek(file, 8, SEEK_CUR); // length to be fixed later
+        SaveHeader();
     }
     else
     {
         Saving = false;
-        file = Platform::OpenFile(filename, "rb");
-        if (!file)
+        FILE* f = Platform::OpenFile(filename, "rb");
+        if (!f)
         {
             printf("savestate: file %s doesn't exist\n", filename);
             Error = true;
             return;
         }
 
-        u32 len;
-        fseek(file, 0, SEEK_END);
-        len = (u32)ftell(file);
-        fseek(file, 0, SEEK_SET);
+        fseek(f, 0, SEEK_END);
+        BufferSize = (u32)ftell(f);
+        fseek(f, 0, SEEK_SET);
 
-        u32 buf = 0;
+        Buffer = (u8*)malloc(BufferSize ? BufferSize : 1);
+        Length = fread(Buffer, 1, BufferSize, f);
+        fclose(f);
 
-        fread(&buf, 4, 1, file);
-        if (buf != ((u32*)magic)[0])
+        if (Length >= 16 && !memcmp(Buffer, kCompressedMagic, 4))
         {
-            printf("savestate: invalid magic %08X\n", buf);
-            Error = true;
-            return;
-        }
+            u32 len, complen;
+            memcpy(&len, &Buffer[4], 4);
+            memcpy(&complen, &Buffer[8], 4);
 
-        VersionMajor = 0;
-        VersionMinor = 0;
+            u8* data = (u8*)malloc(len ? len : 1);
+            if (!data || complen > (Length - 16) ||
+                !LZ4::Decompress(&Buffer[16], complen, data, len))
+            {
+                printf("savestate: could not decompress %s\n", filename);
+                if (data) free(data);
+                Error = true;
+                return;
+            }
 
-        fread(&VersionMajor, 2, 1, file);
-        if (VersionMajor != SAVESTATE_MAJOR)
-        {
-            printf("savestate: bad version major %d, expecting %d\n", VersionMajor, SAVESTATE_MAJOR);
-            Error = true;
-            return;
+            free(Buffer);
+            Buffer = data;
+            BufferSize = len;
+            Length = len;
         }
 
-        fread(&VersionMinor, 2, 1, file);
-        // TODO: handle it???
+        LoadHeader();
+    }
+}
 
-        buf = 0;
-        fread(&buf, 4, 1, file);
-        if (buf != len)
-        {
-            printf("savestate: bad length %d\n", buf);
-            Error = true;
-            return;
-        }
+Savestate::Savestate(u8** buffer, u32* bufsize)
+{
+    Error = false;
+    Saving = true;
+
+    file = NULL;
+    Buffer = *buffer;
+    BufferSize = Buffer ? *bufsize : 0;
+    Length = 0;
+    Pos = 0;
+    OwnBuffer = false;
+    OutBuffer = buffer;
+    OutBufferSize = bufsize;
+
+    SaveHeader();
+}
+
+Savestate::Savestate(u8* data, u32 len)
+{
+    Error = false;
+    Saving = false;
+
+    file = NULL;
+    Buffer = data;
+    BufferSize = len;
+    Length = len;
+    Pos = 0;
+    OwnBuffer = false;
+    OutBuffer = NULL;
+    OutBufferSize = NULL;
+
+    LoadHeader();
+}
+
+Savestate::~Savestate()
+{
+    if (Saving && !Error)
+    {
+        EndSection();
+        memcpy(&Buffer[8], &Pos, 4);
 
-        fseek(file, 4, SEEK_CUR);
+        if (file && fwrite(Buffer, Pos, 1, file) != 1)
+            printf("savestate: could not write the file\n");
     }
 
+    if (file) fclose(file);
+
+    if (OutBuffer)
+    {
+        *OutBuffer = Buffer;
+        *OutBufferSize = BufferSize;
+    }
+
+    if (OwnBuffer && Buffer) free(Buffer);
+}
+
+bool Savestate::WriteCompressed(FILE* file, u8* data, u32 len)
+{
+    u8* comp = (u8*)malloc(16 + LZ4::CompressBound(len));
+    if (!comp) return false;
+
+    u32 complen = LZ4::Compress(data, len, &comp[16]);
+
+    memcpy(&comp[0], kCompressedMagic, 4);
+    memcpy(&comp[4], &len, 4);
+    memcpy(&comp[8], &complen, 4);
+    memset(&comp[12], 0, 4);
+
+    bool ret = fwrite(comp, 16 + complen, 1, file) == 1;
+    free(comp);
+    return ret;
+}
+
+void Savestate::SaveHeader()
+{
+    VersionMajor = SAVESTATE_MAJOR;
+    VersionMinor = SAVESTATE_MINOR;
+
+    u32 zero[2] = {0, 0};
+    Write(kSavestateMagic, 4);
+    Write(&VersionMajor, 2);
+    Write(&VersionMinor, 2);
+    Write(zero, 8); // length to be fixed later
+
     CurSection = -1;
 }
 
-Savestate::~Savestate()
+void Savestate::LoadHeader()
 {
-    if (Error) return;
+    u32 buf = 0;
 
-    if (Saving)
+    Read(&buf, 4);
+    if (buf != ((u32*)kSavestateMagic)[0])
     {
-        if (CurSection != -1)
-        {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
+        printf("savestate: invalid magic %08X\n", buf);
+        Error = true;
+        return;
+    }
 
-            u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+    VersionMajor = 0;
+    VersionMinor = 0;
+
+    Read(&VersionMajor, 2);
+    if (VersionMajor != SAVESTATE_MAJOR)
+    {
+        printf("savestate: bad version major %d, expecting %d\n", VersionMajor, SAVESTATE_MAJOR);
+        Error = true;
+        return;
+    }
 
-            fseek(file, pos, SEEK_SET);
+    Read(&VersionMinor, 2);
+    // TODO: handle it???
+
+    buf = 0;
+    Read(&buf, 4);
+    if (buf != Length)
+    {
+        printf("savestate: bad length %d\n", buf);
+        Error = true;
+        return;
+    }
+
+    Pos += 4;
+
+    CurSection = -1;
+}
+
+void Savestate::EndSection()
+{
+    if (CurSection == -1) return;
+
+    u32 len = Pos - CurSection;
+    memcpy(&Buffer[CurSection+4], &len, 4);
+}
+
+void Savestate::Write(const void* data, u32 len)
+{
+    if (Pos + len > BufferSize)
+    {
+        // a full state is several megabytes, so grow in big steps
+        u32 newsize = BufferSize ? BufferSize : 0x100000;
+        while (newsize < Pos + len) newsize <<= 1;
+
+        u8* newbuf = (u8*)realloc(Buffer, newsize);
+        if (!newbuf)
+        {
+            printf("savestate: out of memory\n");
+            Error = true;
+            return;
         }
 
-        fseek(file, 0, SEEK_END);
-        u32 len = (u32)ftell(file);
-        fseek(file, 8, SEEK_SET);
-        fwrite(&len, 4, 1, file);
+        Buffer = newbuf;
+        BufferSize = newsize;
     }
 
-    if (file) fclose(file);
+    memcpy(&Buffer[Pos], data, len);
+    Pos += len;
+}
+
+void Savestate::Read(void* data, u32 len)
+{
+    // like fread(), data past the end is left untouched
+    if (Pos + len > Length)
+    {
+        if (Pos >= Length) return;
+        len = Length - Pos;
+    }
+
+    memcpy(data, &Buffer[Pos], len);
+    Pos += len;
 }
 
 void Savestate::Section(const char* magic)
@@ -159,46 +313,46 @@ void Savestate::Section(const char* magic)
 
     if (Saving)
     {
-        if (CurSection != -1)
-        {
-            u32 pos = (u32)ftell(file);
-            fseek(file, CurSection+4, SEEK_SET);
-
-            u32 len = pos - CurSection;
-            fwrite(&len, 4, 1, file);
+        EndSection();
 
-            fseek(file, pos, SEEK_SET);
-        }
+        CurSection = Pos;
 
-        CurSection = (u32)ftell(file);
-
-        fwrite(magic, 4, 1, file);
-        fseek(file, 12, SEEK_CUR);
+        u32 zero[3] = {0, 0, 0};
+        Write(magic, 4);
+        Write(zero, 12);
     }
     else
     {
-        fseek(file, 0x10, SEEK_SET);
+        Pos = 0x10;
 
         for (;;)
         {
             u32 buf = 0;
 
-            fread(&buf, 4, 1, file);
+            Read(&buf, 4);
             if (buf != ((u32*)magic)[0])
             {
                 if (buf == 0)
                 {
                     printf("savestate: section %s not found. blarg\n", magic);
+                    Pos = Length;
                     return;
                 }
 
                 buf = 0;
-                fread(&buf, 4, 1, file);
-                fseek(file, buf-8, SEEK_CUR);
+                Read(&buf, 4);
+                if (buf < 8 || (buf - 8) > (Length - Pos))
+                {
+                    printf("savestate: bad section length %d\n", buf);
+                    Pos = Length;
+                    return;
+                }
+
+                Pos += buf - 8;
                 continue;
             }
 
-            fseek(file, 12, SEEK_CUR);
+            Pos += 12;
             break;
         }
     }
@@ -210,11 +364,11 @@ void Savestate::Var8(u8* var)
 
     if (Saving)
     {
-        fwrite(var, 1, 1, file);
+        Write(var, 1);
     }
     else
     {
-        fread(var, 1, 1, file);
+        Read(var, 1);
     }
 }
 
@@ -224,11 +378,11 @@ void Savestate::Var16(u16* var)
 
     if (Saving)
     {
-        fwrite(var, 2, 1, file);
+        Write(var, 2);
     }
     else
     {
-        fread(var, 2, 1, file);
+        Read(var, 2);
     }
 }
 
@@ -238,11 +392,11 @@ void Savestate::Var32(u32* var)
 
     if (Saving)
     {
-        fwrite(var, 4, 1, file);
+        Write(var, 4);
     }
     else
     {
-        fread(var, 4, 1, file);
+        Read(var, 4);
     }
 }
 
@@ -252,11 +406,11 @@ void Savestate::Var64(u64* var)
 
     if (Saving)
     {
-        fwrite(var, 8, 1, file);
+        Write(var, 8);
     }
     else
     {
-        fread(var, 8, 1, file);
+        Read(var, 8);
     }
 }
 
@@ -266,10 +420,10 @@ void Savestate::VarArray(void* data, u32 len)
 
     if (Saving)
     {
-        fwrite(data, len, 1, file);
+        Write(data, len);
     }
     else
     {
-        fread(data, len, 1, file);
+        Read(data, len);
     }
 }
@@ -29,8 +29,21 @@ class Savestate
 {
 public:
     Savestate(const char* filename, bool save);
+
+    // in-memory savestates
+    // saving: the state is written to *buffer, which must come from malloc()
+    // (or be NULL) and is grown with realloc() as needed. its new address and
+    // size are written back to buffer and bufsize.
+    Savestate(u8** buffer, u32* bufsize);
+    // loading: the state is read from data, which stays owned by the caller
+    Savestate(u8* data, u32 len);
+
     ~Savestate();
 
+    // writes a state built in memory to a file, compressed
+    // the loading side accepts both compressed and uncompressed files
+    static bool WriteCompressed(FILE* file, u8* data, u32 len);
+
     bool Error;
 
     bool Saving;
@@ -48,6 +61,9 @@ public:
 
     void VarArray(void* data, u32 len);
 
+    // length of the state data written or read so far
+    u32 GetLength() { return Pos; }
+
     bool IsAtleastVersion(u32 major, u32 minor)
     {
         if (VersionMajor > major) return true;
@@ -57,6 +73,24 @@ public:
 
 private:
     FILE* file;
+
+    // the state is always built/parsed in memory
+    // file savestates are written out in one go once done
+    u8* Buffer;
+    u32 BufferSize;
+    u32 Length;
+    u32 Pos;
+
+    bool OwnBuffer;
+    u8** OutBuffer;
+    u32* OutBufferSize;
+
+    void SaveHeader();
+    void LoadHeader();
+    void EndSection();
+
+    void Write(const void* data, u32 len);
+    void Read(void* data, u32 len);
 };
 
 #endif // SAVESTATE_H
@@ -22,6 +22,7 @@
 #include "SPI.h"
 #include "Wifi.h"
 #include "WifiAP.h"
+#include "WifiNet.h"
 #include "Platform.h"
 
 
@@ -128,12 +129,15 @@ bool Init()
     LANInited = false;
 
     WifiAP::Init();
+    WifiNet::Init();
 
     return true;
 }
 
 void DeInit()
 {
+    WifiNet::DeInit();
+
     if (MPInited)
         Platform::MP_DeInit();
     if (LANInited)
@@ -499,7 +503,7 @@ void SendMPDefaultReply()
 	*(u16*)&reply[0xC + 0x16] = IOPORT(W_TXSeqNo) << 4;
 	*(u32*)&reply[0xC + 0x18] = 0;
 
-	int txlen = Platform::MP_SendPacket(reply, 12+28);
+	int txlen = WifiNet::MP_SendPacket(reply, 12+28);
 	WIFI_LOG("wifi: sent %d/40 bytes of MP default reply\n", txlen);
 }
 
@@ -529,7 +533,7 @@ void SendMPAck()
 	*(u16*)&ack[0xC + 0x1A] = 0;
 	*(u32*)&ack[0xC + 0x1C] = 0;
 
-	int txlen = Platform::MP_SendPacket(ack, 12+32);
+	int txlen = WifiNet::MP_SendPacket(ack, 12+32);
 	WIFI_LOG("wifi: sent %d/44 bytes of MP ack, %d %d\n", txlen, ComStatus, RXTime);
 }
 
@@ -654,7 +658,7 @@ bool ProcessTX(TXSlot* slot, int num)
             IOPORT(W_RXTXAddr) = slot->Addr >> 1;
 
             // send
-            int txlen = Platform::MP_SendPacket(&RAM[slot->Addr], 12 + slot->Length);
+            int txlen = WifiNet::MP_SendPacket(&RAM[slot->Addr], 12 + slot->Length);
             WIFI_LOG("wifi: sent %d/%d bytes of slot%d packet, addr=%04X, framectl=%04X, %04X %04X\n",
                      txlen, slot->Length+12, num, slot->Addr, *(u16*)&RAM[slot->Addr + 0xC],
                      *(u16*)&RAM[slot->Addr + 0x24], *(u16*)&RAM[slot->Addr + 0x26]);
@@ -822,7 +826,7 @@ bool CheckRX(bool block)
 
     for (;;)
     {
-        int rxlen = Platform::MP_RecvPacket(RXBuffer, block);
+        int rxlen = WifiNet::MP_RecvPacket(RXBuffer, block);
         if (rxlen == 0) rxlen = WifiAP::RecvPacket(RXBuffer);
         if (rxlen == 0) return false;
         if (rxlen < 12+24) continue;
@@ -1361,6 +1365,7 @@ void Write(u32 addr, u16 val)
                 Platform::LAN_Init();
                 LANInited = true;
             }
+            WifiNet::Start(MPInited, LANInited);
         }
         else if (!(IOPORT(W_PowerUS) & 0x0001) && (val & 0x0001))
         {
@@ -21,7 +21,7 @@
 #include "NDS.h"
 #include "Wifi.h"
 #include "WifiAP.h"
-#include "Platform.h"
+#include "WifiNet.h"
 
 #ifndef __WIN32__
 #include <stddef.h>
@@ -321,7 +321,7 @@ int SendPacket(u8* data, int len)
                 *(u16*)&LANBuffer[12] = *(u16*)&data[30]; // type
                 memcpy(&LANBuffer[14], &data[32], lan_len - 14);
 
-                Platform::LAN_SendPacket(LANBuffer, lan_len);
+                WifiNet::LAN_SendPacket(LANBuffer, lan_len);
             }
         }
         return len;
@@ -388,7 +388,7 @@ int RecvPacket(u8* data)
 
     if (ClientStatus < 2) return 0;
 
-    int rxlen = Platform::LAN_RecvPacket(LANBuffer);
+    int rxlen = WifiNet::LAN_RecvPacket(LANBuffer);
     if (rxlen > 0)
     {
         // check destination MAC
@@ -0,0 +1,258 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "WifiNet.h"
+#include "Platform.h"
+
+
+namespace WifiNet
+{
+
+const int kQueueSize = 64; // must be a power of two
+const int kPacketSize = 2048;
+
+// Head is only written by the producer, Tail only by the consumer
+struct PacketQueue
+{
+    u8 Data[kQueueSize][kPacketSize];
+    u16 Length[kQueueSize];
+    std::atomic<u32> Head;
+    std::atomic<u32> Tail;
+
+    void Clear()
+    {
+        Head.store(0);
+        Tail.store(0);
+    }
+
+    // only meaningful to the producer
+    bool Full()
+    {
+        return (Head.load(std::memory_order_relaxed) - Tail.load(std::memory_order_acquire)) >= kQueueSize;
+    }
+
+    bool Push(u8* data, int len)
+    {
+        if (len <= 0 || len > kPacketSize) return false;
+
+        u32 head = Head.load(std::memory_order_relaxed);
+        if (head - Tail.load(std::memory_order_acquire) >= kQueueSize)
+            return false;
+
+        u32 slot = head & (kQueueSize-1);
+        memcpy(Data[slot], data, len);
+        Length[slot] = len;
+        Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    int Pop(u8* data)
+    {
+        u32 tail = Tail.load(std::memory_order_relaxed);
+        if (tail == Head.load(std::memory_order_acquire))
+            return 0;
+
+        u32 slot = tail & (kQueueSize-1);
+        int len = Length[slot];
+        memcpy(data, Data[slot], len);
+        Tail.store(tail + 1, std::memory_order_release);
+        return len;
+    }
+};
+
+PacketQueue MPTX, MPRX;
+PacketQueue LANTX, LANRX;
+
+void* Thread;
+std::atomic<bool> Running;
+bool MPEnabled, LANEnabled;
+
+// posted when there are packets to send
+void* Sema_Wake;
+// posted when a MP packet is received
+void* Sema_MPRX;
+
+u8 Buffer[kPacketSize];
+
+
+bool Init()
+{
+    Thread = NULL;
+    Running = false;
+    MPEnabled = false;
+    LANEnabled = false;
+
+    Sema_Wake = Platform::Semaphore_Create();
+    Sema_MPRX = Platform::Semaphore_Create();
+
+    return true;
+}
+
+void DeInit()
+{
+    Stop();
+
+    Platform::Semaphore_Free(Sema_Wake);
+    Platform::Semaphore_Free(Sema_MPRX);
+}
+
+
+void ThreadFunc()
+{
+    while (Running)
+    {
+        bool busy = false;
+        int len;
+
+        while ((len = MPTX.Pop(Buffer)))
+        {
+            Platform::MP_SendPacket(Buffer, len);
+            busy = true;
+        }
+        while ((len = LANTX.Pop(Buffer)))
+        {
+            Platform::LAN_SendPacket(Buffer, len);
+            busy = true;
+        }
+
+        // packets are only received while there is room for them, the rest
+        // stays in the backend (the LAN backend reads TCP data as it's taken)
+        if (MPEnabled)
+        {
+            while (!MPRX.Full() && (len = Platform::MP_RecvPacket(Buffer, false)))
+            {
+                if (MPRX.Push(Buffer, len))
+                    Platform::Semaphore_Post(Sema_MPRX);
+                busy = true;
+            }
+        }
+        if (LANEnabled)
+        {
+            while (!LANRX.Full() && (len = Platform::LAN_RecvPacket(Buffer)))
+            {
+                LANRX.Push(Buffer, len);
+                busy = true;
+            }
+        }
+
+        // nothing to do: sleep until something is sent, polling the sockets
+        // every millisecond
+        if (!busy)
+            Platform::Semaphore_WaitTimeout(Sema_Wake, 1);
+    }
+}
+
+void Start(bool mp, bool lan)
+{
+    if (Thread) return;
+
+    MPEnabled = mp;
+    LANEnabled = lan;
+
+    Platform::Semaphore_Reset(Sema_Wake);
+    Platform::Semaphore_Reset(Sema_MPRX);
+
+    MPTX.Clear(); MPRX.Clear();
+    LANTX.Clear(); LANRX.Clear();
+
+    Running = true;
+    Thread = Platform::Thread_Create(ThreadFunc);
+}
+
+void Stop()
+{
+    if (!Thread) return;
+
+    Running = false;
+    Platform::Semaphore_Post(Sema_Wake);
+    Platform::Thread_Wait(Thread);
+    Platform::Thread_Free(Thread);
+    Thread = NULL;
+}
+
+void Restart(bool mp)
+{
+    bool running = (Thread != NULL);
+    Stop();
+
+    if (mp)
+    {
+        Platform::MP_DeInit();
+        Platform::MP_Init();
+    }
+
+    Platform::LAN_DeInit();
+    Platform::LAN_Init();
+
+    if (running)
+        Start(MPEnabled, LANEnabled);
+}
+
+
+int MP_SendPacket(u8* data, int len)
+{
+    if (!Thread) return 0;
+
+    if (!MPTX.Push(data, len))
+        return 0;
+
+    Platform::Semaphore_Post(Sema_Wake);
+    return len;
+}
+
+int MP_RecvPacket(u8* data, bool block)
+{
+    if (!Thread) return 0;
+
+    if (!block)
+        return MPRX.Pop(data);
+
+    // the semaphore is reset before checking the queue, so a packet pushed
+    // in between still wakes us up
+    Platform::Semaphore_Reset(Sema_MPRX);
+    int len = MPRX.Pop(data);
+    if (len) return len;
+
+    if (!Platform::Semaphore_WaitTimeout(Sema_MPRX, 5))
+        return 0;
+
+    return MPRX.Pop(data);
+}
+
+int LAN_SendPacket(u8* data, int len)
+{
+    if (!Thread) return 0;
+
+    if (!LANTX.Push(data, len))
+        return 0;
+
+    Platform::Semaphore_Post(Sema_Wake);
+    return len;
+}
+
+int LAN_RecvPacket(u8* data)
+{
+    if (!Thread) return 0;
+
+    return LANRX.Pop(data);
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef WIFINET_H
+#define WIFINET_H
+
+#include "types.h"
+
+// network I/O thread
+//
+// all calls to the Platform MP/LAN interface are done from a separate thread,
+// so the emulation thread never waits on sockets. packets go through
+// single-producer/single-consumer queues, one per direction and interface.
+// when a queue is full, further packets are dropped, like a busy network would.
+
+namespace WifiNet
+{
+
+bool Init();
+void DeInit();
+
+// starts the I/O thread, if it isn't running yet
+// to be called once the Platform interfaces are initialized
+void Start(bool mp, bool lan);
+// stops the I/O thread, before the Platform interfaces are deinitialized
+void Stop();
+// reinitializes the Platform interfaces after their settings were changed
+// (MP only if mp is set), with the I/O thread stopped meanwhile
+void Restart(bool mp);
+
+// same semantics as the Platform functions
+// with block set, waits up to 5ms for a packet to come in
+int MP_SendPacket(u8* data, int len);
+int MP_RecvPacket(u8* data, bool block);
+
+int LAN_SendPacket(u8* data, int len);
+int LAN_RecvPacket(u8* data);
+
+}
+
+#endif // WIFINET_H
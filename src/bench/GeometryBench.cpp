@@ -0,0 +1,211 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "../types.h"
+#include "../GPU3D.h"
+#include "GeometryBench.h"
+
+
+const int kNumInputs = 1024;
+
+typedef struct
+{
+    s32 Matrix[16];
+    s32 Params[16];
+    s16 Vertex[3];
+    s16 Normal[3];
+    s16 LightDir[4][3];
+
+} GeometryInput;
+
+typedef struct
+{
+    s32 Mult4x4[16];
+    s32 Mult4x3[16];
+    s32 Mult3x3[16];
+    s32 Position[4];
+    s32 Normal[3];
+    s32 Diffuse[4];
+    s32 Shine[4];
+
+} GeometryOutput;
+
+typedef struct
+{
+    const char* Name;
+    void (*MatrixMult4x4)(s32* m, s32* s);
+    void (*MatrixMult4x3)(s32* m, s32* s);
+    void (*MatrixMult3x3)(s32* m, s32* s);
+    void (*TransformVertex)(s32* out, s16* vertex, s32* m);
+    void (*TransformNormal)(s32* out, s16* normal, s32* m);
+    void (*LightLevels)(s32* diff, s32* shine, s32* normal, s16 (*lightdir)[3], u32 mask);
+
+} GeometryImpl;
+
+const GeometryImpl kScalarImpl =
+{
+    "scalar",
+    GPU3D::MatrixMult4x4_Scalar,
+    GPU3D::MatrixMult4x3_Scalar,
+    GPU3D::MatrixMult3x3_Scalar,
+    GPU3D::TransformVertex_Scalar,
+    GPU3D::TransformNormal_Scalar,
+    GPU3D::LightLevels_Scalar,
+};
+
+#ifdef GPU3D_SIMD
+const GeometryImpl kSIMDImpl =
+{
+    GPU3D_SIMD,
+    GPU3D::MatrixMult4x4_SIMD,
+    GPU3D::MatrixMult4x3_SIMD,
+    GPU3D::MatrixMult3x3_SIMD,
+    GPU3D::TransformVertex_SIMD,
+    GPU3D::TransformNormal_SIMD,
+    GPU3D::LightLevels_SIMD,
+};
+#endif
+
+GeometryInput Inputs[kNumInputs];
+
+
+u32 RandState;
+
+u32 Rand()
+{
+    // xorshift32
+    RandState ^= RandState << 13;
+    RandState ^= RandState >> 17;
+    RandState ^= RandState << 5;
+    return RandState;
+}
+
+s32 RandRange(s32 range)
+{
+    return (s32)(Rand() % (2*range + 1)) - range;
+}
+
+void MakeInputs()
+{
+    RandState = 0x3D3D3D3D;
+
+    for (int i = 0; i < kNumInputs; i++)
+    {
+        GeometryInput* in = &Inputs[i];
+
+        // 20.12 values, a bit beyond what games use
+        for (int j = 0; j < 16; j++)
+        {
+            in->Matrix[j] = RandRange(0x40000);
+            in->Params[j] = RandRange(0x40000);
+        }
+
+        // normals and light directions are 10-bit, shifted left by 3
+        for (int j = 0; j < 3; j++)
+        {
+            in->Vertex[j] = (s16)Rand();
+            in->Normal[j] = RandRange(0x200) << 3;
+            for (int l = 0; l < 4; l++)
+                in->LightDir[l][j] = RandRange(0x200) << 3;
+        }
+
+        // the normal transform and lighting are done on 32 bits, keep their
+        // inputs small enough to not overflow
+        for (int j = 0; j < 12; j++)
+            in->Matrix[j] >>= 5;
+    }
+}
+
+void RunImpl(const GeometryImpl* impl, GeometryInput* in, GeometryOutput* out)
+{
+    memcpy(out->Mult4x4, in->Matrix, 16*4);
+    impl->MatrixMult4x4(out->Mult4x4, in->Params);
+    memcpy(out->Mult4x3, in->Matrix, 16*4);
+    impl->MatrixMult4x3(out->Mult4x3, in->Params);
+    memcpy(out->Mult3x3, in->Matrix, 16*4);
+    impl->MatrixMult3x3(out->Mult3x3, in->Params);
+
+    impl->TransformVertex(out->Position, in->Vertex, in->Matrix);
+    impl->TransformNormal(out->Normal, in->Normal, in->Matrix);
+
+    // the SIMD version always does all four lights
+    impl->LightLevels(out->Diffuse, out->Shine, out->Normal, in->LightDir, 0xF);
+}
+
+double TimeImpl(const GeometryImpl* impl, int iterations)
+{
+    GeometryOutput out;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; n++)
+    {
+        for (int i = 0; i < kNumInputs; i++)
+            RunImpl(impl, &Inputs[i], &out);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double time = std::chrono::duration<double>(end - start).count();
+    printf("  %-8s %10.3f ms, %8.2f ns per vertex\n",
+           impl->Name, time*1000.0, (time*1000000000.0) / ((double)iterations*kNumInputs));
+    return time;
+}
+
+bool RunGeometryBench(int iterations)
+{
+    MakeInputs();
+
+    printf("geometry engine math, %d iterations over %d inputs\n", iterations, kNumInputs);
+    printf("(4x4, 4x3 and 3x3 matrix multiply, vertex and normal transform, 4 lights)\n");
+
+#ifdef GPU3D_SIMD
+    bool match = true;
+    for (int i = 0; i < kNumInputs; i++)
+    {
+        GeometryOutput ref, res;
+        memset(&ref, 0, sizeof(ref));
+        memset(&res, 0, sizeof(res));
+
+        RunImpl(&kScalarImpl, &Inputs[i], &ref);
+        RunImpl(&kSIMDImpl, &Inputs[i], &res);
+
+        if (memcmp(&ref, &res, sizeof(ref)))
+        {
+            printf("mismatch between scalar and %s results for input %d\n", GPU3D_SIMD, i);
+            match = false;
+            break;
+        }
+    }
+
+    if (match)
+        printf("scalar and %s results match\n", GPU3D_SIMD);
+
+    double scalartime = TimeImpl(&kScalarImpl, iterations);
+    double simdtime = TimeImpl(&kSIMDImpl, iterations);
+    printf("speedup: %.2fx\n", scalartime / simdtime);
+
+    return match;
+#else
+    printf("built without SSE4.1/AVX2 support, timing the scalar version only\n");
+    TimeImpl(&kScalarImpl, iterations);
+    return true;
+#endif
+}
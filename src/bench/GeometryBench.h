@@ -0,0 +1,27 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#ifndef GEOMETRYBENCH_H
+#define GEOMETRYBENCH_H
+
+// runs the geometry engine math on random inputs, checks that the SIMD
+// versions match the plain ones and times both
+// returns false if they don't match
+bool RunGeometryBench(int iterations);
+
+#endif // GEOMETRYBENCH_H
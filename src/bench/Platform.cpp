@@ -0,0 +1,224 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "../Platform.h"
+#include "../Config.h"
+
+
+extern char* EmuDirectory;
+
+
+namespace Config
+{
+
+// no frontend settings
+ConfigEntry PlatformConfigFile[] =
+{
+    {"", -1, NULL, 0, NULL, 0}
+};
+
+}
+
+
+namespace Platform
+{
+
+typedef struct
+{
+    std::mutex Lock;
+    std::condition_variable Cond;
+    int Count;
+
+} Semaphore;
+
+
+void StopEmu()
+{
+}
+
+
+FILE* OpenFile(const char* path, const char* mode, bool mustexist)
+{
+    FILE* ret;
+
+    if (mustexist)
+    {
+        ret = fopen(path, "rb");
+        if (ret) ret = freopen(path, mode, ret);
+    }
+    else
+        ret = fopen(path, mode);
+
+    return ret;
+}
+
+FILE* OpenLocalFile(const char* path, const char* mode)
+{
+    // current working directory first, then where the executable is
+    FILE* f = OpenFile(path, mode, true);
+    if (f) return f;
+
+    if (path[0] == '/' || path[0] == '\\' || (path[0] && path[1] == ':'))
+        return NULL;
+
+    int emudirlen = strlen(EmuDirectory);
+    int pathlen = strlen(path);
+    char* emudirpath = new char[emudirlen + 1 + pathlen + 1];
+    strcpy(emudirpath, EmuDirectory);
+    emudirpath[emudirlen] = '/';
+    strcpy(&emudirpath[emudirlen+1], path);
+
+    f = OpenFile(emudirpath, mode, true);
+
+    // files that are written get created next to the executable
+    if (!f && mode[0] != 'r')
+        f = OpenFile(emudirpath, mode);
+
+    delete[] emudirpath;
+    return f;
+}
+
+bool RenameFile(const char* oldpath, const char* newpath)
+{
+    return rename(oldpath, newpath) == 0;
+}
+
+bool RemoveFile(const char* path)
+{
+    return remove(path) == 0;
+}
+
+
+void* Thread_Create(void (*func)())
+{
+    return new std::thread(func);
+}
+
+void Thread_Free(void* thread)
+{
+    delete (std::thread*)thread;
+}
+
+void Thread_Wait(void* thread)
+{
+    ((std::thread*)thread)->join();
+}
+
+
+void* Semaphore_Create()
+{
+    Semaphore* sema = new Semaphore;
+    sema->Count = 0;
+    return sema;
+}
+
+void Semaphore_Free(void* sema)
+{
+    delete (Semaphore*)sema;
+}
+
+void Semaphore_Reset(void* sema)
+{
+    Semaphore* s = (Semaphore*)sema;
+    std::lock_guard<std::mutex> lock(s->Lock);
+    s->Count = 0;
+}
+
+void Semaphore_Wait(void* sema)
+{
+    Semaphore* s = (Semaphore*)sema;
+    std::unique_lock<std::mutex> lock(s->Lock);
+    while (s->Count == 0)
+        s->Cond.wait(lock);
+    s->Count--;
+}
+
+bool Semaphore_WaitTimeout(void* sema, int timeout)
+{
+    Semaphore* s = (Semaphore*)sema;
+    std::unique_lock<std::mutex> lock(s->Lock);
+    if (!s->Cond.wait_for(lock, std::chrono::milliseconds(timeout), [s]{ return s->Count != 0; }))
+        return false;
+    s->Count--;
+    return true;
+}
+
+void Semaphore_Post(void* sema)
+{
+    Semaphore* s = (Semaphore*)sema;
+    std::lock_guard<std::mutex> lock(s->Lock);
+    s->Count++;
+    s->Cond.notify_one();
+}
+
+
+void* GL_GetProcAddress(const char* proc)
+{
+    return NULL;
+}
+
+
+// no networking: wifi behaves as if there was nobody around
+
+bool MP_Init()
+{
+    return false;
+}
+
+void MP_DeInit()
+{
+}
+
+int MP_SendPacket(u8* data, int len)
+{
+    return 0;
+}
+
+int MP_RecvPacket(u8* data, bool block)
+{
+    return 0;
+}
+
+
+bool LAN_Init()
+{
+    return false;
+}
+
+void LAN_DeInit()
+{
+}
+
+int LAN_SendPacket(u8* data, int len)
+{
+    return 0;
+}
+
+int LAN_RecvPacket(u8* data)
+{
+    return 0;
+}
+
+
+}
@@ -0,0 +1,294 @@
+/*
+    Copyright 2016-2019 Arisotura
+
+    This file is part of melonDS.
+
+    melonDS is free software: you can redistribute it and/or modify it under
+    the terms of the GNU General Public License as published by the Free
+    Software Foundation, either version 3 of the License, or (at your option)
+    any later version.
+
+    melonDS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with melonDS. If not, see http://www.gnu.org/licenses/.
+*/
+
+// headless benchmark runner
+// runs a game for a fixed amount of frames as fast as possible, without any
+// UI, audio device or frame limiter, then reports the speed and hashes of
+// the video/audio output (to check that a change doesn't alter emulation)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "../version.h"
+#include "../types.h"
+#include "../Config.h"
+#include "../NDS.h"
+#include "../GPU.h"
+#include "../SPU.h"
+#include "../Savestate.h"
+#include "../Rewind.h"
+#include "../Profiler.h"
+#include "GeometryBench.h"
+
+
+char* EmuDirectory;
+
+const double kNativeFPS = 59.8261;
+
+
+typedef struct
+{
+    const char* ROMPath;
+    const char* SRAMPath;
+    const char* StatePath;
+    int NumFrames;
+    int CPUBackend;
+    int GeometryIterations;
+    int RewindInterval;
+    bool DirectBoot;
+    const char* ProfilePath;
+    const char* TracePath;
+
+} BenchOptions;
+
+
+void Usage()
+{
+    printf("usage: melonDS-bench [options] <rom.nds>\n");
+    printf("       melonDS-bench -g <iterations>\n");
+    printf("  -n <frames>    number of frames to run (default: 1000)\n");
+    printf("  -s <file.mln>  savestate to load before running\n");
+    printf("  -S <file.sav>  save memory file (default: none, saves are discarded)\n");
+    printf("  -c <backend>   CPU emulation: 0=interpreter, 1=cached interpreter, 2=JIT\n");
+    printf("  -b             boot through the firmware instead of booting the game directly\n");
+    printf("  -r <frames>    take a rewind snapshot every <frames> frames and time it\n");
+    printf("  -g <count>     benchmark the geometry engine math instead of running a game\n");
+#ifdef ENABLE_PROFILER
+    printf("  -p <file.json>  write per-frame profiler counters (JSON lines)\n");
+    printf("  -t <file.json>  write a Chrome trace (chrome://tracing, Perfetto)\n");
+#endif
+    printf("BIOS and firmware files are looked for in the current directory, then\n");
+    printf("next to the executable. melonDS.ini is used if present.\n");
+}
+
+bool ParseOptions(int argc, char** argv, BenchOptions* opt)
+{
+    opt->ROMPath = NULL;
+    opt->SRAMPath = "";
+    opt->StatePath = NULL;
+    opt->NumFrames = 1000;
+    opt->CPUBackend = -1;
+    opt->GeometryIterations = 0;
+    opt->RewindInterval = 0;
+    opt->DirectBoot = true;
+    opt->ProfilePath = NULL;
+    opt->TracePath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+
+        if (arg[0] != '-')
+        {
+            if (opt->ROMPath) return false;
+            opt->ROMPath = arg;
+            continue;
+        }
+
+        if (!strcmp(arg, "-b"))
+        {
+            opt->DirectBoot = false;
+            continue;
+        }
+
+        if (i+1 >= argc) return false;
+        const char* val = argv[++i];
+
+        if      (!strcmp(arg, "-n")) opt->NumFrames = atoi(val);
+        else if (!strcmp(arg, "-s")) opt->StatePath = val;
+        else if (!strcmp(arg, "-S")) opt->SRAMPath = val;
+        else if (!strcmp(arg, "-c")) opt->CPUBackend = atoi(val);
+        else if (!strcmp(arg, "-g")) opt->GeometryIterations = atoi(val);
+        else if (!strcmp(arg, "-r")) opt->RewindInterval = atoi(val);
+#ifdef ENABLE_PROFILER
+        else if (!strcmp(arg, "-p")) opt->ProfilePath = val;
+        else if (!strcmp(arg, "-t")) opt->TracePath = val;
+#endif
+        else return false;
+    }
+
+    if (opt->GeometryIterations > 0) return true;
+    if (!opt->ROMPath) return false;
+    if (opt->NumFrames < 1) return false;
+    if (opt->CPUBackend > 2) return false;
+
+    return true;
+}
+
+
+// FNV-1a
+u64 Hash(const void* data, u32 len, u64 hash)
+{
+    const u8* ptr = (const u8*)data;
+    for (u32 i = 0; i < len; i++)
+    {
+        hash ^= ptr[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+
+int main(int argc, char** argv)
+{
+    printf("melonDS-bench " MELONDS_VERSION "\n");
+
+    BenchOptions opt;
+    if (!ParseOptions(argc, argv, &opt))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (opt.GeometryIterations > 0)
+        return RunGeometryBench(opt.GeometryIterations) ? 0 : 1;
+
+    int len = strlen(argv[0]);
+    while (len > 0 && argv[0][len] != '/' && argv[0][len] != '\\') len--;
+    EmuDirectory = new char[len > 0 ? len+1 : 2];
+    if (len > 0)
+    {
+        strncpy(EmuDirectory, argv[0], len);
+        EmuDirectory[len] = '\0';
+    }
+    else
+        strcpy(EmuDirectory, ".");
+
+    Config::Load();
+    if (opt.CPUBackend >= 0)
+        Config::CPUBackend = opt.CPUBackend;
+    Config::RewindInterval = opt.RewindInterval;
+
+    if (!NDS::Init())
+    {
+        printf("failed to init the emulator\n");
+        return 1;
+    }
+    GPU3D::InitRenderer(false);
+
+    if (!NDS::LoadROM(opt.ROMPath, opt.SRAMPath, opt.DirectBoot))
+        return 1;
+
+    if (opt.StatePath)
+    {
+        Savestate* state = new Savestate(opt.StatePath, false);
+        if (state->Error)
+        {
+            printf("could not load savestate %s\n", opt.StatePath);
+            delete state;
+            return 1;
+        }
+
+        NDS::DoSavestate(state);
+        delete state;
+    }
+
+#ifdef ENABLE_PROFILER
+    if (opt.ProfilePath && !Profiler::OpenJSON(opt.ProfilePath)) return 1;
+    if (opt.TracePath && !Profiler::OpenTrace(opt.TracePath)) return 1;
+    Profiler::Reset();
+#endif
+
+    printf("running %d frames, CPU backend %d\n", opt.NumFrames, Config::CPUBackend);
+
+    u64 fbhash = 0xCBF29CE484222325ULL;
+    u64 audiohash = 0xCBF29CE484222325ULL;
+    u64 numsamples = 0;
+    s16 audiobuf[1024*2];
+
+    double totaltime = 0;
+    double mintime = 1e9, maxtime = 0;
+    double rewindtime = 0;
+
+    for (int i = 0; i < opt.NumFrames; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        NDS::RunFrame();
+        auto end = std::chrono::steady_clock::now();
+
+        double frametime = std::chrono::duration<double>(end - start).count();
+        totaltime += frametime;
+        if (frametime < mintime) mintime = frametime;
+        if (frametime > maxtime) maxtime = frametime;
+
+        if (opt.RewindInterval > 0)
+        {
+            start = std::chrono::steady_clock::now();
+            Rewind::Frame();
+            end = std::chrono::steady_clock::now();
+            rewindtime += std::chrono::duration<double>(end - start).count();
+        }
+
+        fbhash = Hash(GPU::Framebuffer[GPU::FrontBuffer][0], 256*192*4, fbhash);
+        fbhash = Hash(GPU::Framebuffer[GPU::FrontBuffer][1], 256*192*4, fbhash);
+
+        for (;;)
+        {
+            int num = SPU::ReadOutput(audiobuf, 1024);
+            if (num < 1) break;
+
+            audiohash = Hash(audiobuf, num*2*sizeof(s16), audiohash);
+            numsamples += num;
+        }
+    }
+
+    double fps = opt.NumFrames / totaltime;
+
+    printf("time: %.3f s, %.2f fps (%.1f%% of native speed)\n",
+           totaltime, fps, (fps * 100.0) / kNativeFPS);
+    printf("frame time: min %.3f ms, avg %.3f ms, max %.3f ms\n",
+           mintime*1000.0, (totaltime*1000.0) / opt.NumFrames, maxtime*1000.0);
+    printf("idle loop cycles skipped: ARM9 %llu, ARM7 %llu\n",
+           (unsigned long long)NDS::IdleSkippedCycles[0],
+           (unsigned long long)NDS::IdleSkippedCycles[1]);
+    if (opt.RewindInterval > 0)
+    {
+        u32 numsnapshots = opt.NumFrames / opt.RewindInterval;
+        printf("rewind: %u snapshots taken, avg %.3f ms, %u kept in %.1f KB\n",
+               numsnapshots, numsnapshots ? (rewindtime*1000.0) / numsnapshots : 0.0,
+               Rewind::NumSnapshots(), Rewind::MemoryUsed() / 1024.0);
+    }
+    printf("framebuffer hash: %016llX\n", (unsigned long long)fbhash);
+    printf("audio hash: %016llX (%llu samples)\n",
+           (unsigned long long)audiohash, (unsigned long long)numsamples);
+
+#ifdef ENABLE_PROFILER
+    // sections nest, so these don't add up to 100%
+    Profiler::Counter counters[Profiler::Section_MAX];
+    Profiler::GetTotalCounters(counters);
+
+    printf("profile:\n");
+    for (u32 i = 0; i < Profiler::Section_MAX; i++)
+    {
+        if (!counters[i].Calls) continue;
+
+        double ms = counters[i].Time / 1000000.0;
+        printf("  %-20s %10.3f ms %10llu calls %6.1f%%\n",
+               Profiler::GetSectionName(i), ms,
+               (unsigned long long)counters[i].Calls,
+               (ms * 100.0) / (totaltime*1000.0));
+    }
+#endif
+
+    NDS::DeInit();
+
+    delete[] EmuDirectory;
+    return 0;
+}
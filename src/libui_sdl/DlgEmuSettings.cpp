@@ -37,6 +37,8 @@ bool opened;
 uiWindow* win;
 
 uiCheckbox* cbDirectBoot;
+uiCombobox* cbCPUBackend;
+uiCheckbox* cbIdleLoopSkip;
 
 
 int OnCloseWindow(uiWindow* window, void* blarg)
@@ -54,6 +56,8 @@ void OnCancel(uiButton* btn, void* blarg)
 void OnOk(uiButton* btn, void* blarg)
 {
     Config::DirectBoot = uiCheckboxChecked(cbDirectBoot);
+    Config::CPUBackend = uiComboboxSelected(cbCPUBackend);
+    Config::IdleLoopSkip = uiCheckboxChecked(cbIdleLoopSkip);
 
     Config::Save();
 
@@ -83,6 +87,18 @@ void Open()
 
         cbDirectBoot = uiNewCheckbox("Boot game directly");
         uiBoxAppend(in_ctrl, uiControl(cbDirectBoot), 0);
+
+        uiLabel* lbl = uiNewLabel("CPU emulation:");
+        uiBoxAppend(in_ctrl, uiControl(lbl), 0);
+
+        cbCPUBackend = uiNewCombobox();
+        uiComboboxAppend(cbCPUBackend, "Interpreter");
+        uiComboboxAppend(cbCPUBackend, "Cached interpreter");
+        uiComboboxAppend(cbCPUBackend, "JIT recompiler");
+        uiBoxAppend(in_ctrl, uiControl(cbCPUBackend), 0);
+
+        cbIdleLoopSkip = uiNewCheckbox("Skip idle loops");
+        uiBoxAppend(in_ctrl, uiControl(cbIdleLoopSkip), 0);
     }
 
     {
@@ -103,6 +119,8 @@ void Open()
     }
 
     uiCheckboxSetChecked(cbDirectBoot, Config::DirectBoot);
+    uiComboboxSetSelected(cbCPUBackend, Config::CPUBackend);
+    uiCheckboxSetChecked(cbIdleLoopSkip, Config::IdleLoopSkip);
 
     uiControlShow(uiControl(win));
 }
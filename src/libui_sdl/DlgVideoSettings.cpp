@@ -40,12 +40,14 @@ uiWindow* win;
 uiRadioButtons* rbRenderer;
 uiCheckbox* cbGLDisplay;
 uiCheckbox* cbThreaded3D;
+uiCheckbox* cbThreaded2D;
 uiCombobox* cbResolution;
 uiCheckbox* cbAntialias;
 
 int old_renderer;
 int old_gldisplay;
 int old_threaded3D;
+int old_threaded2D;
 int old_resolution;
 int old_antialias;
 
@@ -100,6 +102,9 @@ void RevertSettings()
         apply0 = true;
     }
 
+    // picked up at the next frame
+    Config::Threaded2D = old_threaded2D;
+
     if (old_resolution != Config::GL_ScaleFactor ||
         old_antialias != Config::GL_Antialias)
     {
@@ -151,6 +156,11 @@ void OnThreaded3DChanged(uiCheckbox* cb, void* blarg)
     ApplyNewSettings(0);
 }
 
+void OnThreaded2DChanged(uiCheckbox* cb, void* blarg)
+{
+    Config::Threaded2D = uiCheckboxChecked(cb);
+}
+
 void OnResolutionChanged(uiCombobox* cb, void* blarg)
 {
     int id = uiComboboxSelected(cb);
@@ -232,6 +242,10 @@ void Open()
         cbGLDisplay = uiNewCheckbox("OpenGL display");
         uiCheckboxOnToggled(cbGLDisplay, OnGLDisplayChanged, NULL);
         uiBoxAppend(in_ctrl, uiControl(cbGLDisplay), 0);
+
+        cbThreaded2D = uiNewCheckbox("Threaded 2D rendering");
+        uiCheckboxOnToggled(cbThreaded2D, OnThreaded2DChanged, NULL);
+        uiBoxAppend(in_ctrl, uiControl(cbThreaded2D), 0);
     }
 
     {
@@ -301,11 +315,13 @@ void Open()
     old_renderer = Config::_3DRenderer;
     old_gldisplay = Config::ScreenUseGL;
     old_threaded3D = Config::Threaded3D;
+    old_threaded2D = Config::Threaded2D;
     old_resolution = Config::GL_ScaleFactor;
     old_antialias = Config::GL_Antialias;
 
     uiCheckboxSetChecked(cbGLDisplay, Config::ScreenUseGL);
     uiCheckboxSetChecked(cbThreaded3D, Config::Threaded3D);
+    uiCheckboxSetChecked(cbThreaded2D, Config::Threaded2D);
     uiComboboxSetSelected(cbResolution, Config::GL_ScaleFactor-1);
     //uiCheckboxSetChecked(cbAntialias, Config::GL_Antialias);
     uiRadioButtonsSetSelected(rbRenderer, Config::_3DRenderer);
@@ -23,21 +23,27 @@
 #include <string.h>
 #include "../Wifi.h"
 #include "LAN_Socket.h"
-#include "../Config.h"
+#include "PlatformConfig.h"
 
 #ifdef __WIN32__
 	#include <winsock2.h>
 	#include <ws2tcpip.h>
 	#define socket_t    SOCKET
 	#define sockaddr_t  SOCKADDR
+	#define poll        WSAPoll
 #else
 	#include <unistd.h>
 	#include <arpa/inet.h>
 	#include <netinet/in.h>
 	#include <sys/types.h>
-	#include <sys/select.h>
 	#include <sys/socket.h>
 	#include <netdb.h>
+	#ifdef __linux__
+		#include <sys/epoll.h>
+		#define LAN_EPOLL
+	#else
+		#include <poll.h>
+	#endif
 	#define socket_t    int
 	#define sockaddr_t  struct sockaddr
 	#define closesocket close
@@ -59,9 +65,16 @@ const u32 kClientIP = kSubnet | 0x10;
 const u8 kServerMAC[6] = {0x00, 0xAB, 0x33, 0x28, 0x99, 0x44};
 const u8 kDNSMAC[6]    = {0x00, 0xAB, 0x33, 0x28, 0x99, 0x55};
 
-u8 PacketBuffer[2048];
-int PacketLen;
-volatile int RXNum;
+// matches the MSS given to the client in the SYN+ACK
+const int kMSS = 1460;
+
+// frames waiting to be received by the client
+const int kRXQueueSize = 64;
+u8 RXQueue[kRXQueueSize][2048];
+u16 RXQueueLen[kRXQueueSize];
+int RXQueueStart, RXQueueNum;
+
+u8 RecvBuffer[0x10000];
 
 u16 IPv4ID;
 
@@ -80,6 +93,12 @@ typedef struct
     u32 SeqNum; // sequence number for incoming frames
     u32 AckNum;
 
+    // what the client acknowledged, and how much more it can take
+    // incoming data has to stay within that, as it's never retransmitted
+    u32 ClientAck;
+    u32 ClientWindow;
+    u8 ClientWindowShift;
+
     // 0: unused
     // 1: connected
     u8 Status;
@@ -99,11 +118,25 @@ typedef struct
 
 } UDPSocket;
 
-TCPSocket TCPSocketList[16];
-UDPSocket UDPSocketList[4];
+// sizes set by Config::LANTCPSockets and Config::LANUDPSockets
+TCPSocket* TCPSocketList = NULL;
+int NumTCPSockets = 0;
+UDPSocket* UDPSocketList = NULL;
+int NumUDPSockets = 0;
 
 int UDPSocketID = 0;
 
+// backend sockets are watched for incoming data with epoll where available,
+// poll() otherwise. UDP sockets are told apart with kUDPSocketFlag.
+const u32 kUDPSocketFlag = 0x10000;
+
+#ifdef LAN_EPOLL
+int EpollFD = -1;
+#else
+struct pollfd* PollList = NULL;
+u32* PollIDs = NULL;
+#endif
+
 
 bool Init()
 {
@@ -111,35 +144,124 @@ bool Init()
     //if (PCapLib) return true;
 
     //Lib = NULL;
-    PacketLen = 0;
-    RXNum = 0;
+    RXQueueStart = 0;
+    RXQueueNum = 0;
 
     IPv4ID = 1;
 
-    memset(TCPSocketList, 0, sizeof(TCPSocketList));
-    memset(UDPSocketList, 0, sizeof(UDPSocketList));
+    NumTCPSockets = Config::LANTCPSockets;
+    if (NumTCPSockets < 1) NumTCPSockets = 1;
+    else if (NumTCPSockets > 256) NumTCPSockets = 256;
+    NumUDPSockets = Config::LANUDPSockets;
+    if (NumUDPSockets < 1) NumUDPSockets = 1;
+    else if (NumUDPSockets > 64) NumUDPSockets = 64;
+
+    TCPSocketList = (TCPSocket*)calloc(NumTCPSockets, sizeof(TCPSocket));
+    UDPSocketList = (UDPSocket*)calloc(NumUDPSockets, sizeof(UDPSocket));
 
     UDPSocketID = 0;
 
+#ifdef LAN_EPOLL
+    EpollFD = epoll_create1(0);
+    if (EpollFD < 0)
+    {
+        printf("LANMAGIC: epoll_create1() shat itself :(\n");
+        return false;
+    }
+#else
+    PollList = new struct pollfd[NumTCPSockets + NumUDPSockets];
+    PollIDs = new u32[NumTCPSockets + NumUDPSockets];
+#endif
+
     return true;
 }
 
 void DeInit()
 {
-    for (int i = 0; i < (sizeof(TCPSocketList)/sizeof(TCPSocket)); i++)
+    // can be called without Init() having been called
+    if (TCPSocketList)
     {
-        TCPSocket* sock = &TCPSocketList[i];
-        if (sock->Backend) closesocket(sock->Backend);
+        for (int i = 0; i < NumTCPSockets; i++)
+        {
+            TCPSocket* sock = &TCPSocketList[i];
+            if (sock->Backend) closesocket(sock->Backend);
+        }
+
+        free(TCPSocketList);
+        TCPSocketList = NULL;
+        NumTCPSockets = 0;
     }
 
-    for (int i = 0; i < (sizeof(UDPSocketList)/sizeof(UDPSocket)); i++)
+    if (UDPSocketList)
     {
-        UDPSocket* sock = &UDPSocketList[i];
-        if (sock->Backend) closesocket(sock->Backend);
+        for (int i = 0; i < NumUDPSockets; i++)
+        {
+            UDPSocket* sock = &UDPSocketList[i];
+            if (sock->Backend) closesocket(sock->Backend);
+        }
+
+        free(UDPSocketList);
+        UDPSocketList = NULL;
+        NumUDPSockets = 0;
     }
+
+#ifdef LAN_EPOLL
+    if (EpollFD >= 0)
+    {
+        close(EpollFD);
+        EpollFD = -1;
+    }
+#else
+    if (PollList)
+    {
+        delete[] PollList;
+        delete[] PollIDs;
+        PollList = NULL;
+        PollIDs = NULL;
+    }
+#endif
 }
 
 
+void WatchSocket(socket_t sock, u32 id)
+{
+#ifdef LAN_EPOLL
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = id;
+    if (epoll_ctl(EpollFD, EPOLL_CTL_ADD, sock, &ev) < 0)
+        epoll_ctl(EpollFD, EPOLL_CTL_MOD, sock, &ev);
+#endif
+}
+
+void UnwatchSocket(socket_t sock)
+{
+#ifdef LAN_EPOLL
+    struct epoll_event ev;
+    epoll_ctl(EpollFD, EPOLL_CTL_DEL, sock, &ev);
+#endif
+}
+
+
+int RXQueueFree()
+{
+    return kRXQueueSize - RXQueueNum;
+}
+
+void EnqueueFrame(u8* data, int len)
+{
+    if (RXQueueNum >= kRXQueueSize)
+    {
+        printf("LANMAGIC: RX queue full, dropping frame\n");
+        return;
+    }
+
+    int slot = (RXQueueStart + RXQueueNum) % kRXQueueSize;
+    memcpy(RXQueue[slot], data, len);
+    RXQueueLen[slot] = len;
+    RXQueueNum++;
+}
+
 void FinishUDPFrame(u8* data, int len)
 {
     u8* ipheader = &data[0xE];
@@ -328,13 +450,7 @@ void HandleDHCPFrame(u8* data, int len)
         if (framelen & 1) { *out++ = 0; framelen++; }
         FinishUDPFrame(resp, framelen);
 
-        // TODO: if there is already a packet queued, this will overwrite it
-        // that being said, this will only happen during DHCP setup, so probably
-        // not a big deal
-
-        PacketLen = framelen;
-        memcpy(PacketBuffer, resp, PacketLen);
-        RXNum = 1;
+        EnqueueFrame(resp, framelen);
     }
 }
 
@@ -490,13 +606,7 @@ void HandleDNSFrame(u8* data, int len)
     if (framelen & 1) { *out++ = 0; framelen++; }
     FinishUDPFrame(resp, framelen);
 
-    // TODO: if there is already a packet queued, this will overwrite it
-    // that being said, this will only happen during DHCP setup, so probably
-    // not a big deal
-
-    PacketLen = framelen;
-    memcpy(PacketBuffer, resp, PacketLen);
-    RXNum = 1;
+    EnqueueFrame(resp, framelen);
 }
 
 void UDP_BuildIncomingFrame(UDPSocket* sock, u8* data, int len)
@@ -537,13 +647,7 @@ void UDP_BuildIncomingFrame(UDPSocket* sock, u8* data, int len)
     u32 framelen = (u32)(out - &resp[0]);
     FinishUDPFrame(resp, framelen);
 
-    // TODO: if there is already a packet queued, this will overwrite it
-    // that being said, this will only happen during DHCP setup, so probably
-    // not a big deal
-
-    PacketLen = framelen;
-    memcpy(PacketBuffer, resp, PacketLen);
-    RXNum = 1;
+    EnqueueFrame(resp, framelen);
 }
 
 void HandleUDPFrame(u8* data, int len)
@@ -568,7 +672,7 @@ void HandleUDPFrame(u8* data, int len)
 
     int sockid = -1;
     UDPSocket* sock;
-    for (int i = 0; i < (sizeof(UDPSocketList)/sizeof(UDPSocket)); i++)
+    for (int i = 0; i < NumUDPSockets; i++)
     {
         sock = &UDPSocketList[i];
         if (sock->Backend != 0 && !memcmp(&sock->DestIP, &ipheader[16], 4) &&
@@ -585,16 +689,18 @@ void HandleUDPFrame(u8* data, int len)
         sock = &UDPSocketList[sockid];
 
         UDPSocketID++;
-        if (UDPSocketID >= (sizeof(UDPSocketList)/sizeof(UDPSocket)))
+        if (UDPSocketID >= NumUDPSockets)
             UDPSocketID = 0;
 
         if (sock->Backend != 0)
         {
             printf("LANMAGIC: closing previous UDP socket #%d\n", sockid);
+            UnwatchSocket(sock->Backend);
             closesocket(sock->Backend);
         }
 
         sock->Backend = socket(AF_INET, SOCK_DGRAM, 0);
+        WatchSocket(sock->Backend, sockid | kUDPSocketFlag);
 
         memcpy(sock->DestIP, &ipheader[16], 4);
         sock->SourcePort = srcport;
@@ -680,13 +786,7 @@ void TCP_SYNACK(TCPSocket* sock, u8* data, int len)
     //if (framelen & 1) { *out++ = 0; framelen++; }
     FinishTCPFrame(resp, framelen);
 
-    // TODO: if there is already a packet queued, this will overwrite it
-    // that being said, this will only happen during DHCP setup, so probably
-    // not a big deal
-
-    PacketLen = framelen;
-    memcpy(PacketBuffer, resp, PacketLen);
-    RXNum = 1;
+    EnqueueFrame(resp, framelen);
 }
 
 void TCP_ACK(TCPSocket* sock, bool fin)
@@ -733,13 +833,7 @@ void TCP_ACK(TCPSocket* sock, bool fin)
     //if (framelen & 1) { *out++ = 0; framelen++; }
     FinishTCPFrame(resp, framelen);
 
-    // TODO: if there is already a packet queued, this will overwrite it
-    // that being said, this will only happen during DHCP setup, so probably
-    // not a big deal
-
-    PacketLen = framelen;
-    memcpy(PacketBuffer, resp, PacketLen);
-    RXNum = 1;
+    EnqueueFrame(resp, framelen);
 }
 
 void TCP_BuildIncomingFrame(TCPSocket* sock, u8* data, int len)
@@ -784,13 +878,7 @@ void TCP_BuildIncomingFrame(TCPSocket* sock, u8* data, int len)
     u32 framelen = (u32)(out - &resp[0]);
     FinishTCPFrame(resp, framelen);
 
-    // TODO: if there is already a packet queued, this will overwrite it
-    // that being said, this will only happen during DHCP setup, so probably
-    // not a big deal
-
-    PacketLen = framelen;
-    memcpy(PacketBuffer, resp, PacketLen);
-    RXNum = 1;
+    EnqueueFrame(resp, framelen);
 
     sock->SeqNum += len;
 }
@@ -817,7 +905,7 @@ void HandleTCPFrame(u8* data, int len)
     {
         int sockid = -1;
         TCPSocket* sock;
-        for (int i = 0; i < (sizeof(TCPSocketList)/sizeof(TCPSocket)); i++)
+        for (int i = 0; i < NumTCPSockets; i++)
         {
             sock = &TCPSocketList[i];
             if (sock->Status != 0 && !memcmp(&sock->DestIP, &ipheader[16], 4) &&
@@ -831,7 +919,7 @@ void HandleTCPFrame(u8* data, int len)
 
         if (sockid == -1)
         {
-            for (int i = 0; i < (sizeof(TCPSocketList)/sizeof(TCPSocket)); i++)
+            for (int i = 0; i < NumTCPSockets; i++)
             {
                 sock = &TCPSocketList[i];
                 if (sock->Status == 0)
@@ -861,6 +949,27 @@ void HandleTCPFrame(u8* data, int len)
         sock->SeqNum = 0x13370000;
         sock->AckNum = 0;
 
+        // window scaling is only used if the client asks for it
+        // (it is offered in the SYN+ACK)
+        sock->ClientWindowShift = 0;
+        u8* opt = &tcpheader[20];
+        u8* optend = &tcpheader[tcpheaderlen];
+        while (opt < optend && *opt != 0)
+        {
+            if (*opt == 1) { opt++; continue; }
+            if ((opt+1) >= optend || opt[1] < 2) break;
+            if (opt[0] == 3 && opt[1] == 3)
+            {
+                sock->ClientWindowShift = opt[2];
+                if (sock->ClientWindowShift > 14) sock->ClientWindowShift = 14;
+            }
+            opt += opt[1];
+        }
+
+        // the window in a SYN is never scaled
+        sock->ClientAck = sock->SeqNum + 1;
+        sock->ClientWindow = ntohs(*(u16*)&tcpheader[14]);
+
         // open backend socket
         if (!sock->Backend)
         {
@@ -878,6 +987,8 @@ void HandleTCPFrame(u8* data, int len)
         }
         else
         {
+            WatchSocket(sock->Backend, sockid);
+
             // acknowledge it
             TCP_SYNACK(sock, data, len);
         }
@@ -886,7 +997,7 @@ void HandleTCPFrame(u8* data, int len)
     {
         int sockid = -1;
         TCPSocket* sock;
-        for (int i = 0; i < (sizeof(TCPSocketList)/sizeof(TCPSocket)); i++)
+        for (int i = 0; i < NumTCPSockets; i++)
         {
             sock = &TCPSocketList[i];
             if (sock->Status != 0 && !memcmp(&sock->DestIP, &ipheader[16], 4) &&
@@ -906,9 +1017,15 @@ void HandleTCPFrame(u8* data, int len)
         // TODO: check those
         u32 seqnum = ntohl(*(u32*)&tcpheader[4]);
         u32 acknum = ntohl(*(u32*)&tcpheader[8]);
-        sock->SeqNum = acknum;
         sock->AckNum = seqnum + tcpdatalen;
 
+        // segments may still be in flight, so SeqNum isn't moved back to acknum
+        if ((flags & 0x010) && (s32)(acknum - sock->ClientAck) >= 0)
+        {
+            sock->ClientAck = acknum;
+            sock->ClientWindow = ntohs(*(u16*)&tcpheader[14]) << sock->ClientWindowShift;
+        }
+
         // send data over the socket
         if (tcpdatalen > 0)
         {
@@ -927,6 +1044,7 @@ void HandleTCPFrame(u8* data, int len)
             printf("TCP: socket %d closing\n", sockid);
 
             sock->Status = 0;
+            UnwatchSocket(sock->Backend);
             closesocket(sock->Backend);
             sock->Backend = 0;
         }
@@ -977,13 +1095,7 @@ void HandleARPFrame(u8* data, int len)
 
         u32 framelen = (u32)(out - &resp[0]);
 
-        // TODO: if there is already a packet queued, this will overwrite it
-        // that being said, this will only happen during DHCP setup, so probably
-        // not a big deal
-
-        PacketLen = framelen;
-        memcpy(PacketBuffer, resp, PacketLen);
-        RXNum = 1;
+        EnqueueFrame(resp, framelen);
     }
     else
     {
@@ -1045,101 +1157,139 @@ int SendPacket(u8* data, int len)
     return len;
 }
 
-int RecvPacket(u8* data)
+void TCP_Receive(int id)
 {
-    int ret = 0;
-    if (RXNum > 0)
-    {
-        memcpy(data, PacketBuffer, PacketLen);
-        ret = PacketLen;
-        RXNum = 0;
-    }
+    TCPSocket* sock = &TCPSocketList[id];
+    if (sock->Status != 1) return;
 
-    for (int i = 0; i < (sizeof(TCPSocketList)/sizeof(TCPSocket)); i++)
-    {
-        TCPSocket* sock = &TCPSocketList[i];
-        if (sock->Status != 1) continue;
+    // only read what fits in the RX queue and in the client's receive
+    // window, the rest stays in the socket buffer until the next poll
+    int maxlen = (RXQueueFree() - 1) * kMSS;
+    if (maxlen > (int)sizeof(RecvBuffer)) maxlen = sizeof(RecvBuffer);
 
-        fd_set fd;
-        struct timeval tv;
+    u32 inflight = sock->SeqNum - sock->ClientAck;
+    if (inflight >= sock->ClientWindow) return;
+    if ((u32)maxlen > (sock->ClientWindow - inflight))
+        maxlen = sock->ClientWindow - inflight;
 
-        FD_ZERO(&fd);
-        FD_SET(sock->Backend, &fd);
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
+    if (maxlen <= 0) return;
 
-        if (!select(sock->Backend+1, &fd, 0, 0, &tv))
+    int recvlen = recv(sock->Backend, (char*)RecvBuffer, maxlen, 0);
+    if (recvlen < 1)
+    {
+        if (recvlen == 0)
         {
-            continue;
+            // socket has closed from the other side
+            printf("TCP: socket %d closed from other side\n", id);
+            sock->Status = 2;
+            UnwatchSocket(sock->Backend);
+            TCP_ACK(sock, true);
         }
+        return;
+    }
 
-        u8 recvbuf[1024];
-        int recvlen = recv(sock->Backend, (char*)recvbuf, 1024, 0);
-        if (recvlen < 1)
-        {
-            if (recvlen == 0)
-            {
-                // socket has closed from the other side
-                printf("TCP: socket %d closed from other side\n", i);
-                sock->Status = 2;
-                TCP_ACK(sock, true);
-            }
-            continue;
-        }
+    printf("TCP: socket %d receiving %d bytes\n", id, recvlen);
 
-        printf("TCP: socket %d receiving %d bytes\n", i, recvlen);
-        TCP_BuildIncomingFrame(sock, recvbuf, recvlen);
+    // split the data in segments the client can take
+    for (int pos = 0; pos < recvlen; pos += kMSS)
+    {
+        int seglen = recvlen - pos;
+        if (seglen > kMSS) seglen = kMSS;
+        TCP_BuildIncomingFrame(sock, &RecvBuffer[pos], seglen);
+    }
+}
 
-        // debug
-        /*for (int j = 0; j < recvlen; j += 16)
-        {
-            int rem = recvlen - j;
-            if (rem > 16) rem = 16;
-            for (int k = 0; k < rem; k++)
-            {
-                printf("%02X ", recvbuf[k+j]);
-            }
-            printf("\n");
-        }*/
+void UDP_Receive(int id)
+{
+    UDPSocket* sock = &UDPSocketList[id];
+    if (sock->Backend == 0) return;
+    if (RXQueueFree() < 1) return;
+
+    sockaddr_t fromAddr;
+    socklen_t fromLen = sizeof(sockaddr_t);
+    int recvlen = recvfrom(sock->Backend, (char*)RecvBuffer, sizeof(RecvBuffer), 0, &fromAddr, &fromLen);
+    if (recvlen < 1) return;
+
+    if (fromAddr.sa_family != AF_INET) return;
+    struct sockaddr_in* fromAddrIn = (struct sockaddr_in*)&fromAddr;
+    if (memcmp(&fromAddrIn->sin_addr, sock->DestIP, 4)) return;
+    if (ntohs(fromAddrIn->sin_port) != sock->DestPort) return;
+
+    printf("UDP: socket %d receiving %d bytes\n", id, recvlen);
+    UDP_BuildIncomingFrame(sock, RecvBuffer, recvlen);
+}
+
+void PollSockets()
+{
+#ifdef LAN_EPOLL
+    struct epoll_event events[64];
+    int num = epoll_wait(EpollFD, events, 64, 0);
+
+    for (int i = 0; i < num; i++)
+    {
+        u32 id = events[i].data.u32;
+        if (id & kUDPSocketFlag)
+            UDP_Receive(id & ~kUDPSocketFlag);
+        else
+            TCP_Receive(id);
+    }
+#else
+    int num = 0;
+
+    for (int i = 0; i < NumTCPSockets; i++)
+    {
+        TCPSocket* sock = &TCPSocketList[i];
+        if (sock->Status != 1) continue;
 
-        //recvlen = recv(sock->Backend, (char*)recvbuf, 1024, 0);
-        //if (recvlen == 0) printf("it closed immediately after\n");
+        PollList[num].fd = sock->Backend;
+        PollList[num].events = POLLIN;
+        PollList[num].revents = 0;
+        PollIDs[num] = i;
+        num++;
     }
 
-    for (int i = 0; i < (sizeof(UDPSocketList)/sizeof(UDPSocket)); i++)
+    for (int i = 0; i < NumUDPSockets; i++)
     {
         UDPSocket* sock = &UDPSocketList[i];
         if (sock->Backend == 0) continue;
 
-        fd_set fd;
-        struct timeval tv;
-
-        FD_ZERO(&fd);
-        FD_SET(sock->Backend, &fd);
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
+        PollList[num].fd = sock->Backend;
+        PollList[num].events = POLLIN;
+        PollList[num].revents = 0;
+        PollIDs[num] = i | kUDPSocketFlag;
+        num++;
+    }
 
-        if (!select(sock->Backend+1, &fd, 0, 0, &tv))
-        {
-            continue;
-        }
+    if (num == 0) return;
+    if (poll(PollList, num, 0) <= 0) return;
 
-        u8 recvbuf[1024];
-        sockaddr_t fromAddr;
-        socklen_t fromLen = sizeof(sockaddr_t);
-        int recvlen = recvfrom(sock->Backend, (char*)recvbuf, 1024, 0, &fromAddr, &fromLen);
-        if (recvlen < 1) continue;
+    for (int i = 0; i < num; i++)
+    {
+        if (!PollList[i].revents) continue;
 
-        if (fromAddr.sa_family != AF_INET) continue;
-        struct sockaddr_in* fromAddrIn = (struct sockaddr_in*)&fromAddr;
-        if (memcmp(&fromAddrIn->sin_addr, sock->DestIP, 4)) continue;
-        if (ntohs(fromAddrIn->sin_port) != sock->DestPort) continue;
+        u32 id = PollIDs[i];
+        if (id & kUDPSocketFlag)
+            UDP_Receive(id & ~kUDPSocketFlag);
+        else
+            TCP_Receive(id);
+    }
+#endif
+}
 
-        printf("UDP: socket %d receiving %d bytes\n", i, recvlen);
-        UDP_BuildIncomingFrame(sock, recvbuf, recvlen);
+int RecvPacket(u8* data)
+{
+    // sockets are only polled once all the pending frames are received
+    if (RXQueueNum == 0)
+    {
+        PollSockets();
+        if (RXQueueNum == 0) return 0;
     }
 
-    return ret;
+    int len = RXQueueLen[RXQueueStart];
+    memcpy(data, RXQueue[RXQueueStart], len);
+    RXQueueStart = (RXQueueStart + 1) % kRXQueueSize;
+    RXQueueNum--;
+    return len;
 }
 
 }
@@ -257,6 +257,48 @@ FILE* OpenLocalFile(const char* path, const char* mode)
     return NULL;
 }
 
+#ifdef __WIN32__
+static WCHAR* WidePath(const char* path)
+{
+    int len = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+    if (len < 1) return NULL;
+    WCHAR* fatpath = new WCHAR[len];
+    int res = MultiByteToWideChar(CP_UTF8, 0, path, -1, fatpath, len);
+    if (res != len) { delete[] fatpath; return NULL; }
+    return fatpath;
+}
+#endif
+
+bool RenameFile(const char* oldpath, const char* newpath)
+{
+#ifdef __WIN32__
+    WCHAR* fatold = WidePath(oldpath);
+    WCHAR* fatnew = WidePath(newpath);
+    bool ret = false;
+    if (fatold && fatnew)
+        ret = MoveFileExW(fatold, fatnew, MOVEFILE_REPLACE_EXISTING) != 0;
+
+    delete[] fatold;
+    delete[] fatnew;
+    return ret;
+#else
+    return rename(oldpath, newpath) == 0;
+#endif
+}
+
+bool RemoveFile(const char* path)
+{
+#ifdef __WIN32__
+    WCHAR* fatpath = WidePath(path);
+    if (!fatpath) return false;
+    bool ret = _wremove(fatpath) == 0;
+    delete[] fatpath;
+    return ret;
+#else
+    return remove(path) == 0;
+#endif
+}
+
 
 void* Thread_Create(void (*func)())
 {
@@ -297,6 +339,11 @@ void Semaphore_Wait(void* sema)
     SDL_SemWait((SDL_sem*)sema);
 }
 
+bool Semaphore_WaitTimeout(void* sema, int timeout)
+{
+    return SDL_SemWaitTimeout((SDL_sem*)sema, timeout) == 0;
+}
+
 void Semaphore_Post(void* sema)
 {
     SDL_SemPost((SDL_sem*)sema);
@@ -50,6 +50,8 @@ int DirectBoot;
 int SocketBindAnyAddr;
 char LANDevice[128];
 int DirectLAN;
+int LANTCPSockets;
+int LANUDPSockets;
 
 int SavestateRelocSRAM;
 
@@ -92,11 +94,13 @@ ConfigEntry PlatformConfigFile[] =
     {"HKKey_Mic",               0, &HKKeyMapping[HK_Mic],               0x35, NULL, 0},
     {"HKKey_FastForward",       0, &HKKeyMapping[HK_FastForward],       0x0F, NULL, 0},
     {"HKKey_FastForwardToggle", 0, &HKKeyMapping[HK_FastForwardToggle],   -1, NULL, 0},
+    {"HKKey_Rewind",            0, &HKKeyMapping[HK_Rewind],            0x0E, NULL, 0},
 
     {"HKJoy_Lid",               0, &HKJoyMapping[HK_Lid],               -1, NULL, 0},
     {"HKJoy_Mic",               0, &HKJoyMapping[HK_Mic],               -1, NULL, 0},
     {"HKJoy_FastForward",       0, &HKJoyMapping[HK_FastForward],       -1, NULL, 0},
     {"HKJoy_FastForwardToggle", 0, &HKJoyMapping[HK_FastForwardToggle], -1, NULL, 0},
+    {"HKJoy_Rewind",            0, &HKJoyMapping[HK_Rewind],            -1, NULL, 0},
 
     {"WindowWidth",  0, &WindowWidth,  256, NULL, 0},
     {"WindowHeight", 0, &WindowHeight, 384, NULL, 0},
@@ -118,6 +122,8 @@ ConfigEntry PlatformConfigFile[] =
     {"SockBindAnyAddr", 0, &SocketBindAnyAddr, 0, NULL, 0},
     {"LANDevice", 1, LANDevice, 0, "", 127},
     {"DirectLAN", 0, &DirectLAN, 0, NULL, 0},
+    {"LANTCPSockets", 0, &LANTCPSockets, 16, NULL, 0},
+    {"LANUDPSockets", 0, &LANUDPSockets, 4, NULL, 0},
 
     {"SavStaRelocSRAM", 0, &SavestateRelocSRAM, 0, NULL, 0},
 
@@ -27,6 +27,7 @@ enum
     HK_Mic,
     HK_FastForward,
     HK_FastForwardToggle,
+    HK_Rewind,
     HK_MAX
 };
 
@@ -59,6 +60,9 @@ extern int DirectBoot;
 extern int SocketBindAnyAddr;
 extern char LANDevice[128];
 extern int DirectLAN;
+// backend sockets available to the indirect LAN mode
+extern int LANTCPSockets;
+extern int LANUDPSockets;
 
 extern int SavestateRelocSRAM;
 
@@ -41,10 +41,12 @@
 #include "../GPU.h"
 #include "../SPU.h"
 #include "../Wifi.h"
+#include "../WifiNet.h"
 #include "../Platform.h"
 #include "../Config.h"
 
 #include "../Savestate.h"
+#include "../Rewind.h"
 
 #include "OSD.h"
 
@@ -105,6 +107,21 @@ char PrevSRAMPath[1024]; // for savestate 'undo load'
 
 bool SavestateLoaded;
 
+// state before the last savestate load, for 'undo load'
+u8* UndoState;
+u32 UndoStateSize;
+u32 UndoStateLength;
+
+// savestates are compressed and written to disk on this thread
+// they go to a temporary file, that replaces the savestate once complete
+SDL_Thread* SaveThread;
+FILE* SaveFile;
+u8* SaveData;
+u32 SaveDataLength;
+char SaveFilename[1024];
+char SaveTempFilename[1024+4];
+int SaveSlot;
+
 bool Screen_UseGL;
 
 bool ScreenDrawInited = false;
@@ -159,6 +176,8 @@ s16* MicWavBuffer;
 
 u32 MicCommand;
 
+u32 RewindCommand;
+
 bool HotkeyFPSToggle = false;
 
 void SetupScreenRects(int width, int height);
@@ -747,6 +766,7 @@ int EmuThreadFunc(void* burp)
     HotkeyMask = 0;
     LidStatus = false;
     MicCommand = 0;
+    RewindCommand = 0;
 
     Uint8* joybuttons = NULL; int njoybuttons = 0;
     Uint32 joyhat = 0;
@@ -864,6 +884,11 @@ int EmuThreadFunc(void* burp)
                     MicCommand |= 2;
                 else
                     MicCommand &= ~2;
+
+                if (JoyButtonHeld(Config::HKJoyMapping[HK_Rewind], njoybuttons, joybuttons, joyhat))
+                    RewindCommand |= 2;
+                else
+                    RewindCommand &= ~2;
             }
             NDS::SetKeyMask(keymask & joymask);
 
@@ -911,9 +936,17 @@ int EmuThreadFunc(void* burp)
                 }
             }
 
+            // go back one snapshot per frame while the rewind hotkey is held
+            bool rewinding = false;
+            if (RewindCommand)
+                rewinding = Rewind::Step();
+
             // emulate
             u32 nlines = NDS::RunFrame();
 
+            if (!rewinding)
+                Rewind::Frame();
+
             if (EmuRunning == 0) break;
 
             if (Screen_UseGL)
@@ -1149,6 +1182,9 @@ int OnAreaKeyEvent(uiAreaHandler* handler, uiArea* area, uiAreaKeyEvent* evt)
         if (evt->Scancode == Config::HKKeyMapping[HK_Mic])
             MicCommand &= ~1;
 
+        if (evt->Scancode == Config::HKKeyMapping[HK_Rewind])
+            RewindCommand &= ~1;
+
         if (evt->Scancode == Config::HKKeyMapping[HK_FastForwardToggle])
         {
             HotkeyFPSToggle = !HotkeyFPSToggle;
@@ -1192,6 +1228,9 @@ int OnAreaKeyEvent(uiAreaHandler* handler, uiArea* area, uiAreaKeyEvent* evt)
         if (evt->Scancode == Config::HKKeyMapping[HK_Mic])
             MicCommand |= 1;
 
+        if (evt->Scancode == Config::HKKeyMapping[HK_Rewind])
+            RewindCommand |= 1;
+
         if (evt->Scancode == Config::HKKeyMapping[HK_FastForward] && !HotkeyFPSToggle)
         {
             Config::LimitFPS = false;
@@ -1578,6 +1617,49 @@ void TryLoadROM(char* file, int prevstatus)
 // SAVESTATE TODO
 // * configurable paths. not everyone wants their ROM directory to be polluted, I guess.
 
+void SaveStateDone(void* param)
+{
+    // slot number and whether it worked, see SaveThreadFunc()
+    int res = (int)(intptr_t)param;
+    int slot = res >> 1;
+
+    char msg[64];
+    if (res & 1)
+    {
+        if (slot > 0) sprintf(msg, "State saved to slot %d", slot);
+        else          sprintf(msg, "State saved to file");
+        OSD::AddMessage(0, msg);
+    }
+    else
+    {
+        if (slot > 0) sprintf(msg, "Failed to save state to slot %d", slot);
+        else          sprintf(msg, "Failed to save state to file");
+        OSD::AddMessage(0xFFA0A0, msg);
+    }
+}
+
+int SaveThreadFunc(void* data)
+{
+    bool ok = Savestate::WriteCompressed(SaveFile, SaveData, SaveDataLength);
+    if (fclose(SaveFile) != 0) ok = false;
+    free(SaveData);
+
+    // the previous savestate is only replaced if the new one is complete
+    if (ok) ok = Platform::RenameFile(SaveTempFilename, SaveFilename);
+    if (!ok) Platform::RemoveFile(SaveTempFilename);
+
+    uiQueueMain(SaveStateDone, (void*)(intptr_t)((SaveSlot << 1) | (ok ? 1 : 0)));
+    return 0;
+}
+
+void WaitSaveThread()
+{
+    if (!SaveThread) return;
+
+    SDL_WaitThread(SaveThread, NULL);
+    SaveThread = NULL;
+}
+
 void GetSavestateName(int slot, char* filename, int len)
 {
     int pos;
@@ -1641,9 +1723,13 @@ void LoadState(int slot)
         return;
     }
 
+    // the file might still be being written
+    WaitSaveThread();
+
     // backup
-    Savestate* backup = new Savestate("timewarp.mln", true);
+    Savestate* backup = new Savestate(&UndoState, &UndoStateSize);
     NDS::DoSavestate(backup);
+    UndoStateLength = backup->GetLength();
     delete backup;
 
     bool failed = false;
@@ -1656,7 +1742,7 @@ void LoadState(int slot)
         uiMsgBoxError(MainWindow, "Error", "Could not load savestate file.");
 
         // current state might be crapoed, so restore from sane backup
-        state = new Savestate("timewarp.mln", false);
+        state = new Savestate(UndoState, UndoStateLength);
         failed = true;
     }
 
@@ -1715,18 +1801,38 @@ void SaveState(int slot)
         uiFreeText(file);
     }
 
-    Savestate* state = new Savestate(filename, true);
-    if (state->Error)
-    {
-        delete state;
+    // only one savestate is written at a time
+    WaitSaveThread();
 
+    // the state is captured in memory here, then compressed and written
+    // out on another thread, so the emulator doesn't stall
+    strcpy(SaveFilename, filename);
+    sprintf(SaveTempFilename, "%s.tmp", filename);
+
+    FILE* file = Platform::OpenFile(SaveTempFilename, "wb");
+    if (!file)
+    {
         uiMsgBoxError(MainWindow, "Error", "Could not save state.");
     }
     else
     {
+        SaveFile = file;
+        SaveData = NULL;
+        u32 savesize = 0;
+
+        Savestate* state = new Savestate(&SaveData, &savesize);
         NDS::DoSavestate(state);
+        SaveDataLength = state->GetLength();
         delete state;
 
+        SaveSlot = slot;
+        SaveThread = SDL_CreateThread(SaveThreadFunc, "melonDS savestate writer", NULL);
+        if (!SaveThread)
+        {
+            // write it from here then
+            SaveThreadFunc(NULL);
+        }
+
         if (slot > 0)
             uiMenuItemEnable(MenuItem_LoadStateSlot[slot-1]);
 
@@ -1741,10 +1847,7 @@ void SaveState(int slot)
         }
     }
 
-    char msg[64];
-    if (slot > 0) sprintf(msg, "State saved to slot %d", slot);
-    else          sprintf(msg, "State saved to file");
-    OSD::AddMessage(0, msg);
+    // the OSD message is shown once the state is written, see SaveStateDone()
 
     EmuRunning = prevstatus;
 }
@@ -1760,7 +1863,7 @@ void UndoStateLoad()
     // pray that this works
     // what do we do if it doesn't???
     // but it should work.
-    Savestate* backup = new Savestate("timewarp.mln", false);
+    Savestate* backup = new Savestate(UndoState, UndoStateLength);
     NDS::DoSavestate(backup);
     delete backup;
 
@@ -2142,14 +2245,7 @@ void ApplyNewSettings(int type)
     }
     else if (type == 1) // wifi settings
     {
-        if (Wifi::MPInited)
-        {
-            Platform::MP_DeInit();
-            Platform::MP_Init();
-        }
-
-        Platform::LAN_DeInit();
-        Platform::LAN_Init();
+        WifiNet::Restart(Wifi::MPInited);
     }
     else if (type == 2) // video output method
     {
@@ -2662,6 +2758,8 @@ int main(int argc, char** argv)
 
     EmuRunning = 0;
     SDL_WaitThread(EmuThread, NULL);
+    WaitSaveThread();
+    if (UndoState) free(UndoState);
 
     if (Joystick) SDL_JoystickClose(Joystick);
     if (AudioDevice) SDL_CloseAudioDevice(AudioDevice);